@@ -15,6 +15,12 @@ LDFLAGS+=
 #
 #NATIVE_BUILD:=true
 
+#
+# Build the terminal application instead of the wxWidgets one. The chatlog
+# replay (-r, -b) and the Linux event loop are only reachable from it for now
+#
+#TERM_BUILD:=true
+
 # 
 # Command used to fetch remote packages
 #
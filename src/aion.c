@@ -36,7 +36,6 @@
 
 #include "aion.h"
 #include "util.h"
-#include "txtbuf.h"
 #include "console.h"
 #include "regeng.h"
 #include "event.h"
@@ -62,7 +61,7 @@
  * This structures hold information about a player:
  *  - Name
  *  - Accumulated Abyss points
- *  - Chat log (txtbuf)
+ *  - Chat history, in the chat arena
  *  - Inventory full flag
  *
  * @note A player can be on the cached list and on the
@@ -70,24 +69,163 @@
  */
 struct aion_player
 {
-    LIST_ENTRY(aion_player)     apl_cached;             /**< Cached linked list element         */
+    TAILQ_ENTRY(aion_player)    apl_cached;             /**< Cached list element, LRU order     */
     LIST_ENTRY(aion_player)     apl_group;              /**< Group linked list element          */
 
     char                        apl_name[AION_NAME_SZ]; /**< Aion player name                   */
     uint32_t                    apl_apvalue;            /**< Accumulated AP value               */
-    struct txtbuf               apl_txtbuf;             /**< Text buffer, linked to chat buffer */
-    char                        apl_chat[AION_CHAT_SZ]; /**< Chat buffer                        */
+    uint64_t                    apl_chat;               /**< Arena position of the last chat    */
     bool                        apl_invfull;            /**< Is inventory full flag             */
+    bool                        apl_grouped;            /**< Player is on the group list        */
+    uint32_t                    apl_hash;               /**< Case-folded hash of apl_name       */
+    uint32_t                    apl_loot;               /**< Items looted while in the group    */
+    uint32_t                    apl_loot_ap;            /**< AP items looted                    */
+
+    struct aion_slab           *apl_slab;               /**< Slab of the record, NULL for self  */
+    struct aion_player         *apl_next;               /**< Next free record in the slab       */
+    bool                        apl_inuse;              /**< Record is allocated                */
 };
 
 /** Create the definition of the HEAD structure for the linked list of aion_player structures   */
 LIST_HEAD(aion_player_list, aion_player);
+/** HEAD structure of the cached players, the least recently used player is the last one        */
+TAILQ_HEAD(aion_player_cache, aion_player);
+
+/** Initial number of slots in the player index, must be a power of 2 */
+#define AION_INDEX_MIN      64
+
+/**
+ * Index of the cached players by name
+ *
+ * Open addressing hash table with linear probing, keyed by @p apl_hash. The
+ * table is grown to keep it at most half full. The cached list still keeps
+ * the players in the most recently used order, which is the display order.
+ */
+struct aion_player_index
+{
+    struct aion_player          **api_slot;             /**< Slots, NULL if empty               */
+    size_t                      api_size;               /**< Number of slots, a power of 2      */
+    size_t                      api_num;                /**< Number of players in the index     */
+};
+
+/** No chat line, see aion_chat_rec::acr_prev */
+#define AION_CHAT_NONE      UINT64_MAX
+
+/** Alignment of the chat records, a record header must fit in it */
+#define AION_CHAT_ALIGN     16
+
+/**
+ * A chat line in the chat arena, followed by the NUL terminated line
+ *
+ * The records of a player are linked from the most recent one, which is
+ * @p apl_chat, backwards through @p acr_prev.
+ */
+struct aion_chat_rec
+{
+    uint64_t                    acr_prev;               /**< Position of the previous line of the player */
+    uint32_t                    acr_size;               /**< Size of the record, aligned                */
+    uint32_t                    acr_len;                /**< Length of the chat line                    */
+};
+
+/**
+ * Chat history of all players
+ *
+ * The arena is a ring of chat records of any player; when it is full, the
+ * oldest records are overwritten. So the memory used by the chat history is
+ * bounded, while the number of lines kept for a player follows how much
+ * they chat.
+ *
+ * Positions grow forever and are taken modulo the arena size, so a position
+ * lower than @p aca_head refers to an overwritten record. The players don't
+ * need to be updated when their records are overwritten, nor the records when
+ * a player is evicted. A record that would wrap is preceded by a padding
+ * record up to the end of the arena.
+ */
+struct aion_chat_arena
+{
+    char                       *aca_buf;                /**< Records, allocated on the first chat       */
+    uint64_t                    aca_head;               /**< Position of the oldest record              */
+    uint64_t                    aca_tail;               /**< Position of the next record                */
+};
+
+/** Number of player records in a slab */
+#define AION_SLAB_PLAYERS   32
+
+/**
+ * A slab of player records
+ *
+ * The cached players are carved from slabs instead of being allocated one by
+ * one, so they are close in memory and don't fragment the heap. The free
+ * records of a slab are chained through @p apl_next.
+ */
+struct aion_slab
+{
+    LIST_ENTRY(aion_slab)       as_slabs;               /**< Slab list element                  */
+    LIST_ENTRY(aion_slab)       as_partial;             /**< Partial slab list element          */
+    struct aion_player         *as_free;                /**< First free record, NULL if full    */
+    size_t                      as_used;                /**< Number of records in use           */
+    struct aion_player          as_player[AION_SLAB_PLAYERS];   /**< Player records             */
+};
+
+/** Create the definition of the HEAD structure for the linked list of aion_slab structures */
+LIST_HEAD(aion_slab_list, aion_slab);
+
+/**
+ * Pool of player records
+ *
+ * Records are allocated from the slabs that are not full. A slab that becomes
+ * empty is released, unless it is the only empty slab; that one is kept so
+ * a player evicted and another one cached don't allocate and release a slab
+ * each time.
+ */
+struct aion_player_pool
+{
+    struct aion_slab_list       app_slabs;              /**< All slabs                          */
+    struct aion_slab_list       app_partial;            /**< Slabs with free records            */
+    size_t                      app_nslabs;             /**< Number of slabs                    */
+    size_t                      app_nempty;             /**< Number of empty slabs              */
+};
+
+/** Memory used by the pool @p app, whole slabs including the free records and the kept empty slab */
+#define AION_POOL_BYTES(app)    ((app)->app_nslabs * sizeof(struct aion_slab))
+
+/*
+ * The player, the cached players and the group are the state of a session. Each
+ * thread has its own session, see aion_session_init().
+ */
 
 /** This is us, the player! */
-struct aion_player      aion_player_self;
+SYS_TLS struct aion_player      aion_player_self;
 
 /** Cached list of players, mainly used for chat history */
-struct aion_player_list aion_players_cached;
+SYS_TLS struct aion_player_cache aion_players_cached;
+
+/** The cached players by name */
+static SYS_TLS struct aion_player_index aion_players_index;
+
+/** Slabs of the cached players */
+static SYS_TLS struct aion_player_pool aion_players_pool;
+
+/** Chat history of the session */
+static SYS_TLS struct aion_chat_arena aion_chat_arena;
+
+/** Number of cached players */
+static SYS_TLS size_t aion_players_num = 0;
+
+/** Number of players evicted from the cache */
+static SYS_TLS uint64_t aion_players_evicted = 0;
+
+/**
+ * Limits of the player cache, the least recently used players that are not in
+ * the group are evicted above them. 0 means no limit.
+ *
+ * @see aion_players_limit_set
+ */
+static size_t aion_players_max = AION_PLAYERS_MAX;
+static size_t aion_players_max_bytes = 0;           /**< See aion_players_max   */
+
+/** Number of records that fit in aion_players_max_bytes, 0 for no limit */
+static size_t aion_players_max_rec = 0;
 
 /**
  * List of players in the current group. This list cannot be empty 
@@ -140,7 +278,10 @@ struct aion_player_list aion_players_cached;
  *
  * @enddot
  */
-struct aion_player_list aion_group;             /* Current group        */
+SYS_TLS struct aion_player_list aion_group;     /* Current group        */
+
+/** Don't copy the loot rights to the clipboard, used by batch sessions */
+static SYS_TLS bool aion_clipboard_off = false;
 
 /**
  * If true, exclude the player if it has full invenvtory from the AP fair system.
@@ -170,9 +311,19 @@ static struct
     char invfull_list[AION_CHAT_SZ];
 } aion_aploot_format;
 
-static void aion_player_init(struct aion_player *player, char *name);
-static struct aion_player* aion_player_alloc(char *charname);
-static struct aion_player* aion_group_find(char *charname);
+static bool aion_name_eq(const char *apl_name, const char *charname, size_t charname_len);
+static uint32_t aion_name_hash(const char *charname, size_t charname_len);
+static bool aion_index_insert(struct aion_player *player);
+static void aion_index_remove(struct aion_player *player);
+static void aion_players_evict(struct aion_player *keep);
+static struct aion_player* aion_pool_get(void);
+static void aion_pool_put(struct aion_player *player);
+static struct aion_player* aion_player_find(const char *charname, size_t charname_len);
+static void aion_player_init(struct aion_player *player, const char *charname, size_t charname_len);
+static bool aion_chat_put(struct aion_player *player, const char *chat, size_t chat_len);
+static bool aion_chat_get(struct aion_player *player, int msgnum, char *dst, size_t dst_sz);
+static struct aion_player* aion_player_alloc(const char *charname, size_t charname_len);
+static struct aion_player* aion_group_find(const char *charname, size_t charname_len);
 static void aion_group_dump(void);
 static void aion_group_iter_fill(struct aion_group_iter *iter, struct aion_player *player);
 
@@ -184,13 +335,7 @@ static void aion_group_iter_fill(struct aion_group_iter *iter, struct aion_playe
  */
 bool aion_init(void)
 {
-    LIST_INIT(&aion_players_cached);
-    LIST_INIT(&aion_group);
-
-    /* Default name */
-    aion_player_init(&aion_player_self, AION_NAME_DEFAULT);
-    /* Insert the player to the group list, he's not allowed to leave :P */
-    LIST_INSERT_HEAD(&aion_group, &aion_player_self, apl_group);
+    aion_session_init(true);
 
     /* Set the default aploot format */
     if (!aion_aploot_fmt_parse(AION_APLOOT_FORMAT_DEFAULT))
@@ -199,10 +344,74 @@ bool aion_init(void)
         return false;
     }
 
+    return true;
+}
+
+/**
+ * Start a new session in the calling thread
+ *
+ * A session is the player, the group and the cached players. The main thread's
+ * session is started by aion_init(); other threads, like the batch replay threads,
+ * must start their own session before processing any events. The settings (AP
+ * limit, aploot format, ...) are shared by all sessions.
+ *
+ * @param[in]       clipboard       Copy the loot rights to the clipboard
+ */
+void aion_session_init(bool clipboard)
+{
+    TAILQ_INIT(&aion_players_cached);
+    LIST_INIT(&aion_group);
+
+    LIST_INIT(&aion_players_pool.app_slabs);
+    LIST_INIT(&aion_players_pool.app_partial);
+    aion_players_pool.app_nslabs = 0;
+    aion_players_pool.app_nempty = 0;
+
+    aion_players_num = 0;
+    aion_players_evicted = 0;
+
+    aion_clipboard_off = !clipboard;
+
+    /* Default name */
+    aion_player_init(&aion_player_self, AION_NAME_DEFAULT, strlen(AION_NAME_DEFAULT));
+    /* Insert the player to the group list, he's not allowed to leave :P */
+    LIST_INSERT_HEAD(&aion_group, &aion_player_self, apl_group);
+    aion_player_self.apl_grouped = true;
+
     /* The player should always be in the current group */
-    aion_group_join(AION_NAME_DEFAULT);
+    aion_group_join(AION_NAME_DEFAULT, strlen(AION_NAME_DEFAULT));
+}
 
-    return true;
+/**
+ * Release the players of the session of the calling thread
+ */
+void aion_session_free(void)
+{
+    struct aion_slab *slab;
+
+    /* The players are released with their slabs */
+    while ((slab = LIST_FIRST(&aion_players_pool.app_slabs)) != NULL)
+    {
+        LIST_REMOVE(slab, as_slabs);
+        free(slab);
+    }
+
+    LIST_INIT(&aion_players_pool.app_partial);
+    aion_players_pool.app_nslabs = 0;
+    aion_players_pool.app_nempty = 0;
+
+    TAILQ_INIT(&aion_players_cached);
+
+    aion_players_num = 0;
+
+    free(aion_players_index.api_slot);
+    memset(&aion_players_index, 0, sizeof(aion_players_index));
+
+    free(aion_chat_arena.aca_buf);
+    memset(&aion_chat_arena, 0, sizeof(aion_chat_arena));
+
+    LIST_INIT(&aion_group);
+    LIST_INSERT_HEAD(&aion_group, &aion_player_self, apl_group);
 }
 
 /**
@@ -218,27 +427,408 @@ bool aion_clipboard_set(char *text)
 {
     char clip[AION_CLIPBOARD_MAX];
 
+    if (aion_clipboard_off) return true;
+
     /* Clip the string */
     util_strlcpy(clip, text, sizeof(clip));
 
     return clipboard_set_text(clip);
 }
 
+/**
+ * Compare the stored player name @p apl_name to @p charname, ignoring case
+ *
+ * Names longer than @ref AION_NAME_SZ are truncated the same way as when they are stored.
+ *
+ * @param[in]   apl_name        NUL terminated player name
+ * @param[in]   charname        Character name, doesn't have to be NUL terminated
+ * @param[in]   charname_len    Length of @p charname
+ *
+ * @retval      true            If the names are equal
+ * @retval      false           If they differ
+ */
+bool aion_name_eq(const char *apl_name, const char *charname, size_t charname_len)
+{
+    if (charname_len >= AION_NAME_SZ)
+    {
+        charname_len = AION_NAME_SZ - 1;
+    }
+
+    if (strncasecmp(apl_name, charname, charname_len) != 0) return false;
+
+    /* strncasecmp() matched charname_len characters, so apl_name is at least this long */
+    return apl_name[charname_len] == '\0';
+}
+
+/**
+ * Hash of the player name @p charname, ignoring case
+ *
+ * Names are truncated the same way as in aion_name_eq(), so equal names have
+ * equal hashes.
+ *
+ * @param[in]   charname        Character name, doesn't have to be NUL terminated
+ * @param[in]   charname_len    Length of @p charname
+ *
+ * @return
+ * FNV-1a hash of the lower case name
+ */
+uint32_t aion_name_hash(const char *charname, size_t charname_len)
+{
+    uint32_t hash = 2166136261U;
+    size_t ii;
+
+    if (charname_len >= AION_NAME_SZ)
+    {
+        charname_len = AION_NAME_SZ - 1;
+    }
+
+    for (ii = 0; ii < charname_len; ii++)
+    {
+        hash = (hash ^ (uint8_t)tolower((unsigned char)charname[ii])) * 16777619U;
+    }
+
+    return hash;
+}
+
+/**
+ * Add @p player to the index of the cached players, the index is grown if needed
+ *
+ * @param[in]   player          Player, must not be in the index yet
+ *
+ * @retval      true            On success
+ * @retval      false           On memory allocation error
+ */
+bool aion_index_insert(struct aion_player *player)
+{
+    struct aion_player_index *api = &aion_players_index;
+    struct aion_player **slot;
+    size_t size;
+    size_t ii;
+    size_t jj;
+
+    if (((api->api_num + 1) * 2) > api->api_size)
+    {
+        size = (api->api_size == 0) ? AION_INDEX_MIN : api->api_size * 2;
+
+        slot = calloc(size, sizeof(struct aion_player *));
+        if (slot == NULL)
+        {
+            return false;
+        }
+
+        /* Rehash */
+        for (ii = 0; ii < api->api_size; ii++)
+        {
+            if (api->api_slot[ii] == NULL) continue;
+
+            for (jj = api->api_slot[ii]->apl_hash & (size - 1); slot[jj] != NULL; jj = (jj + 1) & (size - 1));
+            slot[jj] = api->api_slot[ii];
+        }
+
+        free(api->api_slot);
+        api->api_slot = slot;
+        api->api_size = size;
+    }
+
+    for (jj = player->apl_hash & (api->api_size - 1); api->api_slot[jj] != NULL; jj = (jj + 1) & (api->api_size - 1));
+    api->api_slot[jj] = player;
+    api->api_num++;
+
+    return true;
+}
+
+/**
+ * Remove @p player from the index of the cached players
+ *
+ * The players that follow it in the same probe sequence are moved back, so
+ * lookups don't need tombstones.
+ *
+ * @param[in]   player          Player, must be in the index
+ */
+void aion_index_remove(struct aion_player *player)
+{
+    struct aion_player_index *api = &aion_players_index;
+    size_t mask = api->api_size - 1;
+    size_t ii;
+    size_t jj;
+    size_t kk;
+
+    for (ii = player->apl_hash & mask; api->api_slot[ii] != player; ii = (ii + 1) & mask);
+
+    api->api_slot[ii] = NULL;
+    api->api_num--;
+
+    for (jj = (ii + 1) & mask; api->api_slot[jj] != NULL; jj = (jj + 1) & mask)
+    {
+        kk = api->api_slot[jj]->apl_hash & mask;
+
+        /* The player is still reachable if its home slot is between the hole and its slot */
+        if ((ii <= jj) ? ((ii < kk) && (kk <= jj)) : ((ii < kk) || (kk <= jj))) continue;
+
+        api->api_slot[ii] = api->api_slot[jj];
+        api->api_slot[jj] = NULL;
+        ii = jj;
+    }
+}
+
+/**
+ * Evict the least recently used players until the cache is within its limits
+ *
+ * Players in the group are never evicted, so the cache can stay above the
+ * limits if the group is larger than them. Neither are the players with AP,
+ * they keep their AP if they rejoin the group.
+ *
+ * The memory limit is converted to a number of records in whole slabs, see
+ * aion_players_limit_set(), so caching a new player evicts a single one.
+ *
+ * @param[in]   keep            Player that must not be evicted either, the one being allocated
+ */
+void aion_players_evict(struct aion_player *keep)
+{
+    struct aion_player *player;
+    struct aion_player *prevplayer;
+
+    player = TAILQ_LAST(&aion_players_cached, aion_player_cache);
+
+    while ((player != NULL) &&
+           (((aion_players_max != 0) && (aion_players_num > aion_players_max)) ||
+            ((aion_players_max_rec != 0) && (aion_players_num > aion_players_max_rec))))
+    {
+        prevplayer = TAILQ_PREV(player, aion_player_cache, apl_cached);
+
+        if (!player->apl_grouped && (player->apl_apvalue == 0) && (player != keep))
+        {
+            aion_index_remove(player);
+            TAILQ_REMOVE(&aion_players_cached, player, apl_cached);
+
+            aion_players_num--;
+            aion_players_evicted++;
+
+            aion_pool_put(player);
+        }
+
+        player = prevplayer;
+    }
+}
+
+/**
+ * Allocate a player record from the pool
+ *
+ * The record is taken from a slab that is not full; if there is none, a new
+ * slab is allocated. The free records of a new slab are taken in address
+ * order.
+ *
+ * @return
+ *      An uninitialized record, or NULL if a new slab cannot be allocated
+ */
+struct aion_player* aion_pool_get(void)
+{
+    struct aion_player_pool *app = &aion_players_pool;
+    struct aion_player *player;
+    struct aion_slab *slab;
+    size_t ii;
+
+    slab = LIST_FIRST(&app->app_partial);
+    if (slab == NULL)
+    {
+        slab = malloc(sizeof(struct aion_slab));
+        if (slab == NULL)
+        {
+            con_printf("Unable to allocate a player slab\n");
+            return NULL;
+        }
+
+        for (ii = 0; ii < AION_SLAB_PLAYERS; ii++)
+        {
+            slab->as_player[ii].apl_slab  = slab;
+            slab->as_player[ii].apl_inuse = false;
+            slab->as_player[ii].apl_next  = (ii + 1 < AION_SLAB_PLAYERS) ? &slab->as_player[ii + 1] : NULL;
+        }
+
+        slab->as_free = &slab->as_player[0];
+        slab->as_used = 0;
+
+        LIST_INSERT_HEAD(&app->app_slabs, slab, as_slabs);
+        LIST_INSERT_HEAD(&app->app_partial, slab, as_partial);
+        app->app_nslabs++;
+        app->app_nempty++;
+    }
+
+    player = slab->as_free;
+    slab->as_free = player->apl_next;
+
+    if (slab->as_used++ == 0)
+    {
+        app->app_nempty--;
+    }
+
+    if (slab->as_free == NULL)
+    {
+        LIST_REMOVE(slab, as_partial);
+    }
+
+    player->apl_next  = NULL;
+    player->apl_inuse = true;
+
+    return player;
+}
+
+/**
+ * Return a player record to the pool
+ *
+ * The slab of the record is released if it becomes empty and there is
+ * another empty slab already.
+ *
+ * @param[in]   player          Record returned by aion_pool_get()
+ */
+void aion_pool_put(struct aion_player *player)
+{
+    struct aion_player_pool *app = &aion_players_pool;
+    struct aion_slab *slab = player->apl_slab;
+
+    assert(player->apl_inuse);
+
+    if (slab->as_free == NULL)
+    {
+        /* The slab was full, it has a free record now */
+        LIST_INSERT_HEAD(&app->app_partial, slab, as_partial);
+    }
+
+    player->apl_inuse = false;
+    player->apl_next  = slab->as_free;
+    slab->as_free = player;
+
+    if (--slab->as_used > 0)
+    {
+        return;
+    }
+
+    if (app->app_nempty == 0)
+    {
+        app->app_nempty++;
+        return;
+    }
+
+    LIST_REMOVE(slab, as_partial);
+    LIST_REMOVE(slab, as_slabs);
+    app->app_nslabs--;
+
+    free(slab);
+}
+
+/**
+ * Set the limits of the player cache
+ *
+ * When a new player is cached and there are more than @p max players or they
+ * use more than @p max_bytes of memory, the least recently used players that
+ * are not in the group and have no AP are freed. Their chat history is lost,
+ * its records in the chat arena are overwritten in time.
+ *
+ * @p max_bytes is rounded down to whole slabs (at least one) and used as a
+ * limit on the number of records. The pool can still hold more slabs than that
+ * when the evicted players leave them partially used.
+ *
+ * @param[in]   max             Maximum number of cached players, 0 for no limit
+ * @param[in]   max_bytes       Maximum memory used by the cached players, 0 for no limit
+ */
+void aion_players_limit_set(size_t max, size_t max_bytes)
+{
+    aion_players_max = max;
+    aion_players_max_bytes = max_bytes;
+    aion_players_max_rec = 0;
+
+    if (max_bytes != 0)
+    {
+        aion_players_max_rec = max_bytes / sizeof(struct aion_slab);
+        if (aion_players_max_rec == 0) aion_players_max_rec = 1;
+
+        aion_players_max_rec *= AION_SLAB_PLAYERS;
+    }
+
+    aion_players_evict(NULL);
+}
+
+/**
+ * Get the player cache statistics in text format
+ *
+ * @param[out]  stats           Output buffer
+ * @param[in]   stats_sz        Size of @p stats
+ *
+ * @retval      true            Always
+ */
+bool aion_players_stats(char *stats, size_t stats_sz)
+{
+    snprintf(stats, stats_sz, "Players: %llu cached (max %llu), %llu slabs, %llu KB (max %llu KB), %llu evicted, chat %llu/%llu KB",
+             (unsigned long long)aion_players_num,
+             (unsigned long long)aion_players_max,
+             (unsigned long long)aion_players_pool.app_nslabs,
+             (unsigned long long)(AION_POOL_BYTES(&aion_players_pool) / 1024),
+             (unsigned long long)(aion_players_max_bytes / 1024),
+             (unsigned long long)aion_players_evicted,
+             (unsigned long long)((aion_chat_arena.aca_tail - aion_chat_arena.aca_head) / 1024),
+             (unsigned long long)(AION_CHAT_ARENA_SZ / 1024));
+
+    return true;
+}
+
+/**
+ * Find the cached player @p charname
+ *
+ * @param[in]   charname        Character name, doesn't have to be NUL terminated
+ * @param[in]   charname_len    Length of @p charname
+ *
+ * @return
+ * The player or NULL if it's not cached
+ */
+struct aion_player* aion_player_find(const char *charname, size_t charname_len)
+{
+    struct aion_player_index *api = &aion_players_index;
+    struct aion_player *player;
+    uint32_t hash;
+    size_t ii;
+
+    if (api->api_num == 0)
+    {
+        return NULL;
+    }
+
+    hash = aion_name_hash(charname, charname_len);
+
+    for (ii = hash & (api->api_size - 1); (player = api->api_slot[ii]) != NULL; ii = (ii + 1) & (api->api_size - 1))
+    {
+        if ((player->apl_hash == hash) && aion_name_eq(player->apl_name, charname, charname_len))
+        {
+            return player;
+        }
+    }
+
+    return NULL;
+}
+
 /**
  * Initialize a @p aion_player structure with default values
  *
- * @param[in]   charname    Player name
- * @param[out]  player      The aion_player structure
+ * @param[out]  player          The aion_player structure
+ * @param[in]   charname        Player name, doesn't have to be NUL terminated
+ * @param[in]   charname_len    Length of @p charname
  */ 
-void aion_player_init(struct aion_player *player, char *charname)
+void aion_player_init(struct aion_player *player, const char *charname, size_t charname_len)
 {
-    util_strlcpy(player->apl_name, charname, sizeof(player->apl_name));
+    if (charname_len >= sizeof(player->apl_name))
+    {
+        charname_len = sizeof(player->apl_name) - 1;
+    }
+
+    memcpy(player->apl_name, charname, charname_len);
+    player->apl_name[charname_len] = '\0';
+    player->apl_hash     = aion_name_hash(charname, charname_len);
     player->apl_apvalue  = 0;
     player->apl_invfull  = false;
+    player->apl_grouped  = false;
+    player->apl_loot     = 0;
+    player->apl_loot_ap  = 0;
 
-    /* Initialize the chat buffers */
-    memset(player->apl_chat, 0, AION_CHAT_SZ);
-    tb_init(&player->apl_txtbuf, player->apl_chat, AION_CHAT_SZ);
+    player->apl_chat     = AION_CHAT_NONE;
 }
 
 /**
@@ -247,18 +837,19 @@ void aion_player_init(struct aion_player *player, char *charname)
  * If charname is NULL, "You" or Player's name, then 
  * we're dealing with ourselves
  *
- * @param[in]       charname        Character name
+ * @param[in]       charname        Character name, doesn't have to be NUL terminated
+ * @param[in]       charname_len    Length of @p charname
  *
  * @retval          true            If @p charname is the player
  * @retval          false           If @p charname is not the current palyer
  */ 
-bool aion_player_is_self(char *charname)
+bool aion_player_is_self(const char *charname, size_t charname_len)
 {
     if (charname == NULL) return true;
-    if (strcasecmp(charname, AION_NAME_DEFAULT) == 0) return true;
-    if (strcasecmp(charname, AION_NAME_FR_DEFAULT) == 0) return true;
-    if (strcasecmp(charname, AION_NAME_DE_DEFAULT) == 0) return true;
-    if (strcasecmp(aion_player_self.apl_name, charname) == 0) return true;
+    if (aion_name_eq(AION_NAME_DEFAULT, charname, charname_len)) return true;
+    if (aion_name_eq(AION_NAME_FR_DEFAULT, charname, charname_len)) return true;
+    if (aion_name_eq(AION_NAME_DE_DEFAULT, charname, charname_len)) return true;
+    if (aion_name_eq(aion_player_self.apl_name, charname, charname_len)) return true;
 
     return false;
 }
@@ -281,44 +872,60 @@ void aion_player_name_set(char *charname)
  *
  * If a player with @p charname alraedy exists in the
  * cached list, move the structure to the head of the list
- * and return it.
+ * and return it. Players are found through the index,
+ * see aion_player_find().
  *
  * If not, allocate a new structure, register it
- * on the head of the cached list and return it.
+ * on the head of the cached list and in the index
+ * and return it. If the cache is over its limits, the
+ * least recently used players are evicted, see
+ * aion_players_limit_set().
  *
- * @param[in]       charname        Player name
+ * @param[in]       charname        Player name, doesn't have to be NUL terminated
+ * @param[in]       charname_len    Length of @p charname
  *
  * @return
- *      Always returns a valid @ref aion_player structure
+ *      A valid @ref aion_player structure, or NULL if the index or the pool cannot be grown
  */
-struct aion_player* aion_player_alloc(char *charname)
+struct aion_player* aion_player_alloc(const char *charname, size_t charname_len)
 {
     struct aion_player *curplayer;
 
-    if (aion_player_is_self(charname))
+    if (aion_player_is_self(charname, charname_len))
     {
         return &aion_player_self;
     }
 
-    /* Scan the list of cached players, if we find it there, return it */
-    LIST_FOREACH(curplayer, &aion_players_cached, apl_cached)
+    curplayer = aion_player_find(charname, charname_len);
+    if (curplayer != NULL)
     {
-        if (strcasecmp(curplayer->apl_name, charname) != 0) continue;
-
         /* Found player -- move it to the head of the list and return it */
-        LIST_REMOVE(curplayer, apl_cached);
-        LIST_INSERT_HEAD(&aion_players_cached, curplayer, apl_cached);
+        TAILQ_REMOVE(&aion_players_cached, curplayer, apl_cached);
+        TAILQ_INSERT_HEAD(&aion_players_cached, curplayer, apl_cached);
 
         return curplayer;
     }
 
-    curplayer = malloc(sizeof(struct aion_player));
-    assert(curplayer != NULL);
+    curplayer = aion_pool_get();
+    if (curplayer == NULL)
+    {
+        return NULL;
+    }
 
-    aion_player_init(curplayer, charname);
+    aion_player_init(curplayer, charname, charname_len);
+
+    if (!aion_index_insert(curplayer))
+    {
+        aion_pool_put(curplayer);
+        return NULL;
+    }
 
     /* Add the player to the cached list */
-    LIST_INSERT_HEAD(&aion_players_cached, curplayer, apl_cached);
+    TAILQ_INSERT_HEAD(&aion_players_cached, curplayer, apl_cached);
+
+    aion_players_num++;
+
+    aion_players_evict(curplayer);
 
     return curplayer;
 }
@@ -326,24 +933,133 @@ struct aion_player* aion_player_alloc(char *charname)
 /**
  * Cache a chat line from character @p charname
  *
+ * Neither @p charname nor @p chat have to be NUL terminated, they are copied
+ * only to the chat history, which is shared by all players, see @ref aion_chat_arena.
+ *
  * @param[in]       charname        Character name
+ * @param[in]       charname_len    Length of @p charname
  * @param[in]       chat            Chat line
+ * @param[in]       chat_len        Length of @p chat
  *
  * @return
  *      Returns false on error, but that shouldn't happen.
  */
-bool aion_player_chat_cache(char *charname, char *chat)
+bool aion_player_chat_cache(const char *charname, size_t charname_len, const char *chat, size_t chat_len)
 {
     struct aion_player *player;
 
-    player = aion_player_alloc(charname);
+    player = aion_player_alloc(charname, charname_len);
     if (player == NULL)
     {
         con_printf("Error caching chat\n");
         return false;
     }
 
-    tb_strput(&player->apl_txtbuf, chat);
+    return aion_chat_put(player, chat, chat_len);
+}
+
+/**
+ * Store a chat line of @p player to the chat arena
+ *
+ * The oldest records are overwritten to make room for it.
+ *
+ * @param[in]       player          Player
+ * @param[in]       chat            Chat line, doesn't have to be NUL terminated
+ * @param[in]       chat_len        Length of @p chat, it is cropped to AION_CHAT_SZ - 1
+ *
+ * @retval          true            On success
+ * @retval          false           If the arena cannot be allocated
+ */
+bool aion_chat_put(struct aion_player *player, const char *chat, size_t chat_len)
+{
+    struct aion_chat_arena *aca = &aion_chat_arena;
+    struct aion_chat_rec *rec;
+    size_t rec_size;
+    size_t off;
+    size_t pad;
+
+    if (aca->aca_buf == NULL)
+    {
+        aca->aca_buf = malloc(AION_CHAT_ARENA_SZ);
+        if (aca->aca_buf == NULL)
+        {
+            con_printf("Unable to allocate the chat arena\n");
+            return false;
+        }
+    }
+
+    if (chat_len >= AION_CHAT_SZ)
+    {
+        chat_len = AION_CHAT_SZ - 1;
+    }
+
+    rec_size = (sizeof(struct aion_chat_rec) + chat_len + 1 + AION_CHAT_ALIGN - 1) & ~(size_t)(AION_CHAT_ALIGN - 1);
+
+    /* Pad to the end of the arena if the record would wrap */
+    off = aca->aca_tail % AION_CHAT_ARENA_SZ;
+    pad = (off + rec_size > AION_CHAT_ARENA_SZ) ? AION_CHAT_ARENA_SZ - off : 0;
+
+    /* Overwrite the oldest records */
+    while ((aca->aca_tail - aca->aca_head) + pad + rec_size > AION_CHAT_ARENA_SZ)
+    {
+        rec = (struct aion_chat_rec *)(aca->aca_buf + (aca->aca_head % AION_CHAT_ARENA_SZ));
+        aca->aca_head += rec->acr_size;
+    }
+
+    if (pad != 0)
+    {
+        rec = (struct aion_chat_rec *)(aca->aca_buf + off);
+        rec->acr_prev = AION_CHAT_NONE;
+        rec->acr_size = pad;
+        rec->acr_len  = 0;
+        aca->aca_tail += pad;
+        off = 0;
+    }
+
+    rec = (struct aion_chat_rec *)(aca->aca_buf + off);
+    rec->acr_prev = player->apl_chat;
+    rec->acr_size = rec_size;
+    rec->acr_len  = chat_len;
+    memcpy(rec + 1, chat, chat_len);
+    ((char *)(rec + 1))[chat_len] = '\0';
+
+    player->apl_chat = aca->aca_tail;
+    aca->aca_tail += rec_size;
+
+    return true;
+}
+
+/**
+ * Retrieve a chat line of @p player from the chat arena
+ *
+ * The lines of the player are walked from the most recent one, so this is
+ * O(@p msgnum).
+ *
+ * @param[in]       player          Player
+ * @param[in]       msgnum          Chat line number in reverse order (0 = most recent)
+ * @param[out]      dst             Destination buffer
+ * @param[in]       dst_sz          Size of @p dst
+ *
+ * @retval          true            On success
+ * @retval          false           If the line was overwritten or never existed
+ */
+bool aion_chat_get(struct aion_player *player, int msgnum, char *dst, size_t dst_sz)
+{
+    struct aion_chat_arena *aca = &aion_chat_arena;
+    struct aion_chat_rec *rec;
+    uint64_t pos;
+
+    if (msgnum < 0 || dst_sz == 0) return false;
+
+    for (pos = player->apl_chat; ; pos = rec->acr_prev)
+    {
+        if ((pos == AION_CHAT_NONE) || (pos < aca->aca_head)) return false;
+
+        rec = (struct aion_chat_rec *)(aca->aca_buf + (pos % AION_CHAT_ARENA_SZ));
+        if (msgnum-- == 0) break;
+    }
+
+    util_strlcpy(dst, (char *)(rec + 1), dst_sz);
 
     return true;
 }
@@ -363,39 +1079,39 @@ bool aion_player_chat_get(char *charname, int msgnum, char *dst, size_t dst_sz)
 {
     struct aion_player *player;
 
-    player = aion_player_alloc(charname);
+    player = aion_player_alloc(charname, strlen(charname));
     if (player == NULL)
     {
         return false;
     }
 
-    return tb_strlast(&player->apl_txtbuf, msgnum, dst, dst_sz);
+    return aion_chat_get(player, msgnum, dst, dst_sz);
 }
 
 /**
  * Search the current group for a character with the name of @p charname
  *
- * @param[in]       charname    Character name
+ * @param[in]       charname        Character name, doesn't have to be NUL terminated
+ * @param[in]       charname_len    Length of @p charname
  *
  * @return 
  *      Returns the associated aion_player structure or NULL if @p charname
  *      was not found in the current group list.
  */
-struct aion_player* aion_group_find(char *charname)
+struct aion_player* aion_group_find(const char *charname, size_t charname_len)
 {
     struct aion_player *curplayer;
 
-    if (aion_player_is_self(charname))
+    if (aion_player_is_self(charname, charname_len))
     {
         return &aion_player_self;
     }
 
-    LIST_FOREACH(curplayer, &aion_group, apl_group)
+    /* Group members are always cached */
+    curplayer = aion_player_find(charname, charname_len);
+    if ((curplayer != NULL) && curplayer->apl_grouped)
     {
-        if (strcasecmp(curplayer->apl_name, charname) == 0)
-        {
-            return curplayer;
-        }
+        return curplayer;
     }
 
     return NULL;
@@ -406,17 +1122,18 @@ struct aion_player* aion_group_find(char *charname)
  *
  * If the character is already on the list, do nothing.
  *
- * @param[in]       charname    Character name
+ * @param[in]       charname        Character name, doesn't have to be NUL terminated
+ * @param[in]       charname_len    Length of @p charname
  * 
  * @retval          true        On success
  * @retval          false       On error
  */
-bool aion_group_join(char *charname)
+bool aion_group_join(const char *charname, size_t charname_len)
 {
     struct aion_player *player;
    
     /* Check if the player is already in the group */
-    player = aion_group_find(charname);
+    player = aion_group_find(charname, charname_len);
     if (player != NULL)
     {
         event_signal(EVENT_AION_GROUP_UPDATE);
@@ -424,7 +1141,7 @@ bool aion_group_join(char *charname)
         return true;
     }
 
-    player = aion_player_alloc(charname);
+    player = aion_player_alloc(charname, charname_len);
     if (player == NULL)
     {
         con_printf("ERROR: Unable to allocate player\n");
@@ -436,6 +1153,7 @@ bool aion_group_join(char *charname)
 
     /* Insert this player to the group list */
     LIST_INSERT_HEAD(&aion_group, player, apl_group);
+    player->apl_grouped = true;
 
     event_signal(EVENT_AION_GROUP_UPDATE);
     aion_group_dump();
@@ -449,18 +1167,19 @@ bool aion_group_join(char *charname)
  *
  * If @p charname is the player itself, disband the group -- we're alone again :(
  *
- * @param[in]       charname        Character name
+ * @param[in]       charname        Character name, doesn't have to be NUL terminated
+ * @param[in]       charname_len    Length of @p charname
  *
  * @retval          true            On success
  * @retval          false           On error
  *
  * @bug Always returns true?
  */ 
-bool aion_group_leave(char *charname)
+bool aion_group_leave(const char *charname, size_t charname_len)
 {
     struct aion_player *player;
 
-    player = aion_group_find(charname);
+    player = aion_group_find(charname, charname_len);
     if (player == NULL)
     {
         /* Player was not in the group list, so no need to remove it :( */
@@ -476,6 +1195,7 @@ bool aion_group_leave(char *charname)
     else
     {
         LIST_REMOVE(player, apl_group);
+        player->apl_grouped = false;
         /* Update with the new status */
         event_signal(EVENT_AION_GROUP_UPDATE);
     }
@@ -502,6 +1222,7 @@ void aion_group_disband(void)
         if (curplayer != &aion_player_self)
         {
             LIST_REMOVE(curplayer, apl_group);
+            curplayer->apl_grouped = false;
         }
     }
 
@@ -520,10 +1241,11 @@ void aion_group_disband(void)
  * @note
  * This function will also update the application main screen.
  *
- * @param[in]       charname        The player that looted the item
+ * @param[in]       charname        The player that looted the item, doesn't have to be NUL terminated
+ * @param[in]       charname_len    Length of @p charname
  * @param[in]       itemid          The itemID as parsed from the chatlog
  */
-void aion_group_loot(char *charname, uint32_t itemid)
+void aion_group_loot(const char *charname, size_t charname_len, uint32_t itemid)
 {
     struct aion_player *player;
     struct item *item;
@@ -535,11 +1257,11 @@ void aion_group_loot(char *charname, uint32_t itemid)
     /* If the player looted an AP item, add it to the group automatically */
     if ((item != NULL) && (item->item_ap > 0))
     {
-        aion_group_join(charname);
+        aion_group_join(charname, charname_len);
     }
 
     /* If the player is not part of the group, do nothing */
-    player = aion_group_find(charname);
+    player = aion_group_find(charname, charname_len);
     if (player == NULL)
     {
         return;
@@ -548,23 +1270,26 @@ void aion_group_loot(char *charname, uint32_t itemid)
     /* Check if this player's inventory is marked as full */
     if (player->apl_invfull)
     {
-        aion_invfull_set(charname, false);
+        aion_invfull_set(charname, charname_len, false);
         update_stats = true;
     }
 
+    player->apl_loot++;
+
     if (item != NULL)
     {
         if (item->item_ap > 0)
         {
-            aion_group_apvalue_update(charname, item->item_ap);
+            player->apl_loot_ap++;
+            aion_group_apvalue_update(charname, charname_len, item->item_ap);
             update_stats = true;
         }
 
-        con_printf("LOOT: %s -> %s (%u AP)\n", charname, item->item_name, item->item_ap);
+        con_printf("LOOT: %.*s -> %s (%u AP)\n", (int)charname_len, charname, item->item_name, item->item_ap);
     }
     else
     {
-        con_printf("LOOT: %s -> %u\n", charname, itemid);
+        con_printf("LOOT: %.*s -> %u\n", (int)charname_len, charname, itemid);
     }
 
     /* Update loot statistics */
@@ -581,7 +1306,8 @@ void aion_group_loot(char *charname, uint32_t itemid)
 /**
  * Update the AP statistics for @p charname
  *
- * @param[in]       charname        Character name
+ * @param[in]       charname        Character name, doesn't have to be NUL terminated
+ * @param[in]       charname_len    Length of @p charname
  * @param[in]       apval           Abyss points
  *
  * @retval          true            On success
@@ -589,14 +1315,14 @@ void aion_group_loot(char *charname, uint32_t itemid)
  *
  * @note This function will update the application's main screen.
  */
-bool aion_group_apvalue_update(char *charname, uint32_t apval)
+bool aion_group_apvalue_update(const char *charname, size_t charname_len, uint32_t apval)
 {
     struct aion_player *player;
 
-    player = aion_group_find(charname);
+    player = aion_group_find(charname, charname_len);
     if (player == NULL)
     {
-        con_printf("ERROR: Player %s is not in the group.\n", charname);
+        con_printf("ERROR: Player %.*s is not in the group.\n", (int)charname_len, charname);
         return false;
     }
 
@@ -622,7 +1348,7 @@ bool aion_group_apvalue_set(char *charname, uint32_t apval)
 {
     struct aion_player *player;
 
-    player = aion_group_find(charname);
+    player = aion_group_find(charname, strlen(charname));
 
     if (player == NULL)
     {
@@ -645,13 +1371,19 @@ bool aion_group_apvalue_set(char *charname, uint32_t apval)
  */
 void aion_apvalue_reset(void)
 {
-    struct aion_player *player;
+    struct aion_slab *slab;
+    size_t ii;
 
-    /* Reset statistics for ALL players */
-    LIST_FOREACH(player, &aion_players_cached, apl_cached)
+    /* Reset statistics for ALL players, the slabs are walked in memory order */
+    LIST_FOREACH(slab, &aion_players_pool.app_slabs, as_slabs)
     {
-        player->apl_apvalue = 0;
-        player->apl_invfull = false;
+        for (ii = 0; ii < AION_SLAB_PLAYERS; ii++)
+        {
+            if (!slab->as_player[ii].apl_inuse) continue;
+
+            slab->as_player[ii].apl_apvalue = 0;
+            slab->as_player[ii].apl_invfull = false;
+        }
     }
 
     /* The current player is not in the global cache list */
@@ -692,7 +1424,8 @@ uint32_t aion_group_apvalue_lowest(void)
 /**
  * Set the <I>intentory full</I> flag for @p charname
  * 
- * @param[in]       charname        Character name
+ * @param[in]       charname        Character name, doesn't have to be NUL terminated
+ * @param[in]       charname_len    Length of @p charname
  * @param[in]       isfull          Full inventory flag
  *
  * @retval          true            On success
@@ -700,14 +1433,14 @@ uint32_t aion_group_apvalue_lowest(void)
  *
  * @note This function will update the application's main screen.
  */
-bool aion_invfull_set(char *charname, bool isfull)
+bool aion_invfull_set(const char *charname, size_t charname_len, bool isfull)
 {
     struct aion_player *player;
 
-    player = aion_group_find(charname);
+    player = aion_group_find(charname, charname_len);
     if (player == NULL)
     {
-        con_printf("invfull_set(): Unable to find player: %s\n", charname);
+        con_printf("invfull_set(): Unable to find player: %.*s\n", (int)charname_len, charname);
         return false;
     }
 
@@ -733,7 +1466,7 @@ bool aion_invfull_get(char *charname)
 {
     struct aion_player *player;
 
-    player = aion_group_find(charname);
+    player = aion_group_find(charname, strlen(charname));
     if (player == NULL)
     {
         con_printf("invfull_get(): Unable to find player: %s\n", charname);
@@ -776,11 +1509,17 @@ bool aion_invfull_excl_get(void)
  */ 
 void aion_invfull_clear(void)
 {
-    struct aion_player *player;
+    struct aion_slab *slab;
+    size_t ii;
 
-    LIST_FOREACH(player, &aion_players_cached, apl_cached)
+    LIST_FOREACH(slab, &aion_players_pool.app_slabs, as_slabs)
     {
-        player->apl_invfull = false;
+        for (ii = 0; ii < AION_SLAB_PLAYERS; ii++)
+        {
+            if (!slab->as_player[ii].apl_inuse) continue;
+
+            slab->as_player[ii].apl_invfull = false;
+        }
     }
 
     /* The current player is not in the global cache list */
@@ -1232,12 +1971,16 @@ void aion_group_iter_fill(struct aion_group_iter *iter, struct aion_player *play
         iter->agi_name      = "";
         iter->agi_apvalue   = 0;
         iter->agi_invfull   = false;
+        iter->agi_loot      = 0;
+        iter->agi_loot_ap   = 0;
     }
     else
     {
         iter->agi_name      = player->apl_name;
         iter->agi_apvalue   = player->apl_apvalue;
         iter->agi_invfull   = player->apl_invfull;
+        iter->agi_loot      = player->apl_loot;
+        iter->agi_loot_ap   = player->apl_loot_ap;
     }
 }
 
@@ -1270,6 +2013,8 @@ void aion_group_first(struct aion_group_iter *iter)
 {
     struct aion_player *player;
 
+    iter->__agi_cached = false;
+
     player = LIST_FIRST(&aion_group);
     aion_group_iter_fill(iter, player);
 }
@@ -1277,7 +2022,7 @@ void aion_group_first(struct aion_group_iter *iter)
 /**
  * Move to the next character in the group
  *
- * @p iter should be initialized with aion_group_first()
+ * @p iter should be initialized with aion_group_first() or aion_players_first()
  *
  * @param[in,out]       iter        Current/Next player data
  *
@@ -1288,10 +2033,35 @@ void aion_group_next(struct aion_group_iter *iter)
 {
     struct aion_player *player;
 
-    player = LIST_NEXT(iter->__agi_curplayer, apl_group);
+    if (iter->__agi_cached)
+    {
+        player = (iter->__agi_curplayer == &aion_player_self) ?
+                    TAILQ_FIRST(&aion_players_cached) :
+                    TAILQ_NEXT(iter->__agi_curplayer, apl_cached);
+    }
+    else
+    {
+        player = LIST_NEXT(iter->__agi_curplayer, apl_group);
+    }
+
     aion_group_iter_fill(iter, player);
 }
 
+/**
+ * Same as aion_group_first(), but the iterator traverses all known players,
+ * not just the group. This includes players that already left the group.
+ *
+ * The player comes first, followed by the cached players in most recently used
+ * order. Use aion_group_next() and aion_group_end() to continue.
+ *
+ * @param[in,out]       iter        Player iterator
+ */
+void aion_players_first(struct aion_group_iter *iter)
+{
+    iter->__agi_cached = true;
+    aion_group_iter_fill(iter, &aion_player_self);
+}
+
 /**
  * Checks if the current iterator reached end of the list
  *
@@ -1321,11 +2091,11 @@ void aion_group_dump(void)
     }
 
     con_printf("------- Cached \n");
-    LIST_FOREACH(curplayer, &aion_players_cached, apl_cached)
+    TAILQ_FOREACH(curplayer, &aion_players_cached, apl_cached)
     {
         char chat[AION_CHAT_SZ];
 
-        if (!tb_strlast(&curplayer->apl_txtbuf, 0, chat, sizeof(chat)))
+        if (!aion_chat_get(curplayer, 0, chat, sizeof(chat)))
         {
             chat[0] = '\0';
         }
@@ -1336,6 +2106,57 @@ void aion_group_dump(void)
     con_printf("======\n");
 }
 
+#if TEST
+/**
+ * @cond AION_UNITTEST
+ */
+int main(void)
+{
+    char name[AION_NAME_SZ];
+    uint64_t evicted;
+    size_t max_bytes;
+    int ii;
+
+    aion_session_init(false);
+
+    /* 8 full slabs, then limit the cache to a bit more than that */
+    aion_players_limit_set(0, 0);
+    for (ii = 0; ii < 8 * AION_SLAB_PLAYERS; ii++)
+    {
+        snprintf(name, sizeof(name), "Player%d", ii);
+        if (aion_player_alloc(name, strlen(name)) == NULL) return 1;
+    }
+
+    max_bytes = 8 * sizeof(struct aion_slab) + sizeof(struct aion_slab) / 2;
+    aion_players_limit_set(0, max_bytes);
+    printf("limit %u KB: %u cached, %u evicted\n",
+           (unsigned)(max_bytes / 1024), (unsigned)aion_players_num, (unsigned)aion_players_evicted);
+
+    /* Each new player must evict exactly one */
+    for (; ii < 100 * AION_SLAB_PLAYERS; ii++)
+    {
+        snprintf(name, sizeof(name), "Player%d", ii);
+
+        evicted = aion_players_evicted;
+        if (aion_player_alloc(name, strlen(name)) == NULL) return 1;
+
+        if (aion_players_evicted - evicted != 1)
+        {
+            printf("FAIL: %s evicted %u players\n", name, (unsigned)(aion_players_evicted - evicted));
+            return 1;
+        }
+    }
+
+    printf("%u cached, %u slabs, %u evicted\n",
+           (unsigned)aion_players_num, (unsigned)aion_players_pool.app_nslabs, (unsigned)aion_players_evicted);
+
+    return 0;
+}
+/**
+ * @endcond
+ */
+#endif
+
 /**
  * @}
  */
@@ -53,6 +53,15 @@
 /** Name of the chatlog variable in the system.ovr file */
 #define AION_SYSOVR_CHATLOG "g_chatlog"
 
+/** Name of the client language variable in the system.ovr file */
+#define AION_SYSOVR_LANG    "g_lang"
+
+/** Default maximum number of cached players, see aion_players_limit_set() */
+#define AION_PLAYERS_MAX    1024
+
+/** Size of the chat history shared by all players, in bytes */
+#define AION_CHAT_ARENA_SZ  (256 * 1024)
+
 /** This is the number characters that Aion allowts to be paste */
 #define AION_CLIPBOARD_MAX 255
 
@@ -65,20 +74,22 @@
 /** Default format */
 #define AION_APLOOT_FORMAT_DEFAULT  AION_APLOOT_FORMAT_SHORT
 extern bool aion_init(void);
+extern void aion_session_init(bool clipboard);
+extern void aion_session_free(void);
 extern bool aion_clipboard_set(char *text);
 
-extern bool aion_player_is_self(char *charname);
-extern bool aion_group_join(char *charname);
-extern bool aion_group_leave(char *charname);
+extern bool aion_player_is_self(const char *charname, size_t charname_len);
+extern bool aion_group_join(const char *charname, size_t charname_len);
+extern bool aion_group_leave(const char *charname, size_t charname_len);
 extern void aion_group_disband(void);
-extern void aion_group_loot(char *charname, uint32_t itemid);
+extern void aion_group_loot(const char *charname, size_t charname_len, uint32_t itemid);
 
 extern void aion_apvalue_reset(void);
-extern bool aion_group_apvalue_update(char *charname, uint32_t apval);
+extern bool aion_group_apvalue_update(const char *charname, size_t charname_len, uint32_t apval);
 extern bool aion_group_apvalue_set(char *charname, uint32_t apval);
 extern uint32_t aion_group_apvalue_lowest(void);
 
-extern bool aion_invfull_set(char *charname, bool isfull);
+extern bool aion_invfull_set(const char *charname, size_t charname_len, bool isfull);
 extern bool aion_invfull_get(char *charname);
 extern void aion_invfull_excl_set(bool enable);
 extern bool aion_invfull_excl_get(void);
@@ -87,9 +98,11 @@ extern void aion_invfull_clear(void);
 extern void aion_aplimit_set(uint32_t aplimit);
 extern uint32_t aion_aplimit_get(void);
 
-extern bool aion_player_chat_cache(char *charname, char *chat);
+extern bool aion_player_chat_cache(const char *charname, size_t charname_len, const char *chat, size_t chat_len);
 extern bool aion_player_chat_get(char *charname, int msgnum, char *dst, size_t dst_sz);
 extern void aion_player_name_set(char *charname);
+extern void aion_players_limit_set(size_t max, size_t max_bytes);
+extern bool aion_players_stats(char *stats, size_t stats_sz);
 
 /**
  * The group iterator structure
@@ -103,11 +116,15 @@ struct aion_group_iter
     char                *agi_name;          /**< Player name                */
     uint32_t            agi_apvalue;        /**< Accumulated abyss points   */
     bool                agi_invfull;        /**< Inventory full flag        */
+    uint32_t            agi_loot;           /**< Number of looted items     */
+    uint32_t            agi_loot_ap;        /**< Number of looted AP items  */
 
     struct aion_player  *__agi_curplayer;   /**< Internal, do not use       */
+    bool                __agi_cached;       /**< Internal, do not use       */
 };
 
 extern void aion_group_first(struct aion_group_iter *iter);
+extern void aion_players_first(struct aion_group_iter *iter);
 extern void aion_group_next(struct aion_group_iter *iter);
 extern bool aion_group_end(struct aion_group_iter *iter);
 
@@ -133,6 +150,7 @@ extern bool aion_aploot_fmt_set(char *fmt);
 extern char* aion_default_install_path(void);
 extern bool aion_chatlog_is_enabled(bool *isenabled);
 extern bool aion_chatlog_enable(void);
+extern bool aion_sysovr_get(char *name, char *val, size_t val_sz);
 
 /**
  * @}
@@ -155,6 +155,9 @@ char *aion_default_install_path(void)
 /** Pattern for matching system.ovr values */
 #define RE_SYSTEM_OVR "^ *([a-zA-Z0-9_]+) *= *\"?([0-9]+)\"?"
 
+/** Pattern for matching system.ovr values that are not numbers */
+#define RE_SYSTEM_OVR_STR "^ *([a-zA-Z0-9_]+) *= *\"?([a-zA-Z0-9_]+)\"?"
+
 /**
  * Figure out the full path of the system.ovr file
  *
@@ -267,6 +270,71 @@ bool aion_chatlog_is_enabled(bool *isenabled)
     return true;
 }
 
+/**
+ * Read the value of the variable @p name from the system.ovr file
+ *
+ * @param[in]       name            Variable name, case insensitive
+ * @param[out]      val             Variable value
+ * @param[in]       val_sz          Size of @p val
+ *
+ * @retval          true            If the variable was found
+ * @retval          false           If the variable or the system.ovr file
+ *                                  doesn't exist, or on error
+ */
+bool aion_sysovr_get(char *name, char *val, size_t val_sz)
+{
+    char sysovr_path[1024];
+    char sysovr_line[1024];
+    regex_t re_sysovr;
+    FILE *sysovr_file;
+    bool found = false;
+    int retval;
+
+    retval = regcomp(&re_sysovr, RE_SYSTEM_OVR_STR, REG_EXTENDED);
+    if (retval != 0)
+    {
+        con_printf("Error compiling system.ovr regex: %s\n", RE_SYSTEM_OVR_STR);
+        return false;
+    }
+
+    if (!aion_get_sysovr_path(sysovr_path, sizeof(sysovr_path)))
+    {
+        con_printf("Unable to retrieve the full path to SYSTEM.OVR\n");
+        regfree(&re_sysovr);
+        return false;
+    }
+
+    sysovr_file = fopen(sysovr_path, "r");
+    if (sysovr_file == NULL)
+    {
+        regfree(&re_sysovr);
+        return false;
+    }
+
+    while (fgets(sysovr_line, sizeof(sysovr_line), sysovr_file) != NULL)
+    {
+        regmatch_t rem[3];
+        char sysovr_cmd[64];
+
+        if (regexec(&re_sysovr, sysovr_line, sizeof(rem) / sizeof(rem[0]), rem, 0) != 0)
+        {
+            continue;
+        }
+
+        re_strlcpy(sysovr_cmd, sysovr_line, sizeof(sysovr_cmd), rem[1]);
+        if (strcasecmp(sysovr_cmd, name) != 0) continue;
+
+        re_strlcpy(val, sysovr_line, val_sz, rem[2]);
+        found = true;
+        break;
+    }
+
+    fclose(sysovr_file);
+    regfree(&re_sysovr);
+
+    return found;
+}
+
 /**
  * Enable the chatlog feature of the Aion game client
  *
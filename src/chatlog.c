@@ -31,11 +31,23 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <stdarg.h>
 #include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef SYS_UNIX
+#include <fcntl.h>
+#endif
 
 #include <pcreposix.h>
+#ifdef CHATLOG_ZLIB
+#include <zlib.h>
+#endif
 
 #include "regeng.h"
+#include "chatlog_re.h"
+#include "chatlog_idx.h"
 #include "util.h"
 #include "aion.h"
 #include "cmd.h"
@@ -57,448 +69,275 @@
  * 
  * @{
  */
-/** Character name regex pattern            */
-#define RE_NAME     "([[:alnum:]]+)"
-/** Item number regex pattern               */
-#define RE_ITEM     "\\[item:([[:digit:]]+).*\\]"
-/** Item link regex pattern                 */
-#define RE_NUM_ROLL "[0-9\\.]+"
-
-#define RE_ITEM_LOOT_SELF           100         /**< Event, item looted by player           */
-#define RE_ITEM_LOOT_PLAYER         101         /**< Event, item looted by a character      */
-
-#define RE_DAMAGE_INFLICT           200         /**< Damage was inflicted                   */
-#define RE_DAMAGE_CRITICAL          201         /**< Damage was inflicted and was critical  */
-
-#define RE_GROUP_SELF_JOIN          300         /**< The player joined a group              */
-#define RE_GROUP_SELF_LEAVE         301         /**< The player left the group              */
-#define RE_GROUP_SELF_KICK          302         /**< The player has been kicked             */
-#define RE_GROUP_PLAYER_JOIN        303         /**< Some other player joined the group     */
-#define RE_GROUP_PLAYER_LEAVE       304         /**< Some other player left the group       */
-#define RE_GROUP_PLAYER_DISCONNECT  305         /**< Some player was disconnected           */
-#define RE_GROUP_PLAYER_KICK        306         /**< A player was kicked from the group     */
-#define RE_GROUP_PLAYER_OFFLINE     307         /**< A player in the group went offline     */
-#define RE_GROUP_DISBAND            308         /**< The group was disbanded                */
-
-#define RE_ALI_SELF_JOIN            350         /**< The player joined a group              */
-#define RE_ALI_SELF_LEAVE           351         /**< The player left the group              */
-#define RE_ALI_SELF_KICK            352         /**< The player has been kicked from the ali*/
-#define RE_ALI_PLAYER_JOIN          353         /**< Some other player joined the group     */
-#define RE_ALI_PLAYER_LEAVE         354         /**< Some other player left the group       */
-#define RE_ALI_PLAYER_DISCONNECT    355         /**< Some player was disconnected           */
-#define RE_ALI_PLAYER_KICK          356         /**< A player was kicked from the group     */
-#define RE_ALI_PLAYER_OFFLINE       357         /**< A player in the group went offline     */
-#define RE_ALI_DISBAND              358         /**< The group was disbanded                */
-
-#define RE_CHAT_SELF                400         /**< Chat from the player itself            */
-#define RE_CHAT_GENERAL             401         /**< General chat                           */
-#define RE_CHAT_WHISPER             402         /**< A whisper was received                 */
-#define RE_CHAT_SHOUT               403         /**< Somebody shouteed something            */
-
-#define RE_ROLL_ITEM_SELF           500         /**< The player rolled on an item           */
-#define RE_ROLL_ITEM_PLAYER         501         /**< Some other player rolled on an item    */
-#define RE_ROLL_ITEM_PASS           502         /**< The player passed on an item           */
-#define RE_ROLL_ITEM_HIGHEST        503         /**< Somebody rolled the highest            */
-#define RE_ROLL_DICE_SELF           504         /**< The player used /roll to roll a dice   */
-#define RE_ROLL_DICE_PLAYER         505         /**< Group member used /roll to roll a dice */
-
 static FILE* chatlog_file = NULL;   /**< Chatlog FILE descriptor            */
 
-static bool chatlog_open(void); 
-static re_callback_t chatlog_parse; /**< Declaration of chatlog_parse()     */
+/** Size of the blocks read from the chatlog, also the maximum line length */
+#define CHATLOG_READ_SZ         (64 * 1024)
 
 /**
- * Define chatlog regex patterns and corresponding event.
- *
- * This list is scanned from beginning to end. If a regular expressions matches,
- * an event is generated.
- *
- * For speed reasons, try to put most commonly matched regular expressions at the
- * beginning
- *
- * @see regeng
+ * Block reader state
  *
- * @showinitializer
+ * The chatlog is read in CHATLOG_READ_SZ blocks and the lines are parsed in
+ * place. The incomplete line at the end of a block is moved to the start of
+ * the buffer and completed by the next read.
  */
-struct regeng re_aion[] =
+struct chatlog_reader
 {
-#if 0
-    /* The following patterns are not used  */
-    {
-        .re_id  = RE_DAMAGE_INFLICT,
-        .re_exp = "^: " RE_NAME " inflicted ([0-9.]+) damage on ([A-Za-z ]+) by using ([A-Za-z ]+)\\.",
-    },
-    {
-        .re_id  = RE_DAMAGE_CRITICAL,
-        .re_exp = "^: Critical Hit! You inflicted ([0-9.]+) critical damage on ([A-Za-z ]+)\\.",
-    },
-    /* XXX Chat self is not reliable, disabling for the moment. */
-    {
-        .re_id  = RE_CHAT_SELF,
-        .re_exp = "^: " RE_NAME ": (.*)$",
-    },
+    size_t      cr_len;                         /**< Length of the incomplete line in cr_buf    */
+    bool        cr_skip;                        /**< Discard data up to the next new-line       */
+    uint64_t    cr_pos;                         /**< File offset of cr_buf, the end of the last
+                                                     complete line                              */
+    uint64_t    cr_hash;                        /**< Hash of the line that ends at cr_pos       */
+    size_t      cr_hash_len;                    /**< Length of that line, 0 if unknown          */
+#ifdef CHATLOG_ZLIB
+    gzFile      cr_gz;                          /**< Compressed file to read instead of a FILE  */
 #endif
+    char        cr_buf[CHATLOG_READ_SZ];        /**< Read buffer                                */
+};
 
-    /* Item looted by the player */
-    {
-        .re_id  = RE_ITEM_LOOT_SELF,
-        .re_exp = "^: You have acquired " RE_ITEM,
-    },
-    {
-        .re_id  = RE_ITEM_LOOT_SELF,
-        .re_exp = "^: Vous avez gagné " RE_ITEM,
-    },
-    {
-        .re_id  = RE_ITEM_LOOT_SELF,
-        .re_exp = "^: Ihr habt " RE_ITEM " erhalten\\.",
-    },
-
-    /* Item lootd by another player */
-    {
-        .re_id  = RE_ITEM_LOOT_PLAYER,
-        .re_exp = "^: " RE_NAME " has acquired " RE_ITEM,
-    },
-    {
-        .re_id  = RE_ITEM_LOOT_PLAYER,
-        .re_exp = "^: " RE_NAME " a gagné " RE_ITEM,
-    },
-    {
-        .re_id  = RE_ITEM_LOOT_PLAYER,
-        .re_exp = "^: " RE_NAME " hat " RE_ITEM " erhalten\\."
-    },
-
-    /* The player joined a group */
-    {
-        .re_id  = RE_GROUP_SELF_JOIN,
-        .re_exp = "^: You have joined the group\\.",
-    },
-    {
-        .re_id  = RE_GROUP_SELF_JOIN,
-        .re_exp = "^: Vous avez rejoint le groupe\\.",
-    },
-    {
-        .re_id  = RE_GROUP_SELF_JOIN,
-        .re_exp = "^: Ihr seid der Gruppe beigetreten\\.",
-    },
-
-    /* The player has left the group */
-    {
-        .re_id  = RE_GROUP_SELF_LEAVE,
-        .re_exp = "^: You left the group\\.",
-    },
-    {
-        .re_id  = RE_GROUP_SELF_LEAVE,
-        .re_exp = "^: Vous avez quitté le groupe\\.",
-    },
-    {
-        .re_id  = RE_GROUP_SELF_LEAVE,
-        .re_exp = "^: Ihr habt die Gruppe verlassen\\.",
-    },
-
-    /* The player has been kicked */
-    {
-        .re_id  = RE_GROUP_SELF_KICK,
-        .re_exp = "^: You have been kicked out of the group\\.",
-    },
-    {
-        .re_id  = RE_GROUP_SELF_KICK,
-        .re_exp = "^: Vous avez été exclue du groupe\\.",
-    },
-    {
-        .re_id  = RE_GROUP_SELF_KICK,
-        .re_exp = "^: Ihr wurdet aus der Gruppe geworfen\\.",
-    },
-
-    /* Another player has joined the group */
-    {
-        .re_id  = RE_GROUP_PLAYER_JOIN,
-        .re_exp = "^: " RE_NAME " has joined your group\\.",
-    },
-    {
-        .re_id  = RE_GROUP_PLAYER_JOIN,
-        .re_exp = "^: " RE_NAME " a rejoint votre groupe\\.",
-    },
-    {
-        .re_id  = RE_GROUP_PLAYER_JOIN,
-        .re_exp = "^: " RE_NAME " ist Eurer Gruppe beigetreten.",
-    },
-
-    /* Another player has left the gruop */
-    {
-        .re_id  = RE_GROUP_PLAYER_LEAVE,
-        .re_exp = "^: " RE_NAME " has left your group\\.",
-    },
-    {
-        .re_id  = RE_GROUP_PLAYER_LEAVE,
-        .re_exp = "^: " RE_NAME " a quitté votre groupe\\.",
-    },
-    {
-        .re_id  = RE_GROUP_PLAYER_LEAVE,
-        .re_exp = "^: " RE_NAME " hat Eure Gruppe verlassen\\."
-    },
-
-    /* Another player has been disconnected */
-    {
-        .re_id  = RE_GROUP_PLAYER_DISCONNECT,
-        .re_exp = "^: " RE_NAME " has been disconnected\\.",
-    },
-    {
-        .re_id  = RE_GROUP_PLAYER_DISCONNECT,
-        .re_exp = "^: " RE_NAME " a quitté Atréia.\\.",
-    },
-
-    /* A player has ben kicked from the group */
-    {
-        .re_id  = RE_GROUP_PLAYER_KICK,
-        .re_exp = "^: " RE_NAME " has been kicked out of your group\\.",
-    },
-    {
-        .re_id  = RE_GROUP_PLAYER_KICK,
-        .re_exp = "^: " RE_NAME " a été exclue de votre groupe\\.",
-    },
-    {
-        .re_id  = RE_GROUP_PLAYER_KICK,
-        .re_exp = "^: " RE_NAME " wurde aus Eurer Gruppe geworfen\\.",
-    },
-
-    /* Another player has been offlie for too long */
-    {
-        .re_id  = RE_GROUP_PLAYER_OFFLINE,
-        .re_exp = "^: " RE_NAME " has been offline for too long and is automatically excluded from the group\\.",
-    },
-    {
-        .re_id  = RE_GROUP_PLAYER_OFFLINE,
-        .re_exp = "^: " RE_NAME " est déconnecté depuis trop longtemps et a été automatiquement exclu du groupe\\.",
-    },
+/** First bytes of a gzip file */
+#define CHATLOG_GZ_MAGIC        "\x1f\x8b"
+/** Size of the zlib input buffer, larger reads mean fewer system calls */
+#define CHATLOG_GZ_BUF_SZ       (256 * 1024)
 
-    /* The group has been disbanded */
-    {
-        .re_id  = RE_GROUP_DISBAND,
-        .re_exp = "^: The group has been disbanded\\.",
-    },
-    {
-        .re_id  = RE_GROUP_DISBAND,
-        .re_exp = "^: Le groupe a été dissous.\\.",
-    },
-    {
-        .re_id  = RE_GROUP_DISBAND,
-        .re_exp = "^: Die Gruppe wurde aufgelöst\\.",
-    },
+static struct chatlog_reader chatlog_live;      /**< Reader of the live chatlog                 */
+static struct chatlog_reader chatlog_replay_main;       /**< Replay reader of the main thread   */
+/** Reader used by chatlog_readfile() in this thread, see chatlog_session_init() */
+static SYS_TLS struct chatlog_reader *chatlog_replay = &chatlog_replay_main;
 
-    /* The player joined an alliance */
-    {
-        .re_id  = RE_ALI_SELF_JOIN,
-        .re_exp = "^: You have joined the alliance\\.",
-    },
-    {
-        .re_id  = RE_ALI_SELF_JOIN,
-        .re_exp = "^: Vous avez rejoint la cohorte\\.",
-    },
-    {
-        .re_id  = RE_ALI_SELF_JOIN,
-        .re_exp = "^: Ihr seid der Allianz beigetreten\\.",
-    },
+/** Name of the chatlog checkpoint file, it's stored next to the configuration file */
+#define CHATLOG_CKPT_FILE       "chatlog.pos"
+/** Checkpoint file format version */
+#define CHATLOG_CKPT_VERSION    1
+/** Time between the first unsaved line and the checkpoint save, in miliseconds */
+#define CHATLOG_CKPT_DELAY      5000
 
-    /* The player left the alliance */
-    {
-        .re_id  = RE_ALI_SELF_LEAVE,
-        .re_exp = "^: You have left the alliance\\.",
-    },
-    {
-        .re_id  = RE_ALI_SELF_LEAVE,
-        .re_exp = "^: Vous avez quitté la cohorte\\.",
-    },
-    {
-        .re_id  = RE_ALI_SELF_LEAVE,
-        .re_exp = "^: Ihr habt die Allianz verlassen\\.",
-    },
+/**
+ * The chatlog checkpoint, the position of the live reader is saved periodically
+ * by chatlog_periodic(), so APme can continue where it stopped after a restart
+ */
+struct chatlog_ckpt
+{
+    struct sys_fstat    ck_stat;                /**< Chatlog identity, size and modification time   */
+    uint64_t            ck_pos;                 /**< Read offset                                    */
+    uint64_t            ck_hash;                /**< Hash of the line that ends at ck_pos           */
+    size_t              ck_hash_len;            /**< Length of that line, 0 if unknown              */
+};
 
-    /* The player has been kicked from the alliance */
-    {
-        .re_id  = RE_ALI_SELF_KICK,
-        .re_exp = "^: You have been kicked out of the alliance\\.",
-    },
-    {
-        .re_id  = RE_ALI_SELF_KICK,
-        .re_exp = "^: Vous avez été expulsée de la cohorte\\.",
-    },
-    {
-        .re_id  = RE_ALI_SELF_KICK,
-        .re_exp = "^: Ihr wurdet aus der Allianz geworfen\\.",
-    },
+static uint64_t chatlog_ckpt_pos = 0;           /**< Last saved position                        */
+static uint64_t chatlog_ckpt_timestamp = 0;     /**< Time of the first unsaved line, 0 if saved */
+
+static char chatlog_live_path[UTIL_MAX_PATH];   /**< Path of the live chatlog                   */
+static struct chatlog_idx chatlog_live_idx;     /**< Time index of the live chatlog             */
+static bool chatlog_live_idx_valid = false;     /**< chatlog_live_idx was opened                */
+static uint64_t chatlog_live_idx_len = 0;       /**< Indexed length when it was last saved      */
+
+/** Size of the line data in the reader ring, must be a power of 2 and larger than CHATLOG_READ_SZ */
+#define CHATLOG_RING_SZ         (1024 * 1024)
+/** Number of lines in the reader ring, must be a power of 2 */
+#define CHATLOG_RING_LINES      8192
+/** Lines parsed before their space is returned to the reader */
+#define CHATLOG_RING_BATCH      256
+/** Rate at which the reader thread polls the chatlog on its own */
+#define CHATLOG_READER_HZ       20
+/** Maximum length of a message of the reader thread, see chatlog_read_msg() */
+#define CHATLOG_MSG_SZ          256
 
-    /* Another player joined the alliance */
-    {
-        .re_id  = RE_ALI_PLAYER_JOIN,
-        .re_exp = "^: " RE_NAME " has joined the alliance\\.",
-    },
-    {
-        .re_id  = RE_ALI_PLAYER_JOIN,
-        .re_exp = "^: " RE_NAME " a rejoint la cohorte\\.",
-    },
-    {
-        .re_id  = RE_ALI_PLAYER_JOIN,
-        .re_exp = "^: " RE_NAME " ist der Allianz beigetreten\\.",
-    },
+/**
+ * A line in the reader ring
+ */
+struct chatlog_line
+{
+    uint64_t    cl_off;                         /**< Offset of the line in cq_buf, modulo CHATLOG_RING_SZ   */
+    size_t      cl_len;                         /**< Line length, 0 for empty or skipped lines              */
+    uint64_t    cl_pos;                         /**< Chatlog offset after the line                          */
+    bool        cl_msg;                         /**< Not a line but a message of the reader, it's printed   */
+};
 
-    /* Another player has left the alliance */
-    {
-        .re_id  = RE_ALI_PLAYER_LEAVE,
-        .re_exp = "^: " RE_NAME " has left the alliance\\.",
-    },
-    {
-        .re_id  = RE_ALI_PLAYER_LEAVE,
-        .re_exp = "^: " RE_NAME " a quitté la cohorte\\.",
-    },
-    {
-        .re_id  = RE_ALI_PLAYER_LEAVE,
-        .re_exp = "^: " RE_NAME " hat die Allianz verlassen\\.",
-    },
+/**
+ * Single-producer/single-consumer ring of chatlog lines
+ *
+ * The reader thread copies every line it reads into the ring and the thread
+ * that calls chatlog_poll() parses them, so a stalled parser (clipboard,
+ * screen updates) doesn't stop the chatlog from being read. The two threads
+ * share only the counters cq_head, cq_tail and cq_rd, the lines are passed
+ * without locking. The reader doesn't print anything, its messages go through
+ * the ring too.
+ *
+ * When the ring is full the reader waits on chatlog_reader_cond until the
+ * parser returns some space, the lines are never dropped; the chatlog itself
+ * is the buffer behind the ring.
+ */
+struct chatlog_ring
+{
+    /* Written by the reader */
+    uint64_t            cq_head;                /**< Lines pushed                               */
+    uint64_t            cq_wr;                  /**< End of the line data pushed                */
+    uint64_t            cq_full;                /**< Pushes that found the ring full            */
+    uint64_t            cq_full_ns;             /**< Time spent waiting for the parser          */
+    uint64_t            cq_overflow;            /**< Lines longer than CHATLOG_READ_SZ, skipped */
+    bool                cq_notify;              /**< The parser was notified of new lines       */
+    /* Written by the parser */
+    uint64_t            cq_tail;                /**< Lines parsed                               */
+    uint64_t            cq_rd;                  /**< End of the line data parsed                */
+    uint64_t            cq_batches;             /**< Batches parsed                             */
+    uint64_t            cq_max;                 /**< Most lines in the ring at once             */
+    uint64_t            cq_pos;                 /**< Chatlog offset after the last parsed line  */
+    uint64_t            cq_hash;                /**< Hash of the last parsed line               */
+    size_t              cq_hash_len;            /**< Length of that line, 0 if unknown          */
+    struct chatlog_line cq_line[CHATLOG_RING_LINES];    /**< Lines                              */
+    char                cq_buf[CHATLOG_RING_SZ];        /**< Line data                          */
+};
 
-    /* A player has been kicked from the alliance */
-    {
-        .re_id  = RE_ALI_PLAYER_KICK,
-        .re_exp = "^: " RE_NAME " has been kicked out of the alliance\\.",
-    },
-    {
-        .re_id  = RE_ALI_PLAYER_KICK,
-        .re_exp = "^: " RE_NAME " a été expulsé de la cohorte\\.",
-    },
-    {
-        .re_id  = RE_ALI_PLAYER_KICK,
-        .re_exp = "^: " RE_NAME " wurde aus der Allianz geworfen\\.",
-    },
+static struct chatlog_ring chatlog_ring;        /**< Lines read from the live chatlog           */
+static pthread_t chatlog_reader_thread;         /**< Reads the live chatlog into chatlog_ring   */
+static bool chatlog_reader_started = false;     /**< chatlog_reader_thread is running           */
+static bool chatlog_reader_error = false;       /**< The reader failed, set by the reader       */
+static bool chatlog_reader_wake = false;        /**< Read the chatlog now                       */
+static pthread_mutex_t chatlog_reader_lock = PTHREAD_MUTEX_INITIALIZER; /**< Protects chatlog_reader_wake  */
+/** Signals chatlog_reader_wake and the space returned to the reader by chatlog_ring_parse() */
+static pthread_cond_t chatlog_reader_cond = PTHREAD_COND_INITIALIZER;
+#ifdef SYS_UNIX
+static int chatlog_notify_fd[2] = { -1, -1 };  /**< Pipe that becomes readable when there are new lines   */
+#endif
 
-    /* A player has been offline for too long and has been kicked out of the alliance */
-    {
-        .re_id  = RE_ALI_PLAYER_OFFLINE,
-        .re_exp = "^: " RE_NAME " has been offline for too long and had been automatically kicked out of the alliance\\."
-    },
-    {
-        .re_id  = RE_ALI_PLAYER_OFFLINE,
-        .re_exp = "^: " RE_NAME " a passé trop de temps hors connexion. Expulsion automatique de la Cohorte\\."
-    },
+/** Maximum number of replay threads */
+#define CHATLOG_JOBS_MAX        64
+/** Size of the chunks the replayed chatlog is split into, smaller files are parsed by a single thread */
+#define CHATLOG_CHUNK_SZ        (4 * 1024 * 1024)
+/** Number of chunks per thread that can be parsed ahead of the chunk being processed */
+#define CHATLOG_CHUNK_AHEAD     4
 
-    /* The alliance has been disbanded */
-    {
-        .re_id  = RE_ALI_DISBAND,
-        .re_exp = "^: The alliance has been disbanded\\.",
-    },
-    {
-        .re_id  = RE_ALI_DISBAND,
-        .re_exp = "^: La cohorte a été dissoute\\.",
-    },
-    {
-        .re_id  = RE_ALI_DISBAND,
-        .re_exp = "^: Die Allianz wurde aufgelöst\\.",
-    },
+/**
+ * A line matched by a replay thread
+ */
+struct chatlog_event
+{
+    char        *ce_str;                        /**< Line without the timestamp, in the mapping */
+    size_t      ce_len;                         /**< Length of ce_str                           */
+    ssize_t     ce_idx;                         /**< Index of the matched expression, -1 if
+                                                     the line didn't match                      */
+    uint32_t    ce_lang;                        /**< Languages of the literals found in a line
+                                                     that didn't match, see rs_lit_lang         */
+    size_t      ce_cap;                         /**< Index of the groups in cc_cap              */
+};
 
-    /* General chat -- this seems to be the same in French, German and English */
-    {
-        .re_id  = RE_CHAT_GENERAL,
-        .re_exp = "^: \\[charname:" RE_NAME ";.*\\]: (.*)$",
-    },
+/**
+ * A chunk of the replayed chatlog
+ *
+ * The chunk is parsed by one of the replay threads, which only records the
+ * matches. The events are then processed by the main thread in file order.
+ */
+struct chatlog_chunk
+{
+    char                    *cc_start;          /**< First line of the chunk                    */
+    char                    *cc_end;            /**< End of the chunk, after a new-line         */
+    bool                    cc_done;            /**< Set when the chunk was parsed              */
+    bool                    cc_error;           /**< Out of memory, the chunk must be parsed
+                                                     again by the main thread                   */
+    struct chatlog_event    *cc_event;          /**< Recorded lines                             */
+    size_t                  cc_event_num;       /**< Number of elements in cc_event             */
+    size_t                  cc_event_max;       /**< Allocated elements in cc_event             */
+    struct re_capture       *cc_cap;            /**< Groups of the matched lines                */
+    size_t                  cc_cap_num;         /**< Number of elements in cc_cap               */
+    size_t                  cc_cap_max;         /**< Allocated elements in cc_cap               */
+};
 
-    /* Whisper */
-    {
-        .re_id  = RE_CHAT_WHISPER,
-        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] Whispers: (.*)$",
-    },
-    {
-        .re_id  = RE_CHAT_WHISPER,
-        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] murmure : (.*)$",
-    },
-    {
-        .re_id  = RE_CHAT_WHISPER,
-        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] flüstert: (.*)$",
-    },
+/**
+ * State shared by the replay threads, see chatlog_readmap_jobs()
+ */
+struct chatlog_jobs
+{
+    pthread_mutex_t         cj_lock;            /**< Protects the fields below and cc_done      */
+    pthread_cond_t          cj_cond;            /**< Signalled when a chunk is parsed or done   */
+    struct chatlog_chunk    *cj_chunk;          /**< Chunks of the chatlog                      */
+    size_t                  cj_num;             /**< Number of chunks                           */
+    size_t                  cj_next;            /**< Next chunk to parse                        */
+    size_t                  cj_done;            /**< Number of processed chunks                 */
+    size_t                  cj_ahead;           /**< Maximum cj_next - cj_done                  */
+};
 
-    /* Shouts */
-    {
-        .re_id  = RE_CHAT_SHOUT,
-        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] Shouts: (.*)$",
-    },
-    {
-        .re_id  = RE_CHAT_SHOUT,
-        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] crie : (.*)$",
-    },
-    {
-        .re_id  = RE_CHAT_SHOUT,
-        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] ruft: (.*)$",
-    },
+/**
+ * A replay thread
+ */
+struct chatlog_worker
+{
+    pthread_t               cw_thread;          /**< Thread handle                              */
+    struct regeng_set       cw_rs;              /**< Private copy of re_aion_set                */
+    struct chatlog_jobs     *cw_jobs;           /**< Shared state                               */
+};
 
-    /* The player rolled for an item */
-    {
-        .re_id  = RE_ROLL_ITEM_SELF,
-        .re_exp = "^: You rolled the dice and got " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
-    },
-    {
-        .re_id  = RE_ROLL_ITEM_SELF,
-        .re_exp = "^: Vous avez lancé les dés et obtenu " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
-    },
-    {
-        .re_id  = RE_ROLL_ITEM_SELF,
-        .re_exp = "^: Ihr habt eine " RE_NUM_ROLL " gewürfelt \\(max\\. " RE_NUM_ROLL "\\)\\.",
-    },
+static unsigned chatlog_jobs_num = 1;           /**< Number of replay threads                   */
 
-    /* Another player rolled for an item */
-    {
-        .re_id  = RE_ROLL_ITEM_PLAYER,
-        .re_exp = "^: " RE_NAME " rolled the dice and got " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
-    },
-    {
-        .re_id  = RE_ROLL_ITEM_PLAYER,
-        .re_exp = "^: " RE_NAME " a lancé les dés et a obtenu " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
-    },
-    {
-        .re_id  = RE_ROLL_ITEM_PLAYER,
-        .re_exp = "^: " RE_NAME " hat eine " RE_NUM_ROLL " gewürfelt \\(max\\. " RE_NUM_ROLL "\\)\\.",
-    },
+/** Number of matches of a language that are needed to select it */
+#define CHATLOG_LANG_DETECT     3
+/** Number of misses since the last match after which the language is detected again */
+#define CHATLOG_LANG_MISS_MAX   16
 
-    /* The or another player passed on an item */
-    {
-        .re_id  = RE_ROLL_ITEM_PASS,
-        .re_exp = "^: " RE_NAME " gave up rolling the dice",
-    },
-    {
-        .re_id  = RE_ROLL_ITEM_PASS,
-        .re_exp = "^: " RE_NAME " a renoncé à lancer les dés",
-    },
-    {
-        .re_id  = RE_ROLL_ITEM_PASS,
-        .re_exp = "^: " RE_NAME " hat aufgehört zu würfeln\\.",
-    },
+static SYS_TLS uint32_t chatlog_lang = 0;               /**< Selected language, 0 while detecting   */
+static bool chatlog_lang_fixed = false;                 /**< Language was set in the config         */
+static uint32_t chatlog_lang_start = 0;                 /**< Language that new sessions start with  */
+static SYS_TLS uint32_t chatlog_lang_hits[RE_LANG_NUM]; /**< Matches per language while detecting   */
+static SYS_TLS uint64_t chatlog_lang_misses = 0;        /**< rs_lang_misses at the last match       */
 
+static bool chatlog_open(void); 
+static char *chatlog_msg(char *chatstr, size_t *chatstr_len);
+static bool chatlog_readstr(char *chatstr, size_t chatstr_len);
+static size_t chatlog_fread(struct chatlog_reader *cr, FILE *file, size_t len);
+static bool chatlog_ferror(struct chatlog_reader *cr, FILE *file, struct chatlog_ring *cq);
+static bool chatlog_read(struct chatlog_reader *cr, FILE *file, bool flush, struct chatlog_ring *cq);
+static bool chatlog_is_gzip(char *file);
+static bool chatlog_readgz(char *file);
+static void chatlog_read_msg(struct chatlog_ring *cq, char *fmt, ...);
+static void chatlog_ring_push(struct chatlog_ring *cq, char *str, size_t len, uint64_t pos, bool msg);
+static void chatlog_ring_parse(struct chatlog_ring *cq);
+static bool chatlog_reader_poll(void);
+static void *chatlog_reader_main(void *arg);
+static bool chatlog_reader_start(void);
+static void chatlog_readmap(char *map, size_t map_len, uint64_t tm_start, uint64_t tm_end);
+static bool chatlog_chunk_record(struct chatlog_chunk *cc, char *str, size_t str_len, struct regeng_set *rs);
+static void chatlog_chunk_parse(struct chatlog_chunk *cc, struct regeng_set *rs);
+static void chatlog_chunk_process(struct chatlog_chunk *cc);
+static void *chatlog_worker_main(void *arg);
+static void chatlog_readmap_jobs(char *map, size_t map_len);
+static bool chatlog_readfile_time(char *file, uint64_t tm_start, uint64_t tm_end, uint64_t tm_span);
+static void chatlog_reader_reset(struct chatlog_reader *cr, uint64_t pos);
+static uint64_t chatlog_hash(const char *str, size_t len);
+static bool chatlog_ckpt_path(char *path, size_t path_sz);
+static bool chatlog_ckpt_load(struct chatlog_ckpt *ck);
+static void chatlog_ckpt_save(void);
+static void chatlog_ckpt_flush(void);
+static void chatlog_live_idx_open(void);
+static uint64_t chatlog_ckpt_resume(FILE *file);
+static re_callback_t chatlog_parse; /**< Declaration of chatlog_parse()     */
 
-    /* Somebody rolled the highest */
-    {
-        .re_id  = RE_ROLL_ITEM_HIGHEST,
-        .re_exp = "^: " RE_NAME " rolled the highest",
-    },
-    {
-        .re_id  = RE_ROLL_ITEM_HIGHEST,
-        .re_exp = "^: " RE_NAME " a obtenu le meilleur score",
-    },
-    {
-        .re_id  = RE_ROLL_ITEM_HIGHEST,
-        .re_exp = "^: " RE_NAME " hat den höchsten Wert gewürfelt",
-    },
+/**
+ * The regeng set wrapping @ref re_aion, with the scanner generated by regeng_gen.
+ * It's matched in native mode, directly on the CP-1252 chatlog lines.
+ */
+static struct regeng_set re_aion_set = RE_REGENG_SET_NATIVE(re_aion, re_aion_scan);
 
-    /* The two events below do not have a French equivalent, unfortunately */
-    {
-        /* The onlly difference between this and RE_ROLL_ITEM_SELF is in the "got a" vs "got" text */
-        .re_id  = RE_ROLL_DICE_SELF,
-        .re_exp = "^: You rolled the dice and got a " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
+/**
+ * State of a parsing session in a thread other than the main one
+ *
+ * It's allocated by chatlog_session_init(), only the pointers to it are thread
+ * local, so the threads don't carry the read buffer in their TLS block.
+ */
+struct chatlog_session
+{
+    struct regeng_set       cs_rs;              /**< Copy of @ref re_aion_set                   */
+    struct chatlog_reader   cs_replay;          /**< Reader used by chatlog_readfile()          */
+};
 
-    },
-    {
-        /* The onlly difference between this and RE_ROLL_ITEM_PLAYER is in the "got a" vs "got" text */
-        .re_id  = RE_ROLL_DICE_PLAYER,
-        .re_exp = "^: " RE_NAME " rolled the dice and got a " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
-    },
+/** Session of this thread, NULL in the main thread */
+static SYS_TLS struct chatlog_session *chatlog_session = NULL;
+/** The set used to parse lines in this thread, this is re_aion_set in the main thread */
+static SYS_TLS struct regeng_set *chatlog_rs = &re_aion_set;
 
-    RE_REGENG_END
-};
+static void chatlog_utf8(struct re_capture *cap, char *buf, size_t buf_sz);
+static bool chatlog_lang_parse(char *lang, uint32_t *mask);
+static void chatlog_lang_select(uint32_t lang);
+static void chatlog_lang_update(void);
 
 /**
  * @name Chatlog Event Processing Functions
@@ -526,12 +365,13 @@ struct regeng re_aion[] =
  *  - RE_ITEM_LOOT_PLAYER
  *
  * @param[in]       player      Character name
+ * @param[in]       player_len  Length of @p player
  * @param[in]       itemid      Item id number
  *
  */
-void parse_action_loot_item(char *player, uint32_t itemid)
+void parse_action_loot_item(const char *player, size_t player_len, uint32_t itemid)
 {
-    aion_group_loot(player, itemid);
+    aion_group_loot(player, player_len, itemid);
 }
 
 /** 
@@ -545,17 +385,17 @@ void parse_action_loot_item(char *player, uint32_t itemid)
  * @param[in]       player      Character name
  * @param[in]       target      Afflicted target name
  * @param[in]       damage      Damage number (may contain ,.)
- * @param[in]       skill       Skill that was used to inflict damage, or NULL if none
+ * @param[in]       skill       Skill that was used to inflict damage, not valid if none
  *
  */
-void parse_action_damage_inflict(char *player, char *target, char *damage, char *skill)
+void parse_action_damage_inflict(struct re_capture player, struct re_capture target, struct re_capture damage, struct re_capture skill)
 {
     (void)player;
     (void)target;
     (void)damage;
     (void)skill;
 
-    //con_printf("DMG: %s -> %s: %s (%s)\n", player, target, damage, skill);
+    //con_printf("DMG: %.*s -> %.*s\n", (int)player.rc_len, player.rc_str, (int)target.rc_len, target.rc_str);
 }
 
 /**
@@ -597,11 +437,12 @@ void parse_action_group_self_leave(void)
  *      - RE_GROUP_PLAYER_JOIN:
  * 
  * @param[in]       who     Character name that joined
+ * @param[in]       who_len Length of @p who
  */ 
-void parse_action_group_player_join(char *who)
+void parse_action_group_player_join(const char *who, size_t who_len)
 {
-    con_printf("GROUP: %s joined the group.\n", who);
-    aion_group_join(who);
+    con_printf("GROUP: %.*s joined the group.\n", (int)who_len, who);
+    aion_group_join(who, who_len);
 }
 
 /**
@@ -618,11 +459,12 @@ void parse_action_group_player_join(char *who)
  *      - RE_GROUP_PLAYER_OFFLINE
  *
  * @param[in]       who     Character name that left the group
+ * @param[in]       who_len Length of @p who
  */
-void parse_action_group_player_leave(char *who)
+void parse_action_group_player_leave(const char *who, size_t who_len)
 {
-    con_printf("GROUP: %s left the group.\n", who);
-    aion_group_leave(who);
+    con_printf("GROUP: %.*s left the group.\n", (int)who_len, who);
+    aion_group_leave(who, who_len);
 }
 
 /**
@@ -636,13 +478,15 @@ void parse_action_group_player_leave(char *who)
  *      - RE_CHAT_GENERAL
  *
  * @param[in]       name        The player that said something on chat
+ * @param[in]       name_len    Length of @p name
  * @param[in]       txt         The chat line
+ * @param[in]       txt_len     Length of @p txt
  *
  */
-void parse_action_chat_general(char *name, char *txt)
+void parse_action_chat_general(const char *name, size_t name_len, const char *txt, size_t txt_len)
 {
-    aion_player_chat_cache(name, txt);
-//    con_printf("CHAT: %s -> %s\n", name, txt);
+    aion_player_chat_cache(name, name_len, txt, txt_len);
+//    con_printf("CHAT: %.*s -> %.*s\n", (int)name_len, name, (int)txt_len, txt);
 }
 
 /**
@@ -653,12 +497,14 @@ void parse_action_chat_general(char *name, char *txt)
  *      - RE_CHAT_WHISPER
  *
  * @param[in]       name        The whispering player
+ * @param[in]       name_len    Length of @p name
  * @param[in]       txt         The whisper chat line
+ * @param[in]       txt_len     Length of @p txt
  *
  */
-void parse_action_chat_whisper(char *name, char *txt)
+void parse_action_chat_whisper(const char *name, size_t name_len, const char *txt, size_t txt_len)
 {
-    aion_player_chat_cache(name, txt);
+    aion_player_chat_cache(name, name_len, txt, txt_len);
 }
 
 /**
@@ -671,12 +517,14 @@ void parse_action_chat_whisper(char *name, char *txt)
  *      - RE_CHAT_SHOUT
  *
  * @param[in]       name        The player that shouted
+ * @param[in]       name_len    Length of @p name
  * @param[in]       txt         The shout chat line
+ * @param[in]       txt_len     Length of @p txt
  *
  */
-void parse_action_chat_shout(char *name, char *txt)
+void parse_action_chat_shout(const char *name, size_t name_len, const char *txt, size_t txt_len)
 {
-    aion_player_chat_cache(name, txt);
+    aion_player_chat_cache(name, name_len, txt, txt_len);
 }
 
 /**
@@ -708,10 +556,11 @@ void parse_action_roll_item_self(void)
  *      - RE_ROLL_ITEM_PLAYER
  *
  * @param[in]       who         Player that rolled on an item
+ * @param[in]       who_len     Length of @p who
  */
-void parse_action_roll_item_player(char *who)
+void parse_action_roll_item_player(const char *who, size_t who_len)
 {
-    aion_group_join(who);
+    aion_group_join(who, who_len);
 }
 
 /**
@@ -725,11 +574,12 @@ void parse_action_roll_item_player(char *who)
  *      - RE_ROLL_ITEM_PASS
  *
  * @param[in]       who         Player that passed on an item
+ * @param[in]       who_len     Length of @p who
  */
-void parse_action_roll_item_pass(char *who)
+void parse_action_roll_item_pass(const char *who, size_t who_len)
 {
     /* See parse_action_roll_item_player() */
-    aion_group_join(who);
+    aion_group_join(who, who_len);
 }
 
 /**
@@ -745,16 +595,17 @@ void parse_action_roll_item_pass(char *who)
  *      - RE_ROLL_ITEM_HIGHEST
  *
  * @param[in]       who         Player who won the item
+ * @param[in]       who_len     Length of @p who
  *
  */
-void parse_action_roll_item_highest(char *who)
+void parse_action_roll_item_highest(const char *who, size_t who_len)
 {
     char aprolls[CHATLOG_CHAT_SZ];
     /*
      * Mark this user as having full inventory.
      * This flag will be cleared as soon as an item is looted.
      */
-    aion_invfull_set(who, true);
+    aion_invfull_set(who, who_len, true);
 
     /* Update the clipboard with the new status */
     aion_aploot_rights(aprolls, sizeof(aprolls));
@@ -766,56 +617,68 @@ void parse_action_roll_item_highest(char *who)
  * @}
  */
 
+/**
+ * Convert the captured group @p cap from CP-1252 to UTF-8
+ *
+ * Lines are matched in their original encoding, captured text is converted
+ * only when it's going to be stored. Pure ASCII groups are left as they are,
+ * otherwise @p cap is pointed to the converted string in @p buf.
+ *
+ * @param[in,out]   cap         Captured group
+ * @param[out]      buf         Buffer for the converted string
+ * @param[in]       buf_sz      Size of @p buf
+ */
+void chatlog_utf8(struct re_capture *cap, char *buf, size_t buf_sz)
+{
+    if (util_ascii_len(cap->rc_str, cap->rc_len) == cap->rc_len) return;
+
+    cap->rc_len = util_cp1252_to_utf8n(buf, buf_sz, cap->rc_str, cap->rc_len);
+    cap->rc_str = buf;
+}
+
 /**
  * This is the gigantic switch case that maps the matched ID
  * to an event function. What parameters are passed to the
  * handler is determined in here.
  *
+ * The captured groups are passed on as views into @p matchstr,
+ * only chat text with non-ASCII characters is converted to UTF-8.
+ *
  * @param[in]       re_id           Matched regex ID
  * @param[in]       matchstr        Matched string
- * @param[in]       rematch         regmatch_t regex, used to extract arguments
- * @param[in]       rematch_num     Number of regmatch_t structures in <I>rematch</I>
+ * @param[in]       cap             Matched groups, used to extract arguments
+ * @param[in]       cap_num         Number of re_capture structures in <I>cap</I>
  */
-void chatlog_parse(uint32_t re_id, const char* matchstr, regmatch_t *rematch, size_t rematch_num)
+void chatlog_parse(uint32_t re_id, const char* matchstr, struct re_capture *cap, size_t cap_num)
 {
-    char item[CHATLOG_ITEM_SZ];
-    char name[CHATLOG_NAME_SZ];
-    char damage[CHATLOG_NAME_SZ];
-    char target[CHATLOG_NAME_SZ];
-    char skill[CHATLOG_NAME_SZ];
     char chat[CHATLOG_CHAT_SZ];
 
-    (void)rematch_num;
+    (void)matchstr;
+    (void)cap_num;
 
     switch (re_id)
     {
         case RE_ITEM_LOOT_SELF:
-            re_strlcpy(item, matchstr, sizeof(item), rematch[1]);
-            parse_action_loot_item(AION_NAME_DEFAULT, strtoul(item, NULL, 10));
+            /* The item group is all digits, strtoul() stops at its end */
+            parse_action_loot_item(AION_NAME_DEFAULT, strlen(AION_NAME_DEFAULT), strtoul(cap[1].rc_str, NULL, 10));
             break;
 
         case RE_ITEM_LOOT_PLAYER:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            re_strlcpy(item, matchstr, sizeof(item), rematch[2]);
-
-            parse_action_loot_item(name, strtoul(item, NULL, 10));
+            parse_action_loot_item(cap[1].rc_str, cap[1].rc_len, strtoul(cap[2].rc_str, NULL, 10));
             break;
 
         case RE_DAMAGE_INFLICT:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            re_strlcpy(damage, matchstr, sizeof(damage), rematch[2]);
-            re_strlcpy(target, matchstr, sizeof(target), rematch[3]);
-            re_strlcpy(skill, matchstr, sizeof(skill), rematch[4]);
-
-            parse_action_damage_inflict(name, target, damage, skill);
+            parse_action_damage_inflict(cap[1], cap[3], cap[2], cap[4]);
             break;
 
         case RE_DAMAGE_CRITICAL:
-            re_strlcpy(damage, matchstr, sizeof(damage), rematch[1]);
-            re_strlcpy(target, matchstr, sizeof(target), rematch[2]);
+        {
+            struct re_capture self = { AION_NAME_DEFAULT, strlen(AION_NAME_DEFAULT) };
+            struct re_capture crit = { "Critical", strlen("Critical") };
 
-            parse_action_damage_inflict(AION_NAME_DEFAULT, target, damage, "Critical");
+            parse_action_damage_inflict(self, cap[2], cap[1], crit);
             break;
+        }
 
         case RE_GROUP_SELF_JOIN:
         case RE_ALI_SELF_JOIN:
@@ -833,8 +696,7 @@ void chatlog_parse(uint32_t re_id, const char* matchstr, regmatch_t *rematch, si
 
         case RE_GROUP_PLAYER_JOIN:
         case RE_ALI_PLAYER_JOIN:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            parse_action_group_player_join(name);
+            parse_action_group_player_join(cap[1].rc_str, cap[1].rc_len);
             break;
 
         case RE_GROUP_PLAYER_DISCONNECT:
@@ -845,36 +707,27 @@ void chatlog_parse(uint32_t re_id, const char* matchstr, regmatch_t *rematch, si
         case RE_ALI_PLAYER_LEAVE:
         case RE_ALI_PLAYER_KICK:
         case RE_ALI_PLAYER_OFFLINE:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            parse_action_group_player_leave(name);
+            parse_action_group_player_leave(cap[1].rc_str, cap[1].rc_len);
             break;
 
         case RE_CHAT_GENERAL:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            re_strlcpy(chat, matchstr, sizeof(chat), rematch[2]);
-
-            parse_action_chat_general(name, chat);
+            chatlog_utf8(&cap[2], chat, sizeof(chat));
+            parse_action_chat_general(cap[1].rc_str, cap[1].rc_len, cap[2].rc_str, cap[2].rc_len);
             break;
 
         case RE_CHAT_WHISPER:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            re_strlcpy(chat, matchstr, sizeof(chat), rematch[2]);
-
-            parse_action_chat_whisper(name, chat);
+            chatlog_utf8(&cap[2], chat, sizeof(chat));
+            parse_action_chat_whisper(cap[1].rc_str, cap[1].rc_len, cap[2].rc_str, cap[2].rc_len);
             break;
 
         case RE_CHAT_SHOUT:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            re_strlcpy(chat, matchstr, sizeof(chat), rematch[2]);
-
-            parse_action_chat_shout(name, chat);
+            chatlog_utf8(&cap[2], chat, sizeof(chat));
+            parse_action_chat_shout(cap[1].rc_str, cap[1].rc_len, cap[2].rc_str, cap[2].rc_len);
             break;
 
         case RE_CHAT_SELF:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            re_strlcpy(chat, matchstr, sizeof(chat), rematch[2]);
             /* XXX: Chat self is not reliable, since it records stuff like NPC messages and Tips */
-            //parse_action_chat_general(AION_NAME_DEFAULT, chat);
+            //parse_action_chat_general(AION_NAME_DEFAULT, strlen(AION_NAME_DEFAULT), cap[2].rc_str, cap[2].rc_len);
             break;
 
         case RE_ROLL_ITEM_SELF:
@@ -882,18 +735,15 @@ void chatlog_parse(uint32_t re_id, const char* matchstr, regmatch_t *rematch, si
             break;
 
         case RE_ROLL_ITEM_PLAYER:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            parse_action_roll_item_player(name);
+            parse_action_roll_item_player(cap[1].rc_str, cap[1].rc_len);
             break;
 
         case RE_ROLL_ITEM_PASS:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            parse_action_roll_item_pass(name);
+            parse_action_roll_item_pass(cap[1].rc_str, cap[1].rc_len);
             break;
 
         case RE_ROLL_ITEM_HIGHEST:
-            re_strlcpy(name, matchstr, sizeof(name), rematch[1]);
-            parse_action_roll_item_highest(name);
+            parse_action_roll_item_highest(cap[1].rc_str, cap[1].rc_len);
             break;
 
         case RE_ROLL_DICE_SELF:
@@ -908,183 +758,1893 @@ void chatlog_parse(uint32_t re_id, const char* matchstr, regmatch_t *rematch, si
 }
 
 /**
- * Open the chatlog file
- * 
- * Uses aion_default_install_path() to find the path to the chatlog file.
+ * Convert a language name to a RE_LANG_ mask
  *
- * @retval      true        If successfull
- * @retval      false       On error
- */ 
-bool chatlog_open(void)
+ * Only the first two letters are checked, so "en", "ENG" and "english" are
+ * all accepted. "auto" returns 0.
+ *
+ * @param[in]       lang        Language name
+ * @param[out]      mask        Language mask
+ *
+ * @retval          true        On success
+ * @retval          false       If the language is not known
+ */
+bool chatlog_lang_parse(char *lang, uint32_t *mask)
 {
-    char *chatlog_dir;
-    char chatlog_path[1024];
-
-    if (chatlog_file != NULL)
+    if (strcasecmp(lang, "auto") == 0)
     {
-        /* Chat log file alrady open, return */
+        *mask = 0;
         return true;
     }
 
-#ifdef SYS_WINDOWS
-    /* Try to open the cthatlog file */
-    chatlog_dir = aion_default_install_path();
-    if (chatlog_dir == NULL)
+    if (strncasecmp(lang, "en", 2) == 0)
     {
-        con_printf("FATAL: Unable to find Aion install path.\n");
-        return false;
+        *mask = RE_LANG_EN;
+        return true;
     }
 
-    /* Construct the path */
-    util_strlcpy(chatlog_path, chatlog_dir, sizeof(chatlog_path));
-    util_strlcat(chatlog_path, "\\", sizeof(chatlog_path));
-    util_strlcat(chatlog_path, CHATLOG_FILENAME, sizeof(chatlog_path));
-#else
-    (void)chatlog_dir;
-    util_strlcpy(chatlog_path, "./Chat.log", sizeof(chatlog_path));
-#endif
-
-    chatlog_file = sys_fopen_force(chatlog_path, "r");
-    if (chatlog_file == NULL)
+    if (strncasecmp(lang, "fr", 2) == 0)
     {
-        /* This can be just a temporary error, so return success */
-        con_printf("Error opening chat log: %s\n", chatlog_path);
+        *mask = RE_LANG_FR;
         return true;
     }
 
-#ifdef SYS_WINDOWS
-    // Seek to the end of file
-    if (fseek(chatlog_file, 0, SEEK_END) != 0)
+    if ((strncasecmp(lang, "de", 2) == 0) || (strncasecmp(lang, "ge", 2) == 0))
     {
-        /* If we didn't succeed in the seek, we might be in trouble, so return a hard error */
-        return false;
+        *mask = RE_LANG_DE;
+        return true;
     }
-#endif
 
-    return true;
+    return false;
 }
 
 /**
- * Initialize the chat log facility
- *
- * This must be called before any other chatlog function
+ * Select the language of the chatlog, 0 starts the detection
  *
- * @retval      true        On success
- * @retval      false       On error
+ * @param[in]       lang        RE_LANG_ mask
  */
-bool chatlog_init()
+void chatlog_lang_select(uint32_t lang)
 {
-    if (!re_init(re_aion))
-    {
-        con_printf("Unable to initialize the regex subsystem.\n");
-        return false;
-    }
+    chatlog_lang = lang;
+    chatlog_lang_misses = chatlog_rs->rs_lang_misses;
+    memset(chatlog_lang_hits, 0, sizeof(chatlog_lang_hits));
 
-    return true;
+    re_lang_set(chatlog_rs, lang);
 }
 
 /**
- * Processes a line from the chatlog
- *
- * Calls the regeng re_parse() function, which is used to 
- * match a particular line to an event
- *
- * @param       chatstr     Chat line to process
+ * Update the language detection after a line was parsed
  *
- * @retval      true        On sucess  
- * @retval      false       If invalid chatlog line
+ * While the language is unknown, the languages of the matched patterns are
+ * counted and the first one that reaches @ref CHATLOG_LANG_DETECT matches is
+ * selected. From then on, only the patterns of this language are used.
+ * If lines keep hitting the patterns of other languages without a match,
+ * the detection starts over.
  */
-bool chatlog_readstr(char *chatstr)
+void chatlog_lang_update(void)
 {
-    char *pchat;
-    char uchat[CHATLOG_CHAT_SZ]; 
+    struct regeng *match = chatlog_rs->rs_match;
+    int ii;
 
-    /* Skip the timestamp, check if we're at the ':' character */
-    pchat = chatstr + CHATLOG_PREFIX_LEN;
+    if (match != NULL)
+    {
+        chatlog_lang_misses = chatlog_rs->rs_lang_misses;
+    }
 
-    /* Clearly this is an invalid line */
-    if (*pchat != ':')
-    { 
-        return true;
+    if (chatlog_lang_fixed) return;
+
+    if (chatlog_lang != 0)
+    {
+        if ((chatlog_rs->rs_lang_misses - chatlog_lang_misses) >= CHATLOG_LANG_MISS_MAX)
+        {
+            con_printf("CHATLOG: Too many misses, detecting the language again.\n");
+            chatlog_lang_select(0);
+        }
+
+        return;
     }
 
-    /* Convert the string to UTF8 */
-    util_cp1252_to_utf8(uchat, sizeof(uchat), pchat);
+    if ((match == NULL) || (match->re_lang == 0)) return;
 
-    /* Process it */
-    return re_parse(chatlog_parse, re_aion, uchat);
+    for (ii = 0; ii < RE_LANG_NUM; ii++)
+    {
+        if (!(match->re_lang & (1 << ii))) continue;
+
+        if (++chatlog_lang_hits[ii] >= CHATLOG_LANG_DETECT)
+        {
+            con_printf("CHATLOG: Detected language 0x%02X\n", 1 << ii);
+            chatlog_lang_select(1 << ii);
+            return;
+        }
+    }
 }
 
 /**
- * Checks if there are any new lines in the chatlog.
- * If there are it reads the chatlog and processes
- * the line; otherwise it immediatelly returns
+ * Set the chatlog language
  *
- * @retval      true        On success (note, this is returned
- *                          even if there are no new lines)
- * @retval      false       If fatal error
+ * The language is normally detected from the chatlog, this overrides it.
+ * "auto" keeps a language that was already selected, for example from
+ * system.ovr, but lets the detection change it again.
+ *
+ * @param[in]       lang        "en", "fr", "de" or "auto" to detect it
+ *
+ * @retval          true        On success
+ * @retval          false       If @p lang is not known
  */
-bool chatlog_poll()
+bool chatlog_lang_set(char *lang)
 {
-    char chatstr[CHATLOG_CHAT_SZ];
+    uint32_t mask;
 
-    if (!chatlog_open())
+    if (!chatlog_lang_parse(lang, &mask))
     {
+        con_printf("CHATLOG: Unknown language '%s'\n", lang);
         return false;
     }
 
-    /* Chatlog not open yet, return so we might process it later */
-    if (chatlog_file == NULL) return true;
+    chatlog_lang_fixed = (mask != 0);
 
-    /* Nothing to read? */
-    while (fgets(chatstr, sizeof(chatstr), chatlog_file) != NULL)
+    /* Don't drop the language picked up from system.ovr */
+    if ((mask == 0) && (chatlog_lang != 0))
     {
-        /* Remove ending new-lines */
-        util_chomp(chatstr);
-        chatlog_readstr(chatstr);
-    } 
+        return true;
+    }
+
+    chatlog_lang_start = mask;
+    chatlog_lang_select(mask);
 
     return true;
 }
 
 /**
- * This reads the file <I>file</I> as if it was a chatlog
+ * Get the path to the chatlog file
  *
- * This is mainly used for debugging.
+ * Uses aion_default_install_path() to find the path to the chatlog file.
  *
- * @param[in]       file        File to read chastlog from
+ * @param[out]      path        Buffer that will receive the path
+ * @param[in]       path_sz     Size of @p path
  *
- * @retval          true        On success
- * @retval          false       If there was an error processing the file
- *                              or could not be found
+ * @retval          true        If successfull
+ * @retval          false       If the Aion install path could not be found
  */
-bool chatlog_readfile(char *file)
+bool chatlog_path(char *path, size_t path_sz)
 {
-    char chatstr[CHATLOG_CHAT_SZ];
-    FILE *chatfile;
+#ifdef SYS_WINDOWS
+    char *chatlog_dir;
 
-    chatfile = fopen(file, "r");
-    if (chatfile == NULL)
+    chatlog_dir = aion_default_install_path();
+    if (chatlog_dir == NULL)
     {
-        con_printf("CHATLOG: Error reading file %s\n", file);
         return false;
     }
 
-    /* Nothing to read? */
-    while (fgets(chatstr, sizeof(chatstr), chatfile) != NULL)
-    {
-        /* Remove ending new-lines */
-        util_chomp(chatstr);
-
-        /* Parse chatlog */
-        chatlog_readstr(chatstr);
-    } 
-
-    fclose(chatfile);
+    /* Construct the path */
+    util_strlcpy(path, chatlog_dir, path_sz);
+    util_strlcat(path, "\\", path_sz);
+    util_strlcat(path, CHATLOG_FILENAME, path_sz);
+#else
+    util_strlcpy(path, "./" CHATLOG_FILENAME, path_sz);
+#endif
 
     return true;
 }
 
+/**
+ * Open the chatlog file
+ * 
+ * Uses chatlog_path() to find the path to the chatlog file.
+ *
+ * @retval      true        If successfull
+ * @retval      false       On error
+ */ 
+bool chatlog_open(void)
+{
+    char *path = chatlog_live_path;
+
+    if (chatlog_file != NULL)
+    {
+        /* Chat log file alrady open, return */
+        return true;
+    }
+
+    /* Try to open the cthatlog file */
+    if (!chatlog_path(path, sizeof(chatlog_live_path)))
+    {
+        con_printf("FATAL: Unable to find Aion install path.\n");
+        return false;
+    }
+
+    /* Binary mode, the checkpoint offsets must match the file */
+    chatlog_file = sys_fopen_force(path, "rb");
+    if (chatlog_file == NULL)
+    {
+        /* This can be just a temporary error, so return success */
+        con_printf("Error opening chat log: %s\n", path);
+        return true;
+    }
+
+    /* The file is read in large blocks, stdio buffering would just add a copy */
+    setvbuf(chatlog_file, NULL, _IONBF, 0);
+
+    /* Continue where we stopped the last time */
+    chatlog_reader_reset(&chatlog_live, 0);
+    chatlog_live.cr_pos = chatlog_ckpt_resume(chatlog_file);
+    if (!sys_fseek(chatlog_file, chatlog_live.cr_pos))
+    {
+        /* If we didn't succeed in the seek, we might be in trouble, so return a hard error */
+        return false;
+    }
+
+    chatlog_ckpt_pos = chatlog_live.cr_pos;
+
+    chatlog_ring.cq_pos = chatlog_live.cr_pos;
+    chatlog_ring.cq_hash = chatlog_live.cr_hash;
+    chatlog_ring.cq_hash_len = chatlog_live.cr_hash_len;
+
+    chatlog_live_idx_open();
+
+    return true;
+}
+
+/**
+ * Open the time index of the live chatlog, it's extended by chatlog_ring_parse()
+ * as new lines are parsed and saved together with the checkpoint
+ *
+ * The chatlog is not indexed here, that would scan it all on startup. The index
+ * is only loaded and used if it reaches the position where the reader starts;
+ * otherwise it's left as it is and the next replay of the chatlog updates it.
+ */
+void chatlog_live_idx_open(void)
+{
+    size_t map_len = 0;
+    char *map;
+
+    /* The chatlog may be opened again after an error */
+    chatlog_idx_free(&chatlog_live_idx);
+
+    /* An empty chatlog is not mapped */
+    map = sys_mmap(chatlog_live_path, &map_len);
+
+    if ((map == NULL) || !chatlog_idx_load(&chatlog_live_idx, chatlog_live_path, map, map_len))
+    {
+        chatlog_live_idx.ci_num = 0;
+        chatlog_live_idx.ci_len = 0;
+        chatlog_live_idx.ci_last = 0;
+    }
+
+    /* A chatlog that is read from the start is indexed as it's parsed */
+    chatlog_live_idx_valid = (chatlog_live_idx.ci_len >= chatlog_live.cr_pos);
+    chatlog_live_idx_len = chatlog_live_idx.ci_len;
+
+    if (!chatlog_live_idx_valid)
+    {
+        con_printf("IDX: The index of %s is behind, it's updated on the next replay\n", chatlog_live_path);
+    }
+
+    if (map != NULL)
+    {
+        sys_munmap(map, map_len);
+    }
+}
+
+/**
+ * @name Chatlog Checkpoint
+ *
+ * The position of the live chatlog reader is saved to CHATLOG_CKPT_FILE
+ * together with the identity, size and modification time of the chatlog
+ * and a hash of the last line that was read. When the chatlog is opened
+ * the position is restored only if the file is still the same one, wasn't
+ * truncated and the line before the position is the same; otherwise the
+ * chatlog was rotated or replaced and it's read from the start.
+ *
+ * @{
+ */
+
+/**
+ * Reset the reader @p cr to the file offset @p pos
+ */
+void chatlog_reader_reset(struct chatlog_reader *cr, uint64_t pos)
+{
+    cr->cr_len = 0;
+    cr->cr_skip = false;
+    cr->cr_pos = pos;
+    cr->cr_hash = 0;
+    cr->cr_hash_len = 0;
+}
+
+/**
+ * FNV-1a hash of @p str
+ */
+uint64_t chatlog_hash(const char *str, size_t len)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    size_t ii;
+
+    for (ii = 0; ii < len; ii++)
+    {
+        hash ^= (unsigned char)str[ii];
+        hash *= 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Get the path of the checkpoint file, it's in the same folder as the configuration file
+ */
+bool chatlog_ckpt_path(char *path, size_t path_sz)
+{
+    if (!sys_appdata_path(path, path_sz))
+    {
+        return false;
+    }
+
+    util_strlcat(path, "/", path_sz);
+    util_strlcat(path, CHATLOG_CKPT_FILE, path_sz);
+
+    return true;
+}
+
+/**
+ * Load the checkpoint from CHATLOG_CKPT_FILE
+ *
+ * @param[out]      ck          Loaded checkpoint
+ *
+ * @retval          true        On success
+ * @retval          false       If there's no valid checkpoint
+ */
+bool chatlog_ckpt_load(struct chatlog_ckpt *ck)
+{
+    unsigned long long val[7];
+    char path[UTIL_MAX_PATH];
+    unsigned version;
+    FILE *fck;
+    int nval;
+
+    if (!chatlog_ckpt_path(path, sizeof(path)))
+    {
+        return false;
+    }
+
+    fck = fopen(path, "r");
+    if (fck == NULL)
+    {
+        return false;
+    }
+
+    nval = fscanf(fck, "%u %llu %llu %llu %llu %llu %llu",
+                  &version, &val[0], &val[1], &val[2], &val[3], &val[4], &val[5]);
+
+    fclose(fck);
+
+    if ((nval != 7) || (version != CHATLOG_CKPT_VERSION) || (val[5] > CHATLOG_READ_SZ))
+    {
+        con_printf("CHATLOG: Ignoring invalid checkpoint %s\n", path);
+        return false;
+    }
+
+    ck->ck_stat.sf_id = val[0];
+    ck->ck_stat.sf_size = val[1];
+    ck->ck_stat.sf_mtime = val[2];
+    ck->ck_pos = val[3];
+    ck->ck_hash = val[4];
+    ck->ck_hash_len = val[5];
+
+    return true;
+}
+
+/**
+ * Save the position of the last parsed line of the live chatlog to CHATLOG_CKPT_FILE
+ *
+ * The checkpoint is written to a temporary file first, which then replaces the
+ * old one; a crash never leaves a truncated checkpoint.
+ */
+void chatlog_ckpt_save(void)
+{
+    char path[UTIL_MAX_PATH];
+    char tmp[UTIL_MAX_PATH];
+    struct sys_fstat sf;
+    FILE *fck;
+    bool retval;
+
+    if (!sys_fstat(chatlog_file, &sf))
+    {
+        return;
+    }
+
+    if (!chatlog_ckpt_path(path, sizeof(path)))
+    {
+        return;
+    }
+
+    util_strlcpy(tmp, path, sizeof(tmp));
+    util_strlcat(tmp, ".tmp", sizeof(tmp));
+
+    fck = fopen(tmp, "w");
+    if (fck == NULL)
+    {
+        con_printf("CHATLOG: Unable to save the checkpoint %s\n", tmp);
+        return;
+    }
+
+    retval = fprintf(fck, "%u %llu %llu %llu %llu %llu %llu\n",
+                     CHATLOG_CKPT_VERSION,
+                     (unsigned long long)sf.sf_id,
+                     (unsigned long long)sf.sf_size,
+                     (unsigned long long)sf.sf_mtime,
+                     (unsigned long long)chatlog_ring.cq_pos,
+                     (unsigned long long)chatlog_ring.cq_hash,
+                     (unsigned long long)chatlog_ring.cq_hash_len) > 0;
+
+    retval = (fclose(fck) == 0) && retval;
+
+    if (!retval || !sys_rename(tmp, path))
+    {
+        con_printf("CHATLOG: Unable to save the checkpoint %s\n", path);
+        remove(tmp);
+        return;
+    }
+
+    chatlog_ckpt_pos = chatlog_ring.cq_pos;
+}
+
+/**
+ * Save the checkpoint and the time index of the live chatlog if any line was
+ * parsed since the last save
+ */
+void chatlog_ckpt_flush(void)
+{
+    chatlog_ckpt_timestamp = 0;
+
+    if ((chatlog_file != NULL) && (chatlog_ring.cq_pos != chatlog_ckpt_pos))
+    {
+        chatlog_ckpt_save();
+    }
+
+    if (chatlog_live_idx_valid && (chatlog_live_idx.ci_len != chatlog_live_idx_len))
+    {
+        chatlog_idx_save(&chatlog_live_idx, chatlog_live_path);
+        chatlog_live_idx_len = chatlog_live_idx.ci_len;
+    }
+}
+
+/**
+ * Save the checkpoint @ref CHATLOG_CKPT_DELAY after the first line that was
+ * parsed since the last save
+ *
+ * This is called by the main loop periodically, see chatlog_periodic_timeout().
+ */
+void chatlog_periodic(void)
+{
+    if (chatlog_ckpt_timestamp == 0)
+    {
+        return;
+    }
+
+    if ((sys_monotime() - chatlog_ckpt_timestamp) < CHATLOG_CKPT_DELAY) return;
+
+    chatlog_ckpt_flush();
+}
+
+/**
+ * Return the time left until chatlog_periodic() saves the checkpoint
+ *
+ * @param[out]      timeout     Time left in miliseconds, 0 if the save is due
+ *
+ * @retval          true        If there's a checkpoint to save
+ * @retval          false       If there's nothing to save
+ */
+bool chatlog_periodic_timeout(uint64_t *timeout)
+{
+    uint64_t elapsed;
+
+    if (chatlog_ckpt_timestamp == 0)
+    {
+        return false;
+    }
+
+    elapsed = sys_monotime() - chatlog_ckpt_timestamp;
+
+    *timeout = (elapsed < CHATLOG_CKPT_DELAY) ? CHATLOG_CKPT_DELAY - elapsed : 0;
+
+    return true;
+}
+
+/**
+ * Find the offset in the chatlog @p file where reading should start
+ *
+ * Without a checkpoint, the chatlog is read from the end on Windows, the old
+ * lines were already processed by previous runs, and from the start on other
+ * systems.
+ *
+ * @param[in]       file        The opened chatlog
+ *
+ * @return
+ * File offset where to start reading, the hash of the last line is restored
+ * into the live reader
+ */
+uint64_t chatlog_ckpt_resume(FILE *file)
+{
+    struct chatlog_ckpt ck;
+    struct sys_fstat sf;
+    char *line;
+    size_t len;
+
+    if (!sys_fstat(file, &sf))
+    {
+        return 0;
+    }
+
+    if (!chatlog_ckpt_load(&ck))
+    {
+#ifdef SYS_WINDOWS
+        return sf.sf_size;
+#else
+        return 0;
+#endif
+    }
+
+    if ((sf.sf_id != ck.ck_stat.sf_id) || (sf.sf_mtime < ck.ck_stat.sf_mtime))
+    {
+        con_printf("CHATLOG: Chatlog was rotated, reading from the start\n");
+        return 0;
+    }
+
+    if (sf.sf_size < ck.ck_pos)
+    {
+        con_printf("CHATLOG: Chatlog was truncated, reading from the start\n");
+        return 0;
+    }
+
+    /* Check that the line before the position is the last line that was read */
+    len = ck.ck_hash_len;
+    if ((len > 0) && (ck.ck_pos > len))
+    {
+        line = chatlog_live.cr_buf;
+
+        if (!sys_fseek(file, ck.ck_pos - len - 1) ||
+            (fread(line, 1, len + 1, file) != len + 1) ||
+            (line[len] != '\n') ||
+            (chatlog_hash(line, len) != ck.ck_hash))
+        {
+            con_printf("CHATLOG: Chatlog was replaced, reading from the start\n");
+            clearerr(file);
+            return 0;
+        }
+    }
+
+    con_printf("CHATLOG: Resuming at offset %llu, %llu new bytes\n",
+               (unsigned long long)ck.ck_pos,
+               (unsigned long long)(sf.sf_size - ck.ck_pos));
+
+    chatlog_live.cr_hash = ck.ck_hash;
+    chatlog_live.cr_hash_len = ck.ck_hash_len;
+
+    return ck.ck_pos;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * Initialize the chat log facility
+ *
+ * This must be called before any other chatlog function
+ *
+ * @retval      true        On success
+ * @retval      false       On error
+ */
+bool chatlog_init()
+{
+    char lang[64];
+    uint32_t mask;
+
+    if (!re_init(&re_aion_set))
+    {
+        con_printf("Unable to initialize the regex subsystem.\n");
+        return false;
+    }
+
+    /* Don't lose the lines parsed since the last checkpoint save */
+    atexit(chatlog_ckpt_flush);
+
+    /* Start with the client language if it's known, it's still verified by the detection */
+    if (aion_sysovr_get(AION_SYSOVR_LANG, lang, sizeof(lang)) && chatlog_lang_parse(lang, &mask))
+    {
+        con_printf("CHATLOG: system.ovr language is %s\n", lang);
+        chatlog_lang_start = mask;
+        chatlog_lang_select(mask);
+    }
+
+#ifdef SYS_UNIX
+    if ((chatlog_notify_fd[0] < 0) && (pipe(chatlog_notify_fd) == 0))
+    {
+        fcntl(chatlog_notify_fd[0], F_SETFL, O_NONBLOCK);
+        fcntl(chatlog_notify_fd[1], F_SETFL, O_NONBLOCK);
+    }
+#endif
+
+    return true;
+}
+
+/**
+ * Find the message of a chatlog line, the part after the timestamp
+ *
+ * @param[in]       chatstr     Chat line, without the new-line
+ * @param[in,out]   chatstr_len Length of @p chatstr, on return the length of the message
+ *
+ * @return
+ * The message, starting with the ':' character, or NULL if this is not a valid
+ * chatlog line
+ */
+char *chatlog_msg(char *chatstr, size_t *chatstr_len)
+{
+    size_t len = *chatstr_len;
+
+    /* Remove the ending carriage return */
+    if ((len > 0) && (chatstr[len - 1] == '\r'))
+    {
+        len--;
+    }
+
+    /* Clearly this is an invalid line */
+    if (len <= CHATLOG_PREFIX_LEN)
+    {
+        return NULL;
+    }
+
+    /* Skip the timestamp, check if we're at the ':' character */
+    if (chatstr[CHATLOG_PREFIX_LEN] != ':')
+    { 
+        return NULL;
+    }
+
+    *chatstr_len = len - CHATLOG_PREFIX_LEN;
+
+    return chatstr + CHATLOG_PREFIX_LEN;
+}
+
+/**
+ * Start a parsing session in the calling thread
+ *
+ * The thread gets its own copy of the pattern set and language detection, so
+ * chatlog_readfile() can be called by several threads at the same time. The
+ * events go to the session of the thread, see aion_session_init(). The main
+ * thread doesn't need a session, chatlog_init() sets it up.
+ *
+ * @retval      true        On success
+ * @retval      false       On memory allocation error
+ */
+bool chatlog_session_init(void)
+{
+    struct chatlog_session *cs;
+
+    cs = calloc(1, sizeof(*cs));
+    if (cs == NULL)
+    {
+        return false;
+    }
+
+    if (!re_clone(&cs->cs_rs, &re_aion_set))
+    {
+        free(cs);
+        return false;
+    }
+
+    chatlog_session = cs;
+    chatlog_rs = &cs->cs_rs;
+    chatlog_replay = &cs->cs_replay;
+    chatlog_lang_select(chatlog_lang_start);
+
+    return true;
+}
+
+/**
+ * End the parsing session of the calling thread
+ */
+void chatlog_session_free(void)
+{
+    if (chatlog_session == NULL) return;
+
+    re_clone_free(&chatlog_session->cs_rs);
+    free(chatlog_session);
+
+    chatlog_session = NULL;
+    chatlog_rs = &re_aion_set;
+    chatlog_replay = &chatlog_replay_main;
+}
+
+/**
+ * Processes a line from the chatlog
+ *
+ * Calls the regeng re_parsen() function, which is used to 
+ * match a particular line to an event. The line is matched
+ * in the CP-1252 encoding, as it's stored in the chatlog.
+ *
+ * @param       chatstr     Chat line to process, without the new-line;
+ *                          it doesn't have to be terminated
+ * @param       chatstr_len Length of @p chatstr
+ *
+ * @retval      true        On sucess  
+ * @retval      false       If invalid chatlog line
+ */
+bool chatlog_readstr(char *chatstr, size_t chatstr_len)
+{
+    char *pchat;
+
+    pchat = chatlog_msg(chatstr, &chatstr_len);
+    if (pchat == NULL)
+    {
+        return true;
+    }
+
+    /* Process it */
+    if (!re_parsen(chatlog_parse, chatlog_rs, pchat, chatstr_len))
+    {
+        return false;
+    }
+
+    chatlog_lang_update();
+
+    return true;
+}
+
+/**
+ * Read up to @p len bytes from @p file to the end of the read buffer of @p cr
+ *
+ * If the reader has a compressed file, it's read instead of @p file.
+ *
+ * @return
+ * Number of bytes read, 0 at the end of the file or on errors
+ */
+size_t chatlog_fread(struct chatlog_reader *cr, FILE *file, size_t len)
+{
+#ifdef CHATLOG_ZLIB
+    int nread;
+
+    if (cr->cr_gz != NULL)
+    {
+        nread = gzread(cr->cr_gz, cr->cr_buf + cr->cr_len, len);
+        return (nread > 0) ? (size_t)nread : 0;
+    }
+#endif
+
+    return fread(cr->cr_buf + cr->cr_len, 1, len, file);
+}
+
+/**
+ * Check for read errors after chatlog_fread() returned 0
+ *
+ * @param[in]   cr          Reader state
+ * @param[in]   file        File that was read
+ * @param[in]   cq          Ring of the reader thread, see chatlog_read_msg()
+ *
+ * @retval      true        On read errors, a message is printed
+ * @retval      false       At the end of the file
+ */
+bool chatlog_ferror(struct chatlog_reader *cr, FILE *file, struct chatlog_ring *cq)
+{
+#ifdef CHATLOG_ZLIB
+    const char *msg;
+    int err;
+
+    if (cr->cr_gz != NULL)
+    {
+        msg = gzerror(cr->cr_gz, &err);
+        if (err == Z_OK)
+        {
+            return false;
+        }
+
+        chatlog_read_msg(cq, "CHATLOG: Error decompressing the chatlog: %s\n", (err == Z_ERRNO) ? strerror(errno) : msg);
+        return true;
+    }
+#else
+    (void)cr;
+#endif
+
+    if (!ferror(file))
+    {
+        return false;
+    }
+
+    chatlog_read_msg(cq, "CHATLOG: Error reading the chatlog: %s\n", strerror(errno));
+    return true;
+}
+
+/**
+ * Read @p file up to the end and process every complete line
+ *
+ * The lines are found with util_memchr() and passed to chatlog_readstr()
+ * directly from the read buffer, or copied to the ring @p cq if it's given.
+ * Lines longer than CHATLOG_READ_SZ are dropped.
+ *
+ * @param[in,out]   cr          Reader state
+ * @param[in]       file        File to read, must be unbuffered; not used if
+ *                              the reader has a compressed file
+ * @param[in]       flush       Process the last line even if it doesn't end
+ *                              with a new-line
+ * @param[in,out]   cq          Ring to push the lines to, NULL to parse them here
+ *
+ * @retval          true        On success
+ * @retval          false       On read errors
+ */
+bool chatlog_read(struct chatlog_reader *cr, FILE *file, bool flush, struct chatlog_ring *cq)
+{
+    size_t nread;
+    char *plast;
+    char *pline;
+    char *peol;
+    char *pend;
+    bool retval;
+
+    while ((nread = chatlog_fread(cr, file, CHATLOG_READ_SZ - cr->cr_len)) > 0)
+    {
+        plast = NULL;
+        pline = cr->cr_buf;
+        pend = cr->cr_buf + cr->cr_len + nread;
+
+        while ((peol = util_memchr(pline, '\n', pend - pline)) != NULL)
+        {
+            if (!cr->cr_skip)
+            {
+                if (cq == NULL)
+                {
+                    chatlog_readstr(pline, peol - pline);
+                }
+                else
+                {
+                    chatlog_ring_push(cq, pline, peol - pline, cr->cr_pos + (peol + 1 - cr->cr_buf), false);
+                }
+
+                plast = pline;
+            }
+            else
+            {
+                plast = NULL;
+            }
+
+            cr->cr_skip = false;
+            pline = peol + 1;
+        }
+
+        /* Remember the last line, it's used to validate the checkpoint */
+        if (pline != cr->cr_buf)
+        {
+            cr->cr_pos += pline - cr->cr_buf;
+            cr->cr_hash_len = (plast != NULL) ? (size_t)(pline - 1 - plast) : 0;
+            cr->cr_hash = chatlog_hash(plast, cr->cr_hash_len);
+        }
+
+        cr->cr_len = pend - pline;
+        if (cr->cr_len >= CHATLOG_READ_SZ)
+        {
+            chatlog_read_msg(cq, "CHATLOG: Line too long, skipping it.\n");
+            cr->cr_pos += cr->cr_len;
+
+            if (cq != NULL)
+            {
+                __atomic_store_n(&cq->cq_overflow, cq->cq_overflow + 1, __ATOMIC_RELAXED);
+                chatlog_ring_push(cq, NULL, 0, cr->cr_pos, false);
+            }
+
+            cr->cr_hash_len = 0;
+            cr->cr_skip = true;
+            cr->cr_len = 0;
+        }
+        else if (pline != cr->cr_buf)
+        {
+            memmove(cr->cr_buf, pline, cr->cr_len);
+        }
+    }
+
+    retval = !chatlog_ferror(cr, file, cq);
+
+    /* The EOF indicator is sticky on some C libraries, clear it so new lines can be read */
+    if (file != NULL)
+    {
+        clearerr(file);
+    }
+
+    if (flush)
+    {
+        if ((cr->cr_len > 0) && !cr->cr_skip)
+        {
+            chatlog_readstr(cr->cr_buf, cr->cr_len);
+        }
+
+        chatlog_reader_reset(cr, cr->cr_pos + cr->cr_len);
+    }
+
+    return retval;
+}
+
+/**
+ * @name Chatlog Reader Thread
+ *
+ * The live chatlog is read by a separate thread, which copies the lines into
+ * chatlog_ring. The thread that calls chatlog_poll() parses them in batches.
+ *
+ * @{
+ */
+
+/**
+ * Print a message of chatlog_read()
+ *
+ * The reader thread doesn't print anything itself, with a ring @p cq the
+ * message is pushed to it and printed by the parser, in order with the lines.
+ *
+ * @param[in,out]   cq          Ring, NULL to print the message now
+ * @param[in]       fmt         printf-like format
+ * @param[in]       ...         Additional arguments
+ */
+void chatlog_read_msg(struct chatlog_ring *cq, char *fmt, ...)
+{
+    char msg[CHATLOG_MSG_SZ];
+    va_list vargs;
+    int len;
+
+    va_start(vargs, fmt);
+    len = vsnprintf(msg, sizeof(msg), fmt, vargs);
+    va_end(vargs);
+
+    if (len < 0) return;
+    if ((size_t)len >= sizeof(msg)) len = sizeof(msg) - 1;
+
+    if (cq == NULL)
+    {
+        con_printf("%s", msg);
+        return;
+    }
+
+    chatlog_ring_push(cq, msg, len, 0, true);
+}
+
+/**
+ * Copy the line @p str to the ring @p cq, called by the reader thread
+ *
+ * If the ring is full this waits until the parser makes room, the parser signals
+ * chatlog_reader_cond when it does.
+ *
+ * @param[in,out]   cq          Ring
+ * @param[in]       str         Line, without the new-line
+ * @param[in]       len         Length of @p str, 0 for a skipped line
+ * @param[in]       pos         Chatlog offset after the line
+ * @param[in]       msg         @p str is a message to print, see chatlog_read_msg()
+ */
+void chatlog_ring_push(struct chatlog_ring *cq, char *str, size_t len, uint64_t pos, bool msg)
+{
+    struct chatlog_line *cl;
+    uint64_t tstart;
+    uint64_t off;
+
+    /* Keep the line contiguous, skip the end of the buffer if it doesn't fit */
+    off = cq->cq_wr;
+    if (((off % CHATLOG_RING_SZ) + len) > CHATLOG_RING_SZ)
+    {
+        off += CHATLOG_RING_SZ - (off % CHATLOG_RING_SZ);
+    }
+
+    if (((cq->cq_head - __atomic_load_n(&cq->cq_tail, __ATOMIC_ACQUIRE)) >= CHATLOG_RING_LINES) ||
+        ((off + len - __atomic_load_n(&cq->cq_rd, __ATOMIC_ACQUIRE)) > CHATLOG_RING_SZ))
+    {
+        /* The counters are read by chatlog_reader_stats() in the parser thread */
+        __atomic_store_n(&cq->cq_full, cq->cq_full + 1, __ATOMIC_RELAXED);
+        tstart = sys_monotime_ns();
+
+        pthread_mutex_lock(&chatlog_reader_lock);
+        while (((cq->cq_head - __atomic_load_n(&cq->cq_tail, __ATOMIC_ACQUIRE)) >= CHATLOG_RING_LINES) ||
+               ((off + len - __atomic_load_n(&cq->cq_rd, __ATOMIC_ACQUIRE)) > CHATLOG_RING_SZ))
+        {
+            pthread_cond_wait(&chatlog_reader_cond, &chatlog_reader_lock);
+        }
+        pthread_mutex_unlock(&chatlog_reader_lock);
+
+        __atomic_store_n(&cq->cq_full_ns, cq->cq_full_ns + (sys_monotime_ns() - tstart), __ATOMIC_RELAXED);
+    }
+
+    cl = &cq->cq_line[cq->cq_head % CHATLOG_RING_LINES];
+    cl->cl_off = off;
+    cl->cl_len = len;
+    cl->cl_pos = pos;
+    cl->cl_msg = msg;
+
+    if (len > 0)
+    {
+        memcpy(cq->cq_buf + (off % CHATLOG_RING_SZ), str, len);
+    }
+
+    cq->cq_wr = off + len;
+
+    /* Publish the line, the data must be visible before the new head */
+    __atomic_store_n(&cq->cq_head, cq->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Parse the lines in the ring @p cq, called by the parser thread
+ *
+ * The reader is given back the space every CHATLOG_RING_BATCH lines, so it
+ * can continue while the rest is parsed.
+ *
+ * @param[in,out]   cq          Ring
+ */
+void chatlog_ring_parse(struct chatlog_ring *cq)
+{
+    struct chatlog_line *cl;
+    uint64_t head;
+    uint64_t tail;
+    char *str;
+
+    tail = cq->cq_tail;
+
+    while ((head = __atomic_load_n(&cq->cq_head, __ATOMIC_ACQUIRE)) != tail)
+    {
+        if ((head - tail) > cq->cq_max)
+        {
+            cq->cq_max = head - tail;
+        }
+
+        if ((head - tail) > CHATLOG_RING_BATCH)
+        {
+            head = tail + CHATLOG_RING_BATCH;
+        }
+
+        for (; tail != head; tail++)
+        {
+            cl = &cq->cq_line[tail % CHATLOG_RING_LINES];
+            str = cq->cq_buf + (cl->cl_off % CHATLOG_RING_SZ);
+
+            if (cl->cl_msg)
+            {
+                con_printf("%.*s", (int)cl->cl_len, str);
+                continue;
+            }
+
+            /* The line is hashed before it's parsed, the checkpoint must match the chatlog */
+            cq->cq_pos = cl->cl_pos;
+            cq->cq_hash_len = cl->cl_len;
+            cq->cq_hash = chatlog_hash(str, cl->cl_len);
+
+            if (cl->cl_len > 0)
+            {
+                /* Lines that were indexed when the chatlog was opened are skipped */
+                if (chatlog_live_idx_valid && (cq == &chatlog_ring) &&
+                    !chatlog_idx_append(&chatlog_live_idx, str, cl->cl_len, cl->cl_pos - cl->cl_len - 1))
+                {
+                    chatlog_live_idx_valid = false;
+                }
+
+                chatlog_readstr(str, cl->cl_len);
+            }
+        }
+
+        cq->cq_batches++;
+
+        /* Return the space to the reader */
+        __atomic_store_n(&cq->cq_rd, cl->cl_off + cl->cl_len, __ATOMIC_RELEASE);
+        __atomic_store_n(&cq->cq_tail, tail, __ATOMIC_RELEASE);
+
+        /* The reader may be waiting for the space, the lock makes sure it's not about to */
+        pthread_mutex_lock(&chatlog_reader_lock);
+        pthread_cond_signal(&chatlog_reader_cond);
+        pthread_mutex_unlock(&chatlog_reader_lock);
+    }
+}
+
+/**
+ * Read the new lines of the live chatlog into chatlog_ring, called by the reader thread
+ *
+ * @retval      true        On success
+ * @retval      false       On read errors
+ */
+bool chatlog_reader_poll(void)
+{
+    struct sys_fstat sf;
+    uint64_t head;
+
+    head = chatlog_ring.cq_head;
+
+    if (!chatlog_read(&chatlog_live, chatlog_file, false, &chatlog_ring))
+    {
+        return false;
+    }
+
+    /* The chatlog was truncated while it was open, start from the beginning */
+    if (sys_fstat(chatlog_file, &sf) && (sf.sf_size < (chatlog_live.cr_pos + chatlog_live.cr_len)))
+    {
+        chatlog_read_msg(&chatlog_ring, "CHATLOG: Chatlog was truncated, reading from the start\n");
+
+        chatlog_reader_reset(&chatlog_live, 0);
+        if (!sys_fseek(chatlog_file, 0) || !chatlog_read(&chatlog_live, chatlog_file, false, &chatlog_ring))
+        {
+            return false;
+        }
+    }
+
+#ifdef SYS_UNIX
+    /* Wake up the parser if it's waiting for chatlog_poll_fd() */
+    if ((chatlog_ring.cq_head != head) &&
+        !__atomic_exchange_n(&chatlog_ring.cq_notify, true, __ATOMIC_ACQ_REL) &&
+        (write(chatlog_notify_fd[1], "", 1) < 0))
+    {
+        /* The pipe is full, the parser will be woken anyway */
+    }
+#else
+    (void)head;
+#endif
+
+    return true;
+}
+
+/**
+ * The reader thread, reads the live chatlog when woken by chatlog_poll() or
+ * at CHATLOG_READER_HZ
+ *
+ * @param[in]   arg         Not used
+ *
+ * @return
+ * NULL, when the chatlog cannot be read anymore
+ */
+void *chatlog_reader_main(void *arg)
+{
+    struct timespec ts;
+
+    (void)arg;
+
+    for (;;)
+    {
+        if (!chatlog_reader_poll())
+        {
+            __atomic_store_n(&chatlog_reader_error, true, __ATOMIC_RELEASE);
+            break;
+        }
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000000 / CHATLOG_READER_HZ;
+        if (ts.tv_nsec >= 1000000000)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        pthread_mutex_lock(&chatlog_reader_lock);
+        while (!chatlog_reader_wake)
+        {
+            if (pthread_cond_timedwait(&chatlog_reader_cond, &chatlog_reader_lock, &ts) != 0) break;
+        }
+        chatlog_reader_wake = false;
+        pthread_mutex_unlock(&chatlog_reader_lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * Start the reader thread, the chatlog must be open
+ *
+ * @retval      true        On success or if the thread is already running
+ * @retval      false       If the thread could not be created
+ */
+bool chatlog_reader_start(void)
+{
+    if (chatlog_reader_started)
+    {
+        return true;
+    }
+
+    if (pthread_create(&chatlog_reader_thread, NULL, chatlog_reader_main, NULL) != 0)
+    {
+        con_printf("CHATLOG: Unable to start the reader thread\n");
+        return false;
+    }
+
+    chatlog_reader_started = true;
+
+    return true;
+}
+
+#ifdef SYS_UNIX
+/**
+ * File descriptor that becomes readable when the reader thread has new
+ * lines, chatlog_poll() should be called then
+ *
+ * @return
+ * The file descriptor or -1 if it's not available
+ */
+int chatlog_poll_fd(void)
+{
+    return chatlog_notify_fd[0];
+}
+#endif
+
+/**
+ * Summary of the reader ring statistics
+ *
+ * @param[out]  buf         Output buffer
+ * @param[in]   buf_sz      Size of @p buf
+ *
+ * @retval      true        On success
+ * @retval      false       If the reader thread is not running
+ */
+bool chatlog_reader_stats(char *buf, size_t buf_sz)
+{
+    if (!chatlog_reader_started)
+    {
+        *buf = '\0';
+        return false;
+    }
+
+    snprintf(buf, buf_sz, "Reader: %llu lines in %llu batches, max queued %llu, ring full %llu times (%llu ms), %llu long lines skipped",
+             (unsigned long long)chatlog_ring.cq_tail,
+             (unsigned long long)chatlog_ring.cq_batches,
+             (unsigned long long)chatlog_ring.cq_max,
+             (unsigned long long)__atomic_load_n(&chatlog_ring.cq_full, __ATOMIC_RELAXED),
+             (unsigned long long)(__atomic_load_n(&chatlog_ring.cq_full_ns, __ATOMIC_RELAXED) / 1000000),
+             (unsigned long long)__atomic_load_n(&chatlog_ring.cq_overflow, __ATOMIC_RELAXED));
+
+    return true;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * Checks if there are any new lines in the chatlog.
+ * If there are it parses the lines that were read by
+ * the reader thread; otherwise it immediatelly returns
+ *
+ * The reader thread is started on the first call and
+ * woken up on every call. A line that is still being
+ * written is kept by the reader until its new-line is
+ * read.
+ *
+ * @retval      true        On success (note, this is returned
+ *                          even if there are no new lines)
+ * @retval      false       If fatal error
+ */
+bool chatlog_poll()
+{
+    bool error;
+#ifdef SYS_UNIX
+    char buf[64];
+#endif
+
+    if (!chatlog_open())
+    {
+        return false;
+    }
+
+    /* Chatlog not open yet, return so we might process it later */
+    if (chatlog_file == NULL) return true;
+
+    if (!chatlog_reader_start())
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&chatlog_reader_lock);
+    chatlog_reader_wake = true;
+    pthread_cond_signal(&chatlog_reader_cond);
+    pthread_mutex_unlock(&chatlog_reader_lock);
+
+#ifdef SYS_UNIX
+    /* Clear the notification before parsing, lines pushed after this notify again */
+    __atomic_store_n(&chatlog_ring.cq_notify, false, __ATOMIC_RELEASE);
+    while (read(chatlog_notify_fd[0], buf, sizeof(buf)) > 0);
+#endif
+
+    /* Read the error first, the error message of the reader is in the ring then */
+    error = __atomic_load_n(&chatlog_reader_error, __ATOMIC_ACQUIRE);
+
+    chatlog_ring_parse(&chatlog_ring);
+
+    /* The checkpoint is saved later by chatlog_periodic() */
+    if ((chatlog_ring.cq_pos != chatlog_ckpt_pos) && (chatlog_ckpt_timestamp == 0))
+    {
+        chatlog_ckpt_timestamp = sys_monotime();
+    }
+
+    return !error;
+}
+
+/**
+ * Process every line of the memory mapped chatlog @p map
+ *
+ * The lines are parsed directly from the mapping, nothing is copied. Only the
+ * lines with a timestamp between @p tm_start and @p tm_end are processed,
+ * lines without a timestamp belong to the previous line.
+ *
+ * @param[in]       map         Mapped chatlog
+ * @param[in]       map_len     Length of @p map
+ * @param[in]       tm_start    Skip lines older than this
+ * @param[in]       tm_end      Stop at the first line newer than this
+ */
+void chatlog_readmap(char *map, size_t map_len, uint64_t tm_start, uint64_t tm_end)
+{
+    bool all_time;
+    uint64_t tm;
+    char *pline;
+    char *peol;
+    char *pend;
+
+    all_time = (tm_start == 0) && (tm_end == UINT64_MAX);
+
+    tm = 0;
+    pend = map + map_len;
+
+    for (pline = map; pline < pend; pline = peol + 1)
+    {
+        peol = util_memchr(pline, '\n', pend - pline);
+        if (peol == NULL)
+        {
+            /* Last line without a new-line */
+            peol = pend;
+        }
+
+        if (!all_time)
+        {
+            chatlog_time_parse(pline, peol - pline, &tm);
+
+            if (tm < tm_start) continue;
+            if (tm > tm_end) break;
+        }
+
+        chatlog_readstr(pline, peol - pline);
+    }
+}
+
+/**
+ * Record a line of the chunk @p cc that was parsed with the set @p rs
+ *
+ * @param[in,out]   cc          Chunk
+ * @param[in]       str         Line without the timestamp
+ * @param[in]       str_len     Length of @p str
+ * @param[in]       rs          Set that parsed @p str, if it has a match it's recorded
+ *                              with its groups, otherwise the line will be parsed again
+ *
+ * @retval          true        On success
+ * @retval          false       On memory allocation error
+ */
+bool chatlog_chunk_record(struct chatlog_chunk *cc, char *str, size_t str_len, struct regeng_set *rs)
+{
+    struct chatlog_event *ce;
+    void *ptr;
+
+    if (cc->cc_event_num >= cc->cc_event_max)
+    {
+        cc->cc_event_max = (cc->cc_event_max == 0) ? 1024 : cc->cc_event_max * 2;
+
+        ptr = realloc(cc->cc_event, cc->cc_event_max * sizeof(struct chatlog_event));
+        if (ptr == NULL) return false;
+
+        cc->cc_event = ptr;
+    }
+
+    if ((rs->rs_match != NULL) && ((cc->cc_cap_num + rs->rs_cap_num) > cc->cc_cap_max))
+    {
+        cc->cc_cap_max = (cc->cc_cap_max == 0) ? 4096 : cc->cc_cap_max * 2;
+
+        ptr = realloc(cc->cc_cap, cc->cc_cap_max * sizeof(struct re_capture));
+        if (ptr == NULL) return false;
+
+        cc->cc_cap = ptr;
+    }
+
+    ce = &cc->cc_event[cc->cc_event_num++];
+
+    ce->ce_str = str;
+    ce->ce_len = str_len;
+    ce->ce_idx = -1;
+    ce->ce_lang = rs->rs_lit_lang;
+    ce->ce_cap = cc->cc_cap_num;
+
+    if (rs->rs_match != NULL)
+    {
+        ce->ce_idx = rs->rs_match - rs->rs_array;
+
+        memcpy(&cc->cc_cap[cc->cc_cap_num], rs->rs_cap, rs->rs_cap_num * sizeof(struct re_capture));
+        cc->cc_cap_num += rs->rs_cap_num;
+    }
+
+    return true;
+}
+
+/**
+ * Parse the lines of the chunk @p cc, this is called by the replay threads
+ *
+ * The lines are matched with all languages active. A line without a match
+ * that was rejected by the prefilter doesn't match with any language and is
+ * dropped. The other lines are recorded; the language doesn't change the
+ * result of a match if its expression is still active when it's processed.
+ * A line without a match can't match with fewer languages either, it's only
+ * parsed again by chatlog_chunk_process() if it's a language miss there.
+ *
+ * @param[in,out]   cc          Chunk to parse
+ * @param[in]       rs          Private copy of @ref re_aion_set
+ */
+void chatlog_chunk_parse(struct chatlog_chunk *cc, struct regeng_set *rs)
+{
+    uint64_t rejects;
+    size_t msg_len;
+    char *pline;
+    char *peol;
+    char *pmsg;
+
+    for (pline = cc->cc_start; pline < cc->cc_end; pline = peol + 1)
+    {
+        peol = util_memchr(pline, '\n', cc->cc_end - pline);
+        if (peol == NULL)
+        {
+            peol = cc->cc_end;
+        }
+
+        msg_len = peol - pline;
+        pmsg = chatlog_msg(pline, &msg_len);
+        if (pmsg == NULL) continue;
+
+        rejects = rs->rs_pf_rejects;
+
+        re_parsen(NULL, rs, pmsg, msg_len);
+
+        if ((rs->rs_match == NULL) && (rs->rs_pf_rejects != rejects)) continue;
+
+        if (!chatlog_chunk_record(cc, pmsg, msg_len, rs))
+        {
+            cc->cc_error = true;
+            break;
+        }
+    }
+}
+
+/**
+ * Process the events of the parsed chunk @p cc, in order
+ *
+ * @param[in,out]   cc          Chunk, its events are freed
+ */
+void chatlog_chunk_process(struct chatlog_chunk *cc)
+{
+    struct chatlog_event *ce;
+    size_t ii;
+
+    if (cc->cc_error)
+    {
+        con_printf("CHATLOG: Out of memory, parsing the chunk again\n");
+        chatlog_readmap(cc->cc_start, cc->cc_end - cc->cc_start, 0, UINT64_MAX);
+    }
+    else
+    {
+        for (ii = 0; ii < cc->cc_event_num; ii++)
+        {
+            ce = &cc->cc_event[ii];
+
+            if ((ce->ce_idx < 0) || !re_apply(chatlog_parse, chatlog_rs, ce->ce_idx, ce->ce_str, &cc->cc_cap[ce->ce_cap]))
+            {
+                /*
+                 * A line without a match is only parsed again to count the language miss,
+                 * if it has the literal of an expression that is not active now
+                 */
+                if ((ce->ce_idx < 0) && ((chatlog_rs->rs_lang == 0) || ((ce->ce_lang & ~chatlog_rs->rs_lang) == 0))) continue;
+
+                re_parsen(chatlog_parse, chatlog_rs, ce->ce_str, ce->ce_len);
+            }
+
+            chatlog_lang_update();
+        }
+    }
+
+    free(cc->cc_event);
+    free(cc->cc_cap);
+
+    cc->cc_event = NULL;
+    cc->cc_cap = NULL;
+}
+
+/**
+ * Main function of the replay threads
+ *
+ * Chunks are parsed in order, but at most @p cj_ahead chunks past the one being
+ * processed, so only a few chunks hold events at any time.
+ *
+ * @param[in]       arg         The @ref chatlog_worker of this thread
+ *
+ * @return
+ * Always NULL
+ */
+void *chatlog_worker_main(void *arg)
+{
+    struct chatlog_worker *cw = arg;
+    struct chatlog_jobs *cj = cw->cw_jobs;
+    size_t idx;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&cj->cj_lock);
+
+        while ((cj->cj_next < cj->cj_num) && ((cj->cj_next - cj->cj_done) >= cj->cj_ahead))
+        {
+            pthread_cond_wait(&cj->cj_cond, &cj->cj_lock);
+        }
+
+        if (cj->cj_next >= cj->cj_num)
+        {
+            pthread_mutex_unlock(&cj->cj_lock);
+            break;
+        }
+
+        idx = cj->cj_next++;
+
+        pthread_mutex_unlock(&cj->cj_lock);
+
+        chatlog_chunk_parse(&cj->cj_chunk[idx], &cw->cw_rs);
+
+        pthread_mutex_lock(&cj->cj_lock);
+        cj->cj_chunk[idx].cc_done = true;
+        pthread_cond_broadcast(&cj->cj_cond);
+        pthread_mutex_unlock(&cj->cj_lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * Process every line of the memory mapped chatlog @p map with multiple threads
+ *
+ * The chatlog is split into chunks of about @ref CHATLOG_CHUNK_SZ bytes at line
+ * boundaries. The replay threads match the lines of the chunks with their own
+ * copies of @ref re_aion_set, this is where almost all of the time is spent. The
+ * matches are processed by this thread in file order, so the results are the same
+ * as with chatlog_readmap().
+ *
+ * @param[in]       map         Mapped chatlog
+ * @param[in]       map_len     Length of @p map
+ */
+void chatlog_readmap_jobs(char *map, size_t map_len)
+{
+    struct chatlog_worker *cw;
+    struct chatlog_chunk *cc;
+    struct chatlog_jobs cj;
+    unsigned nworkers;
+    unsigned ii;
+    char *pstart;
+    char *pend;
+    char *peol;
+    size_t idx;
+
+    /* Sessions of other threads always parse the chatlog on their own */
+    if ((chatlog_jobs_num <= 1) || (map_len < (2 * CHATLOG_CHUNK_SZ)) || (chatlog_rs != &re_aion_set))
+    {
+        chatlog_readmap(map, map_len, 0, UINT64_MAX);
+        return;
+    }
+
+    memset(&cj, 0, sizeof(cj));
+
+    cj.cj_num = (map_len + CHATLOG_CHUNK_SZ - 1) / CHATLOG_CHUNK_SZ;
+    cj.cj_ahead = chatlog_jobs_num * CHATLOG_CHUNK_AHEAD;
+
+    cj.cj_chunk = calloc(cj.cj_num, sizeof(struct chatlog_chunk));
+    cw = calloc(chatlog_jobs_num, sizeof(struct chatlog_worker));
+    if ((cj.cj_chunk == NULL) || (cw == NULL))
+    {
+        free(cj.cj_chunk);
+        free(cw);
+        chatlog_readmap(map, map_len, 0, UINT64_MAX);
+        return;
+    }
+
+    /* Split the chatlog at the first new-line after each CHATLOG_CHUNK_SZ bytes */
+    pend = map + map_len;
+    pstart = map;
+
+    for (idx = 0; (idx < cj.cj_num) && (pstart < pend); idx++)
+    {
+        cc = &cj.cj_chunk[idx];
+
+        cc->cc_start = pstart;
+        cc->cc_end = pend;
+
+        if ((size_t)(pend - pstart) > CHATLOG_CHUNK_SZ)
+        {
+            peol = util_memchr(pstart + CHATLOG_CHUNK_SZ, '\n', pend - pstart - CHATLOG_CHUNK_SZ);
+            if (peol != NULL) cc->cc_end = peol + 1;
+        }
+
+        pstart = cc->cc_end;
+    }
+
+    cj.cj_num = idx;
+
+    pthread_mutex_init(&cj.cj_lock, NULL);
+    pthread_cond_init(&cj.cj_cond, NULL);
+
+    for (nworkers = 0; nworkers < chatlog_jobs_num; nworkers++)
+    {
+        cw[nworkers].cw_jobs = &cj;
+
+        if (!re_clone(&cw[nworkers].cw_rs, chatlog_rs))
+        {
+            break;
+        }
+
+        /* Match with all languages, see chatlog_chunk_parse() */
+        cw[nworkers].cw_rs.rs_lang = 0;
+
+        if (pthread_create(&cw[nworkers].cw_thread, NULL, chatlog_worker_main, &cw[nworkers]) != 0)
+        {
+            con_printf("CHATLOG: Unable to create a replay thread\n");
+            re_clone_free(&cw[nworkers].cw_rs);
+            break;
+        }
+    }
+
+    con_printf("CHATLOG: Parsing %llu chunks with %u threads\n", (unsigned long long)cj.cj_num, nworkers);
+
+    if (nworkers == 0)
+    {
+        chatlog_readmap(map, map_len, 0, UINT64_MAX);
+    }
+
+    for (idx = 0; (idx < cj.cj_num) && (nworkers > 0); idx++)
+    {
+        cc = &cj.cj_chunk[idx];
+
+        pthread_mutex_lock(&cj.cj_lock);
+        while (!cc->cc_done)
+        {
+            pthread_cond_wait(&cj.cj_cond, &cj.cj_lock);
+        }
+        pthread_mutex_unlock(&cj.cj_lock);
+
+        chatlog_chunk_process(cc);
+
+        pthread_mutex_lock(&cj.cj_lock);
+        cj.cj_done++;
+        pthread_cond_broadcast(&cj.cj_cond);
+        pthread_mutex_unlock(&cj.cj_lock);
+    }
+
+    for (ii = 0; ii < nworkers; ii++)
+    {
+        pthread_join(cw[ii].cw_thread, NULL);
+        re_clone_free(&cw[ii].cw_rs);
+    }
+
+    pthread_cond_destroy(&cj.cj_cond);
+    pthread_mutex_destroy(&cj.cj_lock);
+
+    free(cj.cj_chunk);
+    free(cw);
+}
+
+/**
+ * Set the number of threads used to replay a chatlog
+ *
+ * With more than one thread, lines are matched in parallel and the events are
+ * processed in order, see chatlog_readmap_jobs(). This is used only when the
+ * whole chatlog is replayed.
+ *
+ * @param[in]       jobs        Number of threads, 1 replays the chatlog in this thread
+ */
+void chatlog_replay_jobs(unsigned jobs)
+{
+    if (jobs < 1) jobs = 1;
+    if (jobs > CHATLOG_JOBS_MAX) jobs = CHATLOG_JOBS_MAX;
+
+    chatlog_jobs_num = jobs;
+}
+
+/**
+ * Replay the lines of the chatlog @p file from a time range
+ *
+ * The time index of the chatlog is updated and used to seek to the start
+ * of the range.
+ *
+ * @param[in]       file        File to read chatlog from
+ * @param[in]       tm_start    Start of the range
+ * @param[in]       tm_end      End of the range
+ * @param[in]       tm_span     If not 0, the range is the last @p tm_span
+ *                              seconds of the chatlog and @p tm_start is ignored
+ *
+ * @retval          true        On success
+ * @retval          false       If the file could not be mapped or indexed
+ */
+bool chatlog_readfile_time(char *file, uint64_t tm_start, uint64_t tm_end, uint64_t tm_span)
+{
+    struct chatlog_idx ci;
+    uint64_t offset;
+    size_t map_len;
+    char *map;
+
+    /* The time index needs random access to the lines */
+    if (chatlog_is_gzip(file))
+    {
+        con_printf("CHATLOG: Time ranges are not supported on compressed chatlogs: %s\n", file);
+        return false;
+    }
+
+    map = sys_mmap(file, &map_len);
+    if (map == NULL)
+    {
+        con_printf("CHATLOG: Unable to map %s\n", file);
+        return false;
+    }
+
+    if (!chatlog_idx_open(&ci, file, map, map_len))
+    {
+        sys_munmap(map, map_len);
+        return false;
+    }
+
+    if (tm_span != 0)
+    {
+        tm_start = (ci.ci_last > tm_span) ? ci.ci_last - tm_span : 0;
+    }
+
+    offset = chatlog_idx_seek(&ci, tm_start);
+
+    con_printf("CHATLOG: Replaying %s from offset %llu\n", file, (unsigned long long)offset);
+
+    chatlog_readmap(map + offset, map_len - offset, tm_start, tm_end);
+
+    chatlog_idx_free(&ci);
+    sys_munmap(map, map_len);
+
+    return true;
+}
+
+/**
+ * Replay the lines of the chatlog @p file with a timestamp between
+ * @p tm_start and @p tm_end, see chatlog_time_parse()
+ *
+ * @param[in]       file        File to read chatlog from
+ * @param[in]       tm_start    Start of the range
+ * @param[in]       tm_end      End of the range
+ *
+ * @retval          true        On success
+ * @retval          false       If the file could not be mapped or indexed
+ */
+bool chatlog_readfile_range(char *file, uint64_t tm_start, uint64_t tm_end)
+{
+    return chatlog_readfile_time(file, tm_start, tm_end, 0);
+}
+
+/**
+ * Replay the last @p tm_span seconds of the chatlog @p file
+ *
+ * @param[in]       file        File to read chatlog from
+ * @param[in]       tm_span     Length of the range in seconds
+ *
+ * @retval          true        On success
+ * @retval          false       If the file could not be mapped or indexed
+ */
+bool chatlog_readfile_last(char *file, uint64_t tm_span)
+{
+    return chatlog_readfile_time(file, 0, UINT64_MAX, tm_span);
+}
+
+/**
+ * Check if @p file starts with the gzip magic bytes
+ */
+bool chatlog_is_gzip(char *file)
+{
+    char magic[sizeof(CHATLOG_GZ_MAGIC) - 1];
+    FILE *f;
+    bool retval;
+
+    f = fopen(file, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+
+    retval = (fread(magic, 1, sizeof(magic), f) == sizeof(magic)) &&
+             (memcmp(magic, CHATLOG_GZ_MAGIC, sizeof(magic)) == 0);
+
+    fclose(f);
+
+    return retval;
+}
+
+/**
+ * Replay the gzipped chatlog @p file
+ *
+ * The file is decompressed in CHATLOG_READ_SZ blocks directly into the read
+ * buffer and the lines are processed with chatlog_read(), like a plain file;
+ * nothing is decompressed to disk.
+ *
+ * @param[in]       file        Compressed chatlog
+ *
+ * @retval          true        On success
+ * @retval          false       If the file could not be read or decompressed,
+ *                              or APme was built without zlib
+ */
+bool chatlog_readgz(char *file)
+{
+#ifdef CHATLOG_ZLIB
+    bool retval;
+    gzFile gz;
+
+    gz = gzopen(file, "rb");
+    if (gz == NULL)
+    {
+        con_printf("CHATLOG: Error reading file %s\n", file);
+        return false;
+    }
+
+    gzbuffer(gz, CHATLOG_GZ_BUF_SZ);
+
+    con_printf("CHATLOG: Replaying compressed %s\n", file);
+
+    chatlog_reader_reset(chatlog_replay, 0);
+    chatlog_replay->cr_gz = gz;
+
+    retval = chatlog_read(chatlog_replay, NULL, true, NULL);
+
+    chatlog_replay->cr_gz = NULL;
+    gzclose(gz);
+
+    return retval;
+#else
+    con_printf("CHATLOG: %s is compressed, APme was built without zlib\n", file);
+    return false;
+#endif
+}
+
+/**
+ * This reads the file <I>file</I> as if it was a chatlog
+ *
+ * This is used for debugging and for replaying archived chatlogs. The file is
+ * memory mapped if possible, otherwise it's read in blocks. Gzipped chatlogs
+ * are decompressed while they're read, see chatlog_readgz().
+ *
+ * @param[in]       file        File to read chastlog from
+ *
+ * @retval          true        On success
+ * @retval          false       If there was an error processing the file
+ *                              or could not be found
+ */
+bool chatlog_readfile(char *file)
+{
+    FILE *chatfile;
+    size_t map_len;
+    char *map;
+    bool retval;
+
+    if (chatlog_is_gzip(file))
+    {
+        return chatlog_readgz(file);
+    }
+
+    map = sys_mmap(file, &map_len);
+    if (map != NULL)
+    {
+        con_printf("CHATLOG: Replaying %s, %llu bytes mapped\n", file, (unsigned long long)map_len);
+
+        chatlog_readmap_jobs(map, map_len);
+        sys_munmap(map, map_len);
+
+        return true;
+    }
+
+    chatfile = fopen(file, "rb");
+    if (chatfile == NULL)
+    {
+        con_printf("CHATLOG: Error reading file %s\n", file);
+        return false;
+    }
+
+    setvbuf(chatfile, NULL, _IONBF, 0);
+
+    chatlog_reader_reset(chatlog_replay, 0);
+
+    retval = chatlog_read(chatlog_replay, chatfile, true, NULL);
+
+    fclose(chatfile);
+
+    return retval;
+}
+
 /**
  * @}
  */
@@ -31,6 +31,19 @@
 
 extern bool chatlog_init(void);
 extern bool chatlog_poll(void);
+extern void chatlog_periodic(void);
+extern bool chatlog_periodic_timeout(uint64_t *timeout);
+#ifdef SYS_UNIX
+extern int  chatlog_poll_fd(void);
+#endif
+extern bool chatlog_reader_stats(char *buf, size_t buf_sz);
+extern bool chatlog_path(char *path, size_t path_sz);
 extern bool chatlog_readfile(char *file);
+extern bool chatlog_readfile_range(char *file, uint64_t tm_start, uint64_t tm_end);
+extern bool chatlog_readfile_last(char *file, uint64_t tm_span);
+extern void chatlog_replay_jobs(unsigned jobs);
+extern bool chatlog_session_init(void);
+extern void chatlog_session_free(void);
+extern bool chatlog_lang_set(char *lang);
 
 #endif
@@ -0,0 +1,532 @@
+/*
+ * chatlog_idx.c - APme: Aion Automatic Abyss Point Tracker
+ *
+ * Copyright (C) 2012 Mitja Horvat <pinkfluid@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/**
+ * @file
+ * Aion chatlog time index
+ *
+ * @author Mitja Horvat <pinkfluid@gmail.com>
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+#include "console.h"
+#include "chatlog_idx.h"
+
+/**
+ * @defgroup chatlog_idx Chatlog Time Index
+ *
+ * @brief Maps the time of chatlog lines to file offsets
+ *
+ * Every chatlog line starts with a "YYYY.MM.DD HH:MM:SS" timestamp. The index
+ * has an entry for the first line of every CHATLOG_IDX_BUCKET seconds long
+ * time bucket, so a replay of a time range can seek close to its start
+ * instead of reading the chatlog from the beginning.
+ *
+ * The index is stored as a text file next to the chatlog, with the
+ * CHATLOG_IDX_EXT extension. It records how much of the chatlog was indexed,
+ * so when the chatlog grows only the new lines are scanned. If the chatlog
+ * is shorter than the indexed length, the last entry doesn't match the
+ * chatlog anymore or the indexed length doesn't agree with the entries,
+ * the index is rebuilt.
+ *
+ * The index of the live chatlog is loaded with chatlog_idx_load(), extended
+ * with chatlog_idx_append() as the lines are parsed, and stored with
+ * chatlog_idx_save().
+ *
+ * The chatlog is expected to be in chronological order; lines that go back
+ * in time don't create new entries.
+ *
+ * @{
+ */
+
+/** Index file format version */
+#define CHATLOG_IDX_VERSION     1
+
+static bool chatlog_idx_path(char *path, size_t path_sz, char *file);
+static bool chatlog_idx_add(struct chatlog_idx *ci, uint64_t tm, uint64_t offset);
+static bool chatlog_idx_tail_valid(struct chatlog_idx *ci, const char *map, uint64_t len, uint64_t last);
+static bool chatlog_idx_update(struct chatlog_idx *ci, const char *map, size_t map_len);
+
+/**
+ * Parse the chatlog timestamp at the start of @p str
+ *
+ * The timestamp has a fixed format, "YYYY.MM.DD HH:MM:SS", so it's parsed
+ * directly, without strptime() and without time zone conversions.
+ *
+ * @param[in]       str         Chatlog line
+ * @param[in]       str_len     Length of @p str
+ * @param[out]      tm          Seconds since 1970.01.01 00:00:00, in the
+ *                              time zone of the chatlog
+ *
+ * @retval          true        On success
+ * @retval          false       If @p str doesn't start with a valid timestamp
+ */
+bool chatlog_time_parse(const char *str, size_t str_len, uint64_t *tm)
+{
+    static const char fmt[CHATLOG_TIME_LEN + 1] = "0000.00.00 00:00:00";
+    uint32_t year, month, day;
+    uint32_t era, yoe, doy;
+    uint64_t days;
+    uint32_t num[6];
+    size_t ii;
+    int nnum;
+
+    if (str_len < CHATLOG_TIME_LEN)
+    {
+        return false;
+    }
+
+    /* Check the format and collect the numbers */
+    nnum = 0;
+    num[0] = 0;
+    for (ii = 0; ii < CHATLOG_TIME_LEN; ii++)
+    {
+        if (fmt[ii] == '0')
+        {
+            if ((str[ii] < '0') || (str[ii] > '9')) return false;
+
+            num[nnum] = num[nnum] * 10 + (str[ii] - '0');
+            continue;
+        }
+
+        if (str[ii] != fmt[ii]) return false;
+
+        num[++nnum] = 0;
+    }
+
+    year = num[0];
+    month = num[1];
+    day = num[2];
+
+    if ((year < 1970) || (month < 1) || (month > 12) || (day < 1) || (day > 31) ||
+        (num[3] > 23) || (num[4] > 59) || (num[5] > 60))
+    {
+        return false;
+    }
+
+    /* Days since the epoch, March based years move the leap day to the end */
+    if (month <= 2) year--;
+
+    era = year / 400;
+    yoe = year - era * 400;
+    doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    days = (uint64_t)era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+
+    *tm = days * 86400 + num[3] * 3600 + num[4] * 60 + num[5];
+
+    return true;
+}
+
+/**
+ * Get the path of the index file of the chatlog @p file
+ */
+bool chatlog_idx_path(char *path, size_t path_sz, char *file)
+{
+    if (util_strlcpy(path, file, path_sz) >= path_sz) return false;
+    if (util_strlcat(path, CHATLOG_IDX_EXT, path_sz) >= path_sz) return false;
+
+    return true;
+}
+
+/**
+ * Append an entry to the index @p ci
+ */
+bool chatlog_idx_add(struct chatlog_idx *ci, uint64_t tm, uint64_t offset)
+{
+    struct chatlog_idx_entry *entry;
+    size_t max;
+
+    if (ci->ci_num >= ci->ci_max)
+    {
+        max = (ci->ci_max == 0) ? 256 : ci->ci_max * 2;
+
+        entry = realloc(ci->ci_entry, max * sizeof(*entry));
+        if (entry == NULL)
+        {
+            con_printf("IDX: Out of memory\n");
+            return false;
+        }
+
+        ci->ci_entry = entry;
+        ci->ci_max = max;
+    }
+
+    ci->ci_entry[ci->ci_num].cie_time = tm;
+    ci->ci_entry[ci->ci_num].cie_offset = offset;
+    ci->ci_num++;
+
+    return true;
+}
+
+/**
+ * Check that the indexed length @p len and the newest timestamp @p last agree with
+ * the entries of @p ci
+ *
+ * The indexed part must end with a complete line, and no line after the last entry
+ * may start a new time bucket, otherwise it would have an entry too.
+ *
+ * @retval          true        If the header matches the entries
+ * @retval          false       If the index is inconsistent, for example truncated
+ */
+bool chatlog_idx_tail_valid(struct chatlog_idx *ci, const char *map, uint64_t len, uint64_t last)
+{
+    struct chatlog_idx_entry *entry = NULL;
+    const char *pline;
+    const char *peol;
+    const char *pend;
+    uint64_t tm;
+
+    if ((len > 0) && (map[len - 1] != '\n'))
+    {
+        return false;
+    }
+
+    pline = map;
+    pend = map + len;
+
+    if (ci->ci_num > 0)
+    {
+        entry = &ci->ci_entry[ci->ci_num - 1];
+        pline = map + entry->cie_offset;
+    }
+
+    for (; pline < pend; pline = peol + 1)
+    {
+        peol = util_memchr(pline, '\n', pend - pline);
+        if (peol == NULL) return false;
+
+        if (!chatlog_time_parse(pline, peol - pline, &tm)) continue;
+
+        if ((tm > last) ||
+            (entry == NULL) ||
+            ((tm / CHATLOG_IDX_BUCKET) > (entry->cie_time / CHATLOG_IDX_BUCKET)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Load the index of the chatlog @p file and validate it against the mapped chatlog
+ *
+ * Unlike chatlog_idx_open(), the lines after the indexed length are not indexed.
+ *
+ * @param[in,out]   ci          Index, it must be zeroed; free it with chatlog_idx_free()
+ * @param[in]       file        Path of the chatlog
+ * @param[in]       map         The chatlog mapped with sys_mmap()
+ * @param[in]       map_len     Length of @p map
+ *
+ * @retval          true        If the index was loaded and is valid
+ * @retval          false       If there's no index or it must be rebuilt
+ */
+bool chatlog_idx_load(struct chatlog_idx *ci, char *file, const char *map, size_t map_len)
+{
+    unsigned long long len, last, tm, offset;
+    char path[UTIL_MAX_PATH];
+    unsigned version, bucket;
+    struct chatlog_idx_entry *entry;
+    uint64_t line_tm;
+    bool retval;
+    FILE *fidx;
+
+    if (!chatlog_idx_path(path, sizeof(path), file))
+    {
+        return false;
+    }
+
+    fidx = fopen(path, "r");
+    if (fidx == NULL)
+    {
+        return false;
+    }
+
+    retval = false;
+
+    if ((fscanf(fidx, "APME-IDX %u %u %llu %llu", &version, &bucket, &len, &last) != 4) ||
+        (version != CHATLOG_IDX_VERSION) ||
+        (bucket != CHATLOG_IDX_BUCKET) ||
+        (len > map_len))
+    {
+        goto exit;
+    }
+
+    while (fscanf(fidx, "%llu %llu", &tm, &offset) == 2)
+    {
+        if ((offset >= len) ||
+            ((ci->ci_num > 0) && (offset <= ci->ci_entry[ci->ci_num - 1].cie_offset)))
+        {
+            goto exit;
+        }
+
+        if (!chatlog_idx_add(ci, tm, offset)) goto exit;
+    }
+
+    /* The chatlog was replaced if the last entry doesn't point to a line with the same time */
+    if (ci->ci_num > 0)
+    {
+        entry = &ci->ci_entry[ci->ci_num - 1];
+
+        if (!chatlog_time_parse(map + entry->cie_offset, map_len - entry->cie_offset, &line_tm) ||
+            (line_tm != entry->cie_time))
+        {
+            goto exit;
+        }
+    }
+
+    if (!chatlog_idx_tail_valid(ci, map, len, last))
+    {
+        goto exit;
+    }
+
+    ci->ci_len = len;
+    ci->ci_last = last;
+
+    retval = true;
+
+exit:
+    fclose(fidx);
+
+    if (!retval)
+    {
+        con_printf("IDX: Ignoring the invalid index %s\n", path);
+        ci->ci_num = 0;
+    }
+
+    return retval;
+}
+
+/**
+ * Store the index of the chatlog @p file
+ *
+ * The index is written to a temporary file first, which then replaces the old
+ * one; a crash never leaves a truncated index. Failing to store the index is
+ * not fatal, it's just rebuilt the next time.
+ */
+void chatlog_idx_save(struct chatlog_idx *ci, char *file)
+{
+    char path[UTIL_MAX_PATH];
+    char tmp[UTIL_MAX_PATH];
+    FILE *fidx;
+    bool retval;
+    size_t ii;
+
+    if (!chatlog_idx_path(path, sizeof(path), file))
+    {
+        return;
+    }
+
+    util_strlcpy(tmp, path, sizeof(tmp));
+    util_strlcat(tmp, ".tmp", sizeof(tmp));
+
+    fidx = fopen(tmp, "w");
+    if (fidx == NULL)
+    {
+        con_printf("IDX: Unable to save the index %s\n", tmp);
+        return;
+    }
+
+    retval = fprintf(fidx, "APME-IDX %u %u %llu %llu\n",
+                     CHATLOG_IDX_VERSION,
+                     CHATLOG_IDX_BUCKET,
+                     (unsigned long long)ci->ci_len,
+                     (unsigned long long)ci->ci_last) > 0;
+
+    for (ii = 0; retval && (ii < ci->ci_num); ii++)
+    {
+        retval = fprintf(fidx, "%llu %llu\n",
+                         (unsigned long long)ci->ci_entry[ii].cie_time,
+                         (unsigned long long)ci->ci_entry[ii].cie_offset) > 0;
+    }
+
+    retval = (fclose(fidx) == 0) && retval;
+
+    if (!retval || !sys_rename(tmp, path))
+    {
+        con_printf("IDX: Unable to save the index %s\n", path);
+        remove(tmp);
+    }
+}
+
+/**
+ * Index the complete chatlog line @p line that starts at the file offset @p offset
+ *
+ * Lines before ci_len were already indexed and are ignored, so the lines of the
+ * live chatlog can be passed as they are parsed.
+ *
+ * @param[in,out]   ci          Index
+ * @param[in]       line        Chatlog line, without the new-line
+ * @param[in]       line_len    Length of @p line
+ * @param[in]       offset      File offset of @p line
+ *
+ * @retval          true        On success
+ * @retval          false       On memory allocation errors
+ */
+bool chatlog_idx_append(struct chatlog_idx *ci, const char *line, size_t line_len, uint64_t offset)
+{
+    uint64_t tm;
+
+    if (offset < ci->ci_len)
+    {
+        return true;
+    }
+
+    if (chatlog_time_parse(line, line_len, &tm))
+    {
+        if ((ci->ci_num == 0) ||
+            ((tm / CHATLOG_IDX_BUCKET) > (ci->ci_entry[ci->ci_num - 1].cie_time / CHATLOG_IDX_BUCKET)))
+        {
+            if (!chatlog_idx_add(ci, tm, offset)) return false;
+        }
+
+        if (tm > ci->ci_last) ci->ci_last = tm;
+    }
+
+    ci->ci_len = offset + line_len + 1;
+
+    return true;
+}
+
+/**
+ * Index the lines of the mapped chatlog after ci_len
+ *
+ * Only complete lines are indexed, an incomplete last line is indexed
+ * the next time.
+ */
+bool chatlog_idx_update(struct chatlog_idx *ci, const char *map, size_t map_len)
+{
+    const char *pline;
+    const char *peol;
+    const char *pend;
+
+    pend = map + map_len;
+
+    for (pline = map + ci->ci_len; pline < pend; pline = peol + 1)
+    {
+        peol = util_memchr(pline, '\n', pend - pline);
+        if (peol == NULL) break;
+
+        if (!chatlog_idx_append(ci, pline, peol - pline, pline - map)) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Open the time index of the chatlog @p file, update and save it if it's
+ * not up to date
+ *
+ * @param[out]      ci          Index, free it with chatlog_idx_free()
+ * @param[in]       file        Path of the chatlog
+ * @param[in]       map         The chatlog mapped with sys_mmap()
+ * @param[in]       map_len     Length of @p map
+ *
+ * @retval          true        On success
+ * @retval          false       On memory allocation errors
+ */
+bool chatlog_idx_open(struct chatlog_idx *ci, char *file, const char *map, size_t map_len)
+{
+    uint64_t len;
+
+    memset(ci, 0, sizeof(*ci));
+
+    if (!chatlog_idx_load(ci, file, map, map_len))
+    {
+        ci->ci_len = 0;
+        ci->ci_last = 0;
+    }
+
+    len = ci->ci_len;
+
+    if (!chatlog_idx_update(ci, map, map_len))
+    {
+        chatlog_idx_free(ci);
+        return false;
+    }
+
+    if (ci->ci_len != len)
+    {
+        con_printf("IDX: Indexed %llu new bytes of %s, %llu entries\n",
+                   (unsigned long long)(ci->ci_len - len),
+                   file,
+                   (unsigned long long)ci->ci_num);
+
+        chatlog_idx_save(ci, file);
+    }
+
+    return true;
+}
+
+/**
+ * Find the offset where to start reading to get all lines newer than @p tm
+ *
+ * @param[in]       ci          Index
+ * @param[in]       tm          Time, as returned by chatlog_time_parse()
+ *
+ * @return
+ * Offset of the first line of the time bucket that contains @p tm; lines
+ * before this offset are all older than @p tm
+ */
+uint64_t chatlog_idx_seek(struct chatlog_idx *ci, uint64_t tm)
+{
+    size_t lo;
+    size_t hi;
+    size_t mid;
+
+    /* Find the last entry with cie_time <= tm */
+    lo = 0;
+    hi = ci->ci_num;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+
+        if (ci->ci_entry[mid].cie_time <= tm)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return (lo > 0) ? ci->ci_entry[lo - 1].cie_offset : 0;
+}
+
+/**
+ * Release the memory used by the index @p ci
+ */
+void chatlog_idx_free(struct chatlog_idx *ci)
+{
+    free(ci->ci_entry);
+
+    memset(ci, 0, sizeof(*ci));
+}
+
+/**
+ * @}
+ */
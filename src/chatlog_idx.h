@@ -0,0 +1,72 @@
+/*
+ * chatlog_idx.h - APme: Aion Automatic Abyss Point Tracker
+ *
+ * Copyright (C) 2012 Mitja Horvat <pinkfluid@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef CHATLOG_IDX_H_INCLUDED
+#define CHATLOG_IDX_H_INCLUDED
+
+/**
+ * @addtogroup chatlog_idx
+ * @{
+ *
+ * @file chatlog_idx.h Chatlog time index
+ * @author Mitja Horvat <pinkfluid@gmail.com>
+ */
+
+/** Length of the chatlog timestamp, "YYYY.MM.DD HH:MM:SS" */
+#define CHATLOG_TIME_LEN        19
+/** Time span covered by an index entry, in seconds */
+#define CHATLOG_IDX_BUCKET      600
+/** Extension of the index file, it's stored next to the chatlog */
+#define CHATLOG_IDX_EXT         ".idx"
+
+/**
+ * An index entry, the first line of a time bucket
+ */
+struct chatlog_idx_entry
+{
+    uint64_t    cie_time;       /**< Timestamp of the line      */
+    uint64_t    cie_offset;     /**< File offset of the line    */
+};
+
+/**
+ * Time index of a chatlog
+ */
+struct chatlog_idx
+{
+    uint64_t                    ci_len;         /**< Length of the chatlog that was indexed     */
+    uint64_t                    ci_last;        /**< Newest timestamp in the chatlog            */
+    size_t                      ci_num;         /**< Number of entries                          */
+    size_t                      ci_max;         /**< Allocated entries                          */
+    struct chatlog_idx_entry   *ci_entry;       /**< Entries, sorted by time and offset         */
+};
+
+extern bool     chatlog_time_parse(const char *str, size_t str_len, uint64_t *tm);
+extern bool     chatlog_idx_open(struct chatlog_idx *ci, char *file, const char *map, size_t map_len);
+extern bool     chatlog_idx_load(struct chatlog_idx *ci, char *file, const char *map, size_t map_len);
+extern bool     chatlog_idx_append(struct chatlog_idx *ci, const char *line, size_t line_len, uint64_t offset);
+extern void     chatlog_idx_save(struct chatlog_idx *ci, char *file);
+extern uint64_t chatlog_idx_seek(struct chatlog_idx *ci, uint64_t tm);
+extern void     chatlog_idx_free(struct chatlog_idx *ci);
+
+/**
+ * @}
+ */
+
+#endif /* CHATLOG_IDX_H_INCLUDED */
@@ -0,0 +1,514 @@
+/*
+ * chatlog_re.c - APme: Aion Automatic Abyss Point Tracker
+ *
+ * Copyright (C) 2012 Mitja Horvat <pinkfluid@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/**
+ * @file
+ * Aion chatlog regex patterns
+ *
+ * The pattern table lives in its own file, so it can be shared with the
+ * scanner generator, see regeng_gen.c.
+ *
+ * @author Mitja Horvat <pinkfluid@gmail.com>
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "regeng.h"
+#include "chatlog_re.h"
+
+/**
+ * @addtogroup chatlog
+ * @{
+ */
+
+/**
+ * Define chatlog regex patterns and corresponding event.
+ *
+ * This list is scanned from beginning to end. If a regular expressions matches,
+ * an event is generated. The regeng combines all patterns into a single regex,
+ * but the first matching entry still wins.
+ *
+ * The regeng tries the most commonly matched regular expressions first and adapts
+ * this order as the log is parsed, so the order here only matters for patterns
+ * that may match the same line (for example RE_CHAT_GENERAL and RE_CHAT_WHISPER).
+ *
+ * @see regeng
+ *
+ * @showinitializer
+ */
+struct regeng re_aion[] =
+{
+#if 0
+    /* The following patterns are not used  */
+    {
+        .re_id  = RE_DAMAGE_INFLICT,
+        .re_exp = "^: " RE_NAME " inflicted ([0-9.]+) damage on ([A-Za-z ]+) by using ([A-Za-z ]+)\\.",
+    },
+    {
+        .re_id  = RE_DAMAGE_CRITICAL,
+        .re_exp = "^: Critical Hit! You inflicted ([0-9.]+) critical damage on ([A-Za-z ]+)\\.",
+    },
+    /* XXX Chat self is not reliable, disabling for the moment. */
+    {
+        .re_id  = RE_CHAT_SELF,
+        .re_exp = "^: " RE_NAME ": (.*)$",
+    },
+#endif
+
+    /* Item looted by the player */
+    {
+        .re_id  = RE_ITEM_LOOT_SELF,
+        .re_exp = "^: You have acquired " RE_ITEM,
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ITEM_LOOT_SELF,
+        .re_exp = "^: Vous avez gagné " RE_ITEM,
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ITEM_LOOT_SELF,
+        .re_exp = "^: Ihr habt " RE_ITEM " erhalten\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Item lootd by another player */
+    {
+        .re_id  = RE_ITEM_LOOT_PLAYER,
+        .re_exp = "^: " RE_NAME " has acquired " RE_ITEM,
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ITEM_LOOT_PLAYER,
+        .re_exp = "^: " RE_NAME " a gagné " RE_ITEM,
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ITEM_LOOT_PLAYER,
+        .re_exp = "^: " RE_NAME " hat " RE_ITEM " erhalten\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The player joined a group */
+    {
+        .re_id  = RE_GROUP_SELF_JOIN,
+        .re_exp = "^: You have joined the group\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_SELF_JOIN,
+        .re_exp = "^: Vous avez rejoint le groupe\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_GROUP_SELF_JOIN,
+        .re_exp = "^: Ihr seid der Gruppe beigetreten\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The player has left the group */
+    {
+        .re_id  = RE_GROUP_SELF_LEAVE,
+        .re_exp = "^: You left the group\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_SELF_LEAVE,
+        .re_exp = "^: Vous avez quitté le groupe\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_GROUP_SELF_LEAVE,
+        .re_exp = "^: Ihr habt die Gruppe verlassen\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The player has been kicked */
+    {
+        .re_id  = RE_GROUP_SELF_KICK,
+        .re_exp = "^: You have been kicked out of the group\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_SELF_KICK,
+        .re_exp = "^: Vous avez été exclue du groupe\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_GROUP_SELF_KICK,
+        .re_exp = "^: Ihr wurdet aus der Gruppe geworfen\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Another player has joined the group */
+    {
+        .re_id  = RE_GROUP_PLAYER_JOIN,
+        .re_exp = "^: " RE_NAME " has joined your group\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_PLAYER_JOIN,
+        .re_exp = "^: " RE_NAME " a rejoint votre groupe\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_GROUP_PLAYER_JOIN,
+        .re_exp = "^: " RE_NAME " ist Eurer Gruppe beigetreten.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Another player has left the gruop */
+    {
+        .re_id  = RE_GROUP_PLAYER_LEAVE,
+        .re_exp = "^: " RE_NAME " has left your group\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_PLAYER_LEAVE,
+        .re_exp = "^: " RE_NAME " a quitté votre groupe\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_GROUP_PLAYER_LEAVE,
+        .re_exp = "^: " RE_NAME " hat Eure Gruppe verlassen\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Another player has been disconnected */
+    {
+        .re_id  = RE_GROUP_PLAYER_DISCONNECT,
+        .re_exp = "^: " RE_NAME " has been disconnected\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_PLAYER_DISCONNECT,
+        .re_exp = "^: " RE_NAME " a quitté Atréia.\\.",
+        .re_lang = RE_LANG_FR,
+    },
+
+    /* A player has ben kicked from the group */
+    {
+        .re_id  = RE_GROUP_PLAYER_KICK,
+        .re_exp = "^: " RE_NAME " has been kicked out of your group\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_PLAYER_KICK,
+        .re_exp = "^: " RE_NAME " a été exclue de votre groupe\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_GROUP_PLAYER_KICK,
+        .re_exp = "^: " RE_NAME " wurde aus Eurer Gruppe geworfen\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Another player has been offlie for too long */
+    {
+        .re_id  = RE_GROUP_PLAYER_OFFLINE,
+        .re_exp = "^: " RE_NAME " has been offline for too long and is automatically excluded from the group\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_PLAYER_OFFLINE,
+        .re_exp = "^: " RE_NAME " est déconnecté depuis trop longtemps et a été automatiquement exclu du groupe\\.",
+        .re_lang = RE_LANG_FR,
+    },
+
+    /* The group has been disbanded */
+    {
+        .re_id  = RE_GROUP_DISBAND,
+        .re_exp = "^: The group has been disbanded\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_GROUP_DISBAND,
+        .re_exp = "^: Le groupe a été dissous.\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_GROUP_DISBAND,
+        .re_exp = "^: Die Gruppe wurde aufgelöst\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The player joined an alliance */
+    {
+        .re_id  = RE_ALI_SELF_JOIN,
+        .re_exp = "^: You have joined the alliance\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ALI_SELF_JOIN,
+        .re_exp = "^: Vous avez rejoint la cohorte\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ALI_SELF_JOIN,
+        .re_exp = "^: Ihr seid der Allianz beigetreten\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The player left the alliance */
+    {
+        .re_id  = RE_ALI_SELF_LEAVE,
+        .re_exp = "^: You have left the alliance\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ALI_SELF_LEAVE,
+        .re_exp = "^: Vous avez quitté la cohorte\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ALI_SELF_LEAVE,
+        .re_exp = "^: Ihr habt die Allianz verlassen\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The player has been kicked from the alliance */
+    {
+        .re_id  = RE_ALI_SELF_KICK,
+        .re_exp = "^: You have been kicked out of the alliance\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ALI_SELF_KICK,
+        .re_exp = "^: Vous avez été expulsée de la cohorte\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ALI_SELF_KICK,
+        .re_exp = "^: Ihr wurdet aus der Allianz geworfen\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Another player joined the alliance */
+    {
+        .re_id  = RE_ALI_PLAYER_JOIN,
+        .re_exp = "^: " RE_NAME " has joined the alliance\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ALI_PLAYER_JOIN,
+        .re_exp = "^: " RE_NAME " a rejoint la cohorte\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ALI_PLAYER_JOIN,
+        .re_exp = "^: " RE_NAME " ist der Allianz beigetreten\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Another player has left the alliance */
+    {
+        .re_id  = RE_ALI_PLAYER_LEAVE,
+        .re_exp = "^: " RE_NAME " has left the alliance\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ALI_PLAYER_LEAVE,
+        .re_exp = "^: " RE_NAME " a quitté la cohorte\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ALI_PLAYER_LEAVE,
+        .re_exp = "^: " RE_NAME " hat die Allianz verlassen\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* A player has been kicked from the alliance */
+    {
+        .re_id  = RE_ALI_PLAYER_KICK,
+        .re_exp = "^: " RE_NAME " has been kicked out of the alliance\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ALI_PLAYER_KICK,
+        .re_exp = "^: " RE_NAME " a été expulsé de la cohorte\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ALI_PLAYER_KICK,
+        .re_exp = "^: " RE_NAME " wurde aus der Allianz geworfen\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* A player has been offline for too long and has been kicked out of the alliance */
+    {
+        .re_id  = RE_ALI_PLAYER_OFFLINE,
+        .re_exp = "^: " RE_NAME " has been offline for too long and had been automatically kicked out of the alliance\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ALI_PLAYER_OFFLINE,
+        .re_exp = "^: " RE_NAME " a passé trop de temps hors connexion. Expulsion automatique de la Cohorte\\.",
+        .re_lang = RE_LANG_FR,
+    },
+
+    /* The alliance has been disbanded */
+    {
+        .re_id  = RE_ALI_DISBAND,
+        .re_exp = "^: The alliance has been disbanded\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ALI_DISBAND,
+        .re_exp = "^: La cohorte a été dissoute\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ALI_DISBAND,
+        .re_exp = "^: Die Allianz wurde aufgelöst\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* General chat -- this seems to be the same in French, German and English */
+    {
+        .re_id  = RE_CHAT_GENERAL,
+        .re_exp = "^: \\[charname:" RE_NAME ";.*\\]: (.*)$",
+    },
+
+    /* Whisper */
+    {
+        .re_id  = RE_CHAT_WHISPER,
+        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] Whispers: (.*)$",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_CHAT_WHISPER,
+        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] murmure : (.*)$",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_CHAT_WHISPER,
+        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] flüstert: (.*)$",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Shouts */
+    {
+        .re_id  = RE_CHAT_SHOUT,
+        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] Shouts: (.*)$",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_CHAT_SHOUT,
+        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] crie : (.*)$",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_CHAT_SHOUT,
+        .re_exp = "^: \\[charname:" RE_NAME ";.*\\] ruft: (.*)$",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The player rolled for an item */
+    {
+        .re_id  = RE_ROLL_ITEM_SELF,
+        .re_exp = "^: You rolled the dice and got " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ROLL_ITEM_SELF,
+        .re_exp = "^: Vous avez lancé les dés et obtenu " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ROLL_ITEM_SELF,
+        .re_exp = "^: Ihr habt eine " RE_NUM_ROLL " gewürfelt \\(max\\. " RE_NUM_ROLL "\\)\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* Another player rolled for an item */
+    {
+        .re_id  = RE_ROLL_ITEM_PLAYER,
+        .re_exp = "^: " RE_NAME " rolled the dice and got " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ROLL_ITEM_PLAYER,
+        .re_exp = "^: " RE_NAME " a lancé les dés et a obtenu " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ROLL_ITEM_PLAYER,
+        .re_exp = "^: " RE_NAME " hat eine " RE_NUM_ROLL " gewürfelt \\(max\\. " RE_NUM_ROLL "\\)\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The or another player passed on an item */
+    {
+        .re_id  = RE_ROLL_ITEM_PASS,
+        .re_exp = "^: " RE_NAME " gave up rolling the dice",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ROLL_ITEM_PASS,
+        .re_exp = "^: " RE_NAME " a renoncé à lancer les dés",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ROLL_ITEM_PASS,
+        .re_exp = "^: " RE_NAME " hat aufgehört zu würfeln\\.",
+        .re_lang = RE_LANG_DE,
+    },
+
+
+    /* Somebody rolled the highest */
+    {
+        .re_id  = RE_ROLL_ITEM_HIGHEST,
+        .re_exp = "^: " RE_NAME " rolled the highest",
+        .re_lang = RE_LANG_EN,
+    },
+    {
+        .re_id  = RE_ROLL_ITEM_HIGHEST,
+        .re_exp = "^: " RE_NAME " a obtenu le meilleur score",
+        .re_lang = RE_LANG_FR,
+    },
+    {
+        .re_id  = RE_ROLL_ITEM_HIGHEST,
+        .re_exp = "^: " RE_NAME " hat den höchsten Wert gewürfelt",
+        .re_lang = RE_LANG_DE,
+    },
+
+    /* The two events below do not have a French equivalent, unfortunately */
+    {
+        /* The onlly difference between this and RE_ROLL_ITEM_SELF is in the "got a" vs "got" text */
+        .re_id  = RE_ROLL_DICE_SELF,
+        .re_exp = "^: You rolled the dice and got a " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
+        .re_lang = RE_LANG_EN,
+
+    },
+    {
+        /* The onlly difference between this and RE_ROLL_ITEM_PLAYER is in the "got a" vs "got" text */
+        .re_id  = RE_ROLL_DICE_PLAYER,
+        .re_exp = "^: " RE_NAME " rolled the dice and got a " RE_NUM_ROLL " \\(max\\. " RE_NUM_ROLL "\\)\\.",
+        .re_lang = RE_LANG_EN,
+    },
+
+    RE_REGENG_END
+};
+
+/**
+ * @}
+ */
@@ -0,0 +1,88 @@
+/*
+ * chatlog_re.h - APme: Aion Automatic Abyss Point Tracker
+ *
+ * Copyright (C) 2012 Mitja Horvat <pinkfluid@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef CHATLOG_RE_H_INCLUDED
+#define CHATLOG_RE_H_INCLUDED
+
+/**
+ * @addtogroup chatlog
+ * @{
+ *
+ * @file chatlog_re.h Chatlog regex patterns
+ * @author Mitja Horvat <pinkfluid@gmail.com>
+ */
+
+/** Character name regex pattern            */
+#define RE_NAME     "([[:alnum:]]+)"
+/** Item number regex pattern               */
+#define RE_ITEM     "\\[item:([[:digit:]]+).*\\]"
+/** Item link regex pattern                 */
+#define RE_NUM_ROLL "[0-9\\.]+"
+
+#define RE_LANG_EN                  0x01        /**< English client, see @ref regeng        */
+#define RE_LANG_FR                  0x02        /**< French client                          */
+#define RE_LANG_DE                  0x04        /**< German client                          */
+#define RE_LANG_NUM                 3           /**< Number of RE_LANG_ values              */
+
+#define RE_ITEM_LOOT_SELF           100         /**< Event, item looted by player           */
+#define RE_ITEM_LOOT_PLAYER         101         /**< Event, item looted by a character      */
+
+#define RE_DAMAGE_INFLICT           200         /**< Damage was inflicted                   */
+#define RE_DAMAGE_CRITICAL          201         /**< Damage was inflicted and was critical  */
+
+#define RE_GROUP_SELF_JOIN          300         /**< The player joined a group              */
+#define RE_GROUP_SELF_LEAVE         301         /**< The player left the group              */
+#define RE_GROUP_SELF_KICK          302         /**< The player has been kicked             */
+#define RE_GROUP_PLAYER_JOIN        303         /**< Some other player joined the group     */
+#define RE_GROUP_PLAYER_LEAVE       304         /**< Some other player left the group       */
+#define RE_GROUP_PLAYER_DISCONNECT  305         /**< Some player was disconnected           */
+#define RE_GROUP_PLAYER_KICK        306         /**< A player was kicked from the group     */
+#define RE_GROUP_PLAYER_OFFLINE     307         /**< A player in the group went offline     */
+#define RE_GROUP_DISBAND            308         /**< The group was disbanded                */
+
+#define RE_ALI_SELF_JOIN            350         /**< The player joined a group              */
+#define RE_ALI_SELF_LEAVE           351         /**< The player left the group              */
+#define RE_ALI_SELF_KICK            352         /**< The player has been kicked from the ali*/
+#define RE_ALI_PLAYER_JOIN          353         /**< Some other player joined the group     */
+#define RE_ALI_PLAYER_LEAVE         354         /**< Some other player left the group       */
+#define RE_ALI_PLAYER_DISCONNECT    355         /**< Some player was disconnected           */
+#define RE_ALI_PLAYER_KICK          356         /**< A player was kicked from the group     */
+#define RE_ALI_PLAYER_OFFLINE       357         /**< A player in the group went offline     */
+#define RE_ALI_DISBAND              358         /**< The group was disbanded                */
+
+#define RE_CHAT_SELF                400         /**< Chat from the player itself            */
+#define RE_CHAT_GENERAL             401         /**< General chat                           */
+#define RE_CHAT_WHISPER             402         /**< A whisper was received                 */
+#define RE_CHAT_SHOUT               403         /**< Somebody shouteed something            */
+
+#define RE_ROLL_ITEM_SELF           500         /**< The player rolled on an item           */
+#define RE_ROLL_ITEM_PLAYER         501         /**< Some other player rolled on an item    */
+#define RE_ROLL_ITEM_PASS           502         /**< The player passed on an item           */
+#define RE_ROLL_ITEM_HIGHEST        503         /**< Somebody rolled the highest            */
+#define RE_ROLL_DICE_SELF           504         /**< The player used /roll to roll a dice   */
+#define RE_ROLL_DICE_PLAYER         505         /**< Group member used /roll to roll a dice */
+
+extern struct regeng re_aion[];
+extern re_scan_t re_aion_scan;
+
+/**
+ * @}
+ */
+#endif /* CHATLOG_RE_H_INCLUDED */
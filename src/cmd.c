@@ -101,6 +101,9 @@ static cmd_func_t cmd_func_apcalc;          /**< Declaration of cmd_func_apcalc(
 static cmd_func_t cmd_func_inv;             /**< Declaration of cmd_func_inv()          */
 static cmd_func_t cmd_func_dbgdump;         /**< Declaration of cmd_func_dbgdump()      */
 static cmd_func_t cmd_func_dbgparse;        /**< Declaration of cmd_func_dbgparse()     */
+static cmd_func_t cmd_func_restats;         /**< Declaration of cmd_func_restats()      */
+static cmd_func_t cmd_func_rdstats;         /**< Declaration of cmd_func_rdstats()      */
+static cmd_func_t cmd_func_plstats;         /**< Declaration of cmd_func_plstats()      */
 
 /**
  * Chat command declaration structure
@@ -202,6 +205,18 @@ struct cmd_entry cmd_list[] =
     {
         .cmd_command    = "dbgparse",
         .cmd_func       = cmd_func_dbgparse,
+    },
+    {
+        .cmd_command    = "restats",
+        .cmd_func       = cmd_func_restats,
+    },
+    {
+        .cmd_command    = "rdstats",
+        .cmd_func       = cmd_func_rdstats,
+    },
+    {
+        .cmd_command    = "plstats",
+        .cmd_func       = cmd_func_plstats,
     }
 };
 
@@ -517,7 +532,7 @@ bool cmd_func_group_add(int argc, char *argv[], char *txt)
 
     for (ii = 1; ii < argc; ii++)
     {
-        aion_group_join(argv[ii]);
+        aion_group_join(argv[ii], strlen(argv[ii]));
     }
 
     cmd_retval_set(CMD_RETVAL_OK);
@@ -544,7 +559,7 @@ bool cmd_func_group_del(int argc, char *argv[], char *txt)
 
     for (ii = 1; ii < argc; ii++)
     {
-        aion_group_leave(argv[ii]);
+        aion_group_leave(argv[ii], strlen(argv[ii]));
     }
 
     cmd_retval_set(CMD_RETVAL_OK);
@@ -570,7 +585,7 @@ bool cmd_func_group_leave(int argc, char *argv[], char *txt)
     (void)argv;
     (void)txt;
 
-    aion_group_leave(AION_NAME_DEFAULT);
+    aion_group_leave(AION_NAME_DEFAULT, strlen(AION_NAME_DEFAULT));
 
     cmd_retval_set(CMD_RETVAL_OK);
 
@@ -935,7 +950,8 @@ bool cmd_func_inv(int argc, char *argv[], char *txt)
 }
 
 /**
- * Implements the ?dbgdump function, which dumps the console to stdout
+ * Implements the ?dbgdump function, which dumps the console and the regex
+ * statistics to stdout
  *
  * This is a bit awkward to use so maybe somebody can improve this.
  *
@@ -953,6 +969,7 @@ bool cmd_func_dbgdump(int argc, char *argv[], char *txt)
     (void)txt;
 
     con_dump();
+    re_stats_dump();
 
     cmd_retval_set(CMD_RETVAL_OK);
 
@@ -993,6 +1010,112 @@ bool cmd_func_dbgparse(int argc, char *argv[], char *txt)
     return true;
 }
 
+/**
+ * Implements the ?restats command, which shows the regular expression statistics
+ *
+ * A summary is returned to the chat, the per-expression statistics are dumped
+ * to stdout.
+ *
+ * @param[in]       argc        Number of arguments
+ * @param[in]       argv        Command arguments
+ *                                  - argv[0] = Command name
+ *                                  - argv[1] = Optional "reset" to clear the statistics, or
+ *                                              "on"/"off" to start/stop measuring the time
+ * @param[in]       txt         Full chat line text with the command stripped
+ *
+ * @retval          true        On success
+ * @retval          false       If no statistics are available
+ */
+bool cmd_func_restats(int argc, char *argv[], char *txt)
+{
+    char stats[CMD_TEXT_SZ];
+
+    (void)txt;
+
+    if ((argc >= 2) && (strcasecmp(argv[1], "reset") == 0))
+    {
+        re_stats_reset();
+        cmd_retval_set(CMD_RETVAL_OK);
+        return true;
+    }
+
+    if ((argc >= 2) && ((strcasecmp(argv[1], "on") == 0) || (strcasecmp(argv[1], "off") == 0)))
+    {
+        re_stats_timing_set(strcasecmp(argv[1], "on") == 0);
+        cmd_retval_set(CMD_RETVAL_OK);
+        return true;
+    }
+
+    if (!re_stats_summary(stats, sizeof(stats)))
+    {
+        return false;
+    }
+
+    re_stats_dump();
+
+    cmd_retval_set(stats);
+
+    return true;
+}
+
+/**
+ * Implements the ?rdstats command, which shows the statistics of the chatlog reader thread
+ *
+ * @param[in]       argc        Number of arguments
+ * @param[in]       argv        Command arguments
+ *                                  - argv[0] = Command name
+ * @param[in]       txt         Full chat line text with the command stripped
+ *
+ * @retval          true        On success
+ * @retval          false       If the reader thread is not running
+ */
+bool cmd_func_rdstats(int argc, char *argv[], char *txt)
+{
+    char stats[CMD_TEXT_SZ];
+
+    (void)argc;
+    (void)argv;
+    (void)txt;
+
+    if (!chatlog_reader_stats(stats, sizeof(stats)))
+    {
+        return false;
+    }
+
+    cmd_retval_set(stats);
+
+    return true;
+}
+
+/**
+ * Implements the ?plstats command, which shows the statistics of the player cache
+ *
+ * @param[in]       argc        Number of arguments
+ * @param[in]       argv        Command arguments
+ *                                  - argv[0] = Command name
+ * @param[in]       txt         Full chat line text with the command stripped
+ *
+ * @retval          true        On success
+ * @retval          false       On error
+ */
+bool cmd_func_plstats(int argc, char *argv[], char *txt)
+{
+    char stats[CMD_TEXT_SZ];
+
+    (void)argc;
+    (void)argv;
+    (void)txt;
+
+    if (!aion_players_stats(stats, sizeof(stats)))
+    {
+        return false;
+    }
+
+    cmd_retval_set(stats);
+
+    return true;
+}
+
 /**
  * This functions scans the command arguments (argc,argv) and returns true if 
  * it contains a chatlog history command in the format of [N]^+NAME
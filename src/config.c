@@ -181,7 +181,7 @@ void cfg_periodic(void)
         return;
     }
 
-    if ((sys_monotime() - cfg_timestamp) < 1000) return;
+    if ((sys_monotime() - cfg_timestamp) < CFG_SAVE_DELAY) return;
 
     con_printf("CFG: Periodic is saving configuration, last timestamp %llu.\n", cfg_timestamp);
 
@@ -194,6 +194,32 @@ void cfg_periodic(void)
     cfg_timestamp = 0;
 }
 
+/**
+ * Return the time left until cfg_periodic() saves the configuration.
+ *
+ * This can be used to schedule the call to cfg_periodic() instead of polling it.
+ *
+ * @param[out]      timeout     Time left in miliseconds, 0 if the save is due
+ *
+ * @retval          true        If the configuration is dirty
+ * @retval          false       If there's nothing to save
+ */
+bool cfg_periodic_timeout(uint64_t *timeout)
+{
+    uint64_t elapsed;
+
+    if (cfg_timestamp == 0)
+    {
+        return false;
+    }
+
+    elapsed = sys_monotime() - cfg_timestamp;
+
+    *timeout = (elapsed < CFG_SAVE_DELAY) ? CFG_SAVE_DELAY - elapsed : 0;
+
+    return true;
+}
+
 /**
  * Set a the configuration parameter @p name in section @p section
  * to the value @p value
@@ -40,6 +40,9 @@
 /** Maximum CFG key size (section + ':' + name) */
 #define CFG_KEYSZ   256
 
+/** Delay in miliseconds between marking the configuration dirty and saving it */
+#define CFG_SAVE_DELAY  1000
+
 extern bool cfg_init(void);
 extern bool cfg_load(void);
 extern bool cfg_store(void);
@@ -48,6 +51,7 @@ extern bool cfg_set_int(char *section, char *key, int value);
 extern bool cfg_get_string(char *section, char *name, char *value, size_t valuesz);
 
 extern void cfg_periodic(void);
+extern bool cfg_periodic_timeout(uint64_t *timeout);
 
 /**
  * @}
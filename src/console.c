@@ -26,10 +26,12 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "console.h"
 #include "txtbuf.h"
@@ -47,6 +49,7 @@
 static char con_buf[16384];         /**< Debugging console buffer, used for @p con_tb   */
 static char con_str[CON_STR_SZ];    /**< Console string                                 */
 static uint32_t con_str_rep;        /**< Number of times the last message was repeated  */
+static pthread_mutex_t con_lock = PTHREAD_MUTEX_INITIALIZER;    /**< con_printf() is used by the replay threads */
 
 struct txtbuf con_tb;               /**< Console textbuffer @see txtbuf                 */
 
@@ -80,9 +83,12 @@ void con_printf(char *fmt, ...)
     vsnprintf(curstr, sizeof(curstr), fmt, vargs);
     va_end(vargs);
 
+    pthread_mutex_lock(&con_lock);
+
     if (strcmp(curstr, con_str) == 0)
     {
         con_str_rep++;
+        pthread_mutex_unlock(&con_lock);
         return;
     }
 
@@ -104,6 +110,8 @@ void con_printf(char *fmt, ...)
     fputs(con_str, stdout);
 #endif
     tb_strput(&con_tb, con_str);
+
+    pthread_mutex_unlock(&con_lock);
 }
 
 /**
@@ -191,6 +191,21 @@ struct help_entry help_commands[] =
         "?hello",
         "Display the version number"
     },
+    {
+        "restats",
+        "?restats or ?restats on/off/reset",
+        "Display the chatlog parsing statistics, the per-pattern statistics are written to the debugging console output. Use ON/OFF to start/stop measuring the time spent parsing, RESET to clear them."
+    },
+    {
+        "rdstats",
+        "?rdstats",
+        "Display the chatlog reader statistics: lines and batches parsed, the most lines waiting to be parsed, how often and how long the reader waited for the parser and the number of skipped long lines."
+    },
+    {
+        "plstats",
+        "?plstats",
+        "Display the player cache statistics: cached players, their memory and the number of players evicted. The limits are set with playercache and playercachekb in apme.ini."
+    },
 };
 
 
@@ -32,6 +32,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "console.h"
 #include "aion.h"
@@ -43,14 +44,81 @@
 #include "version.h"
 #include "term.h"
 #include "config.h"
+#include "chatlog_idx.h"
+
+#ifdef OS_LINUX
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#endif
 
 /**
  * @defgroup headless Headless Main
  * @brief This is the main module of the terminal (GUI-less) client
  *
+ * On Linux the main loop is event driven: the directory of the chatlog and the
+ * clipboard file are watched with inotify, and the configuration save is scheduled
+ * with a timerfd. Everything is multiplexed with epoll, so nothing runs while the
+ * game is idle. If the reactor cannot be set up, or on other systems, the
+ * application falls back to polling at 100Hz.
+ *
+ * With the -r option the chatlogs given on the command line are replayed
+ * without the interactive UI and the resulting AP values are printed. The -b
+ * option replays each chatlog in its own session, several at a time, and
+ * prints the AP and loot of each file and of all files together.
+ *
  * @{
  */ 
 
+/** Polling rate of the fallback main loop, in Hz */
+#define APME_POLL_HZ        100
+
+/** Command line usage */
+#define APME_USAGE          "Usage: %s [-r|-b [-s TIME] [-e TIME] [-l HOURS] [-j JOBS] CHATLOG...]\n" \
+                            "  -r           Replay the chatlogs and print the AP values\n" \
+                            "  -b           Replay each chatlog on its own and print the AP and loot\n" \
+                            "               per file and merged; CHATLOG may be a directory or a pattern\n" \
+                            "  -s, -e TIME  Replay only lines from/until TIME (inclusive), \"YYYY.MM.DD[ HH[:MM[:SS]]]\"\n" \
+                            "  -l HOURS     Replay only the last HOURS of each chatlog\n" \
+                            "  -j JOBS      Use JOBS threads, by default 1 with -r and one per CPU with -b\n"
+
+/**
+ * AP and loot of a player in a batch replay
+ */
+struct apme_batch_player
+{
+    char                        abp_name[AION_NAME_SZ]; /**< Player name                        */
+    uint32_t                    abp_apvalue;            /**< Accumulated AP                     */
+    uint32_t                    abp_loot;               /**< Looted items                       */
+    uint32_t                    abp_loot_ap;            /**< Looted AP items                    */
+};
+
+/**
+ * A chatlog of a batch replay and its summary
+ */
+struct apme_batch_file
+{
+    char                        *abf_path;              /**< Path of the chatlog                */
+    bool                        abf_ok;                 /**< Replayed successfully              */
+    uint64_t                    abf_time;               /**< Replay time in ms                  */
+    struct apme_batch_player    *abf_player;            /**< Players with AP or loot            */
+    size_t                      abf_nplayers;           /**< Number of elements in abf_player   */
+};
+
+/**
+ * State shared by the batch replay threads
+ */
+struct apme_batch
+{
+    pthread_mutex_t             ab_lock;                /**< Protects ab_next                   */
+    struct apme_batch_file      *ab_file;               /**< Chatlogs                           */
+    size_t                      ab_nfiles;              /**< Number of elements in ab_file      */
+    size_t                      ab_next;                /**< Next chatlog to replay             */
+    uint64_t                    ab_tm_start;            /**< See apme_replay_file()             */
+    uint64_t                    ab_tm_end;              /**< See apme_replay_file()             */
+    uint64_t                    ab_tm_span;             /**< See apme_replay_file()             */
+};
+
 static bool apme_prompt(char *prompt, char *answer);
 static void apme_chatlog_check(void);
 static void apme_screen_update(void);
@@ -59,6 +127,43 @@ static void apme_event_handler(enum event_type ev);
 static bool apme_init(int argc, char* argv[]);
 static void apme_cfg_apply(void);
 static void apme_periodic(void);
+static void apme_poll_loop(void);
+static void apme_replay_event(enum event_type ev);
+static bool apme_replay_init(void);
+static bool apme_replay_file(char *file, uint64_t tm_start, uint64_t tm_end, uint64_t tm_span);
+static bool apme_replay(int nfiles, char *files[], uint64_t tm_start, uint64_t tm_end, uint64_t tm_span);
+static bool apme_batch_collect(struct apme_batch_file *abf);
+static void *apme_batch_thread(void *arg);
+static int apme_batch_cmp(const void *a, const void *b);
+static void apme_batch_print(struct apme_batch_player *abp, size_t nplayers);
+static bool apme_batch_merge(struct apme_batch *ab);
+static void apme_batch_filter(char **files, size_t *nfiles);
+static bool apme_batch(int npatterns, char *patterns[], unsigned jobs, uint64_t tm_start, uint64_t tm_end, uint64_t tm_span);
+static bool apme_replay_time(char *arg, bool end, uint64_t *tm);
+static int apme_replay_args(int argc, char *argv[]);
+
+#ifdef OS_LINUX
+/** Size of the inotify event buffer, fits at least one event with a maximum length name */
+#define APME_INOTIFY_BUF_SZ (16 * (sizeof(struct inotify_event) + NAME_MAX + 1))
+/** Events to watch for in the chatlog/clipboard directories */
+#define APME_INOTIFY_MASK   (IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE)
+
+/**
+ * A file watched by the reactor
+ */
+struct apme_watch
+{
+    int         aw_wd;                  /**< inotify watch descriptor       */
+    char        aw_name[NAME_MAX + 1];  /**< File name inside the directory */
+    void        (*aw_func)(void);       /**< Called when the file changes   */
+    bool        aw_pending;             /**< Change seen, call aw_func      */
+};
+
+static bool apme_reactor_watch(int inotify_fd, struct apme_watch *aw, char *path, void (*func)(void));
+static bool apme_reactor_timer(int timer_fd);
+static bool apme_reactor(void);
+static void apme_chatlog_poll(void);
+#endif
 
 /**
  * Simple "prompt a question and wait for an answer" function
@@ -164,7 +269,7 @@ void apme_screen_update(void)
     for (aion_group_first(&iter); !aion_group_end(&iter); aion_group_next(&iter))
     {
         /* Paint ourselves green */
-        if (aion_player_is_self(iter.agi_name))
+        if (aion_player_is_self(iter.agi_name, strlen(iter.agi_name)))
         {
             term_setcolor(TERM_FG_GREEN);
         }
@@ -266,6 +371,9 @@ bool apme_init(int argc, char* argv[])
     /* First initialize the debug console */
     con_init();
 
+    /* Select the CPU specific string functions */
+    util_init();
+
     /* Initialize events early, elevation is requested with events! */
     event_register(apme_event_handler);
 
@@ -305,6 +413,8 @@ bool apme_init(int argc, char* argv[])
 void apme_cfg_apply(void)
 {
     char cfg[1024];
+    unsigned long players_max = AION_PLAYERS_MAX;
+    unsigned long players_max_kb = 0;
 
     if (cfg_get_string(CFG_SEC_APP, "name", cfg, sizeof(cfg)))
     {
@@ -317,6 +427,27 @@ void apme_cfg_apply(void)
         con_printf("MAIN: CFG apformat = %s\n", cfg);
         aion_aploot_fmt_set(cfg);
     }
+
+    if (cfg_get_string(CFG_SEC_APP, "lang", cfg, sizeof(cfg)))
+    {
+        con_printf("MAIN: CFG lang = %s\n", cfg);
+        chatlog_lang_set(cfg);
+    }
+
+    /* Limits of the player cache, the number of players and the memory in KB */
+    if (cfg_get_string(CFG_SEC_APP, "playercache", cfg, sizeof(cfg)))
+    {
+        con_printf("MAIN: CFG playercache = %s\n", cfg);
+        players_max = strtoul(cfg, NULL, 10);
+    }
+
+    if (cfg_get_string(CFG_SEC_APP, "playercachekb", cfg, sizeof(cfg)))
+    {
+        con_printf("MAIN: CFG playercachekb = %s\n", cfg);
+        players_max_kb = strtoul(cfg, NULL, 10);
+    }
+
+    aion_players_limit_set(players_max, players_max_kb * 1024);
 }
 
 /**
@@ -329,14 +460,873 @@ void apme_periodic(void)
 {
     cmd_poll();
     chatlog_poll();
+    chatlog_periodic();
     cfg_periodic();
 }
 
+/**
+ * The fallback main loop, calls apme_periodic() at APME_POLL_HZ
+ */
+void apme_poll_loop(void)
+{
+    con_printf("MAIN: Polling at %dHz\n", APME_POLL_HZ);
+
+    for (;;)
+    {
+        apme_periodic();
+        usleep(1000000 / APME_POLL_HZ);
+    }
+}
+
+#ifdef OS_LINUX
+/**
+ * chatlog_poll() wrapper with the signature of the reactor callbacks
+ */
+void apme_chatlog_poll(void)
+{
+    chatlog_poll();
+}
+
+/**
+ * Add an inotify watch for file @p path
+ *
+ * The directory of the file is watched instead of the file itself, so the
+ * file can be created, replaced or not exist at all yet. Watching the same
+ * directory twice returns the same watch descriptor, events are matched by
+ * name in apme_reactor().
+ *
+ * @param[in]       inotify_fd  inotify file descriptor
+ * @param[out]      aw          Watch structure to initialize
+ * @param[in]       path        Path of the file to watch
+ * @param[in]       func        Function to call when the file changes
+ *
+ * @retval          true        On success
+ * @retval          false       If the directory cannot be watched
+ */
+bool apme_reactor_watch(int inotify_fd, struct apme_watch *aw, char *path, void (*func)(void))
+{
+    char dir[UTIL_MAX_PATH];
+    char *name;
+
+    util_strlcpy(dir, path, sizeof(dir));
+
+    name = strrchr(dir, '/');
+    if (name == NULL)
+    {
+        util_strlcpy(aw->aw_name, dir, sizeof(aw->aw_name));
+        util_strlcpy(dir, ".", sizeof(dir));
+    }
+    else
+    {
+        util_strlcpy(aw->aw_name, name + 1, sizeof(aw->aw_name));
+        /* Keep the root directory */
+        name[name == dir ? 1 : 0] = '\0';
+    }
+
+    aw->aw_func = func;
+    aw->aw_pending = false;
+    aw->aw_wd = inotify_add_watch(inotify_fd, dir, APME_INOTIFY_MASK);
+    if (aw->aw_wd < 0)
+    {
+        con_printf("MAIN: Unable to watch directory %s: %s\n", dir, strerror(errno));
+        return false;
+    }
+
+    con_printf("MAIN: Watching %s in %s\n", aw->aw_name, dir);
+
+    return true;
+}
+
+/**
+ * Arm the timerfd @p timer_fd for the next configuration or chatlog checkpoint save
+ *
+ * The timer is disarmed if there's nothing to save.
+ *
+ * @param[in]       timer_fd    timerfd file descriptor
+ *
+ * @retval          true        On success
+ * @retval          false       If timerfd_settime() failed
+ */
+bool apme_reactor_timer(int timer_fd)
+{
+    struct itimerspec its;
+    uint64_t ckpt_timeout;
+    uint64_t timeout;
+    bool armed;
+
+    memset(&its, 0, sizeof(its));
+
+    armed = cfg_periodic_timeout(&timeout);
+
+    if (chatlog_periodic_timeout(&ckpt_timeout) && (!armed || (ckpt_timeout < timeout)))
+    {
+        timeout = ckpt_timeout;
+        armed = true;
+    }
+
+    if (armed)
+    {
+        /* A zero it_value disarms the timer, expire as soon as possible instead */
+        its.it_value.tv_sec = timeout / 1000;
+        its.it_value.tv_nsec = (timeout % 1000) * 1000000 + 1;
+    }
+
+    if (timerfd_settime(timer_fd, 0, &its, NULL) != 0)
+    {
+        con_printf("MAIN: Error arming the save timer: %s\n", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * The event driven main loop
+ *
+ * Sleeps in epoll_wait() until either the chatlog or clipboard file change,
+ * the chatlog reader thread has new lines or the configuration/checkpoint save
+ * timer expires.
+ *
+ * @retval          false       If the reactor cannot be set up or fails, the
+ *                              caller should fall back to apme_poll_loop()
+ */
+bool apme_reactor(void)
+{
+    char path[UTIL_MAX_PATH];
+    struct apme_watch watch[2];
+    struct epoll_event ev;
+    int inotify_fd = -1;
+    int timer_fd = -1;
+    int epoll_fd = -1;
+    size_t ii;
+
+    /* Align the buffer as required by struct inotify_event */
+    char inotify_buf[APME_INOTIFY_BUF_SZ] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    if (!chatlog_path(path, sizeof(path)))
+    {
+        return false;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || inotify_fd < 0 || timer_fd < 0)
+    {
+        con_printf("MAIN: Unable to create the reactor descriptors: %s\n", strerror(errno));
+        goto error;
+    }
+
+    if (!apme_reactor_watch(inotify_fd, &watch[0], path, apme_chatlog_poll) ||
+        !apme_reactor_watch(inotify_fd, &watch[1], UTIL_CLIPBOARD_FILE, cmd_poll))
+    {
+        goto error;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = inotify_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, inotify_fd, &ev) != 0)
+    {
+        goto error;
+    }
+
+    ev.data.fd = timer_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) != 0)
+    {
+        goto error;
+    }
+
+    /* The chatlog reader thread signals new lines through this descriptor */
+    ev.data.fd = chatlog_poll_fd();
+    if ((ev.data.fd >= 0) && (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev) != 0))
+    {
+        goto error;
+    }
+
+    con_printf("MAIN: Event driven main loop started\n");
+
+    /* Process whatever happened before the watches were added */
+    apme_periodic();
+
+    for (;;)
+    {
+        struct inotify_event *iev;
+        uint64_t expired;
+        ssize_t len;
+        char *pbuf;
+
+        if (!apme_reactor_timer(timer_fd))
+        {
+            goto error;
+        }
+
+        if (epoll_wait(epoll_fd, &ev, 1, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+
+            con_printf("MAIN: epoll_wait() failed: %s\n", strerror(errno));
+            goto error;
+        }
+
+        if (ev.data.fd == timer_fd)
+        {
+            if (read(timer_fd, &expired, sizeof(expired)) > 0)
+            {
+                cfg_periodic();
+                chatlog_periodic();
+            }
+            continue;
+        }
+
+        if (ev.data.fd == chatlog_poll_fd())
+        {
+            chatlog_poll();
+            continue;
+        }
+
+        /* Drain the inotify queue, flag changed files */
+        while ((len = read(inotify_fd, inotify_buf, sizeof(inotify_buf))) > 0)
+        {
+            for (pbuf = inotify_buf; pbuf < inotify_buf + len; pbuf += sizeof(*iev) + iev->len)
+            {
+                iev = (struct inotify_event *)pbuf;
+
+                for (ii = 0; ii < sizeof(watch) / sizeof(watch[0]); ii++)
+                {
+                    /* On overflow events were lost, check everything */
+                    if ((iev->mask & IN_Q_OVERFLOW) ||
+                        (iev->wd == watch[ii].aw_wd && iev->len > 0 && strcmp(iev->name, watch[ii].aw_name) == 0))
+                    {
+                        watch[ii].aw_pending = true;
+                    }
+                }
+            }
+        }
+
+        /* Call each handler once, regardless of the number of events */
+        for (ii = 0; ii < sizeof(watch) / sizeof(watch[0]); ii++)
+        {
+            if (!watch[ii].aw_pending) continue;
+
+            watch[ii].aw_pending = false;
+            watch[ii].aw_func();
+        }
+    }
+
+error:
+    con_printf("MAIN: Event driven main loop not available.\n");
+
+    if (epoll_fd >= 0) close(epoll_fd);
+    if (inotify_fd >= 0) close(inotify_fd);
+    if (timer_fd >= 0) close(timer_fd);
+
+    return false;
+}
+#endif
+
+/**
+ * Event handler used while replaying, the screen is not updated
+ */
+void apme_replay_event(enum event_type ev)
+{
+    (void)ev;
+}
+
+/**
+ * Initialize the subsystems needed to replay chatlogs
+ *
+ * The configuration is loaded, but never saved.
+ *
+ * @retval      true        On success
+ * @retval      false       On error
+ */
+bool apme_replay_init(void)
+{
+    con_init();
+    util_init();
+
+    event_register(apme_replay_event);
+
+    if (!aion_init() || !chatlog_init())
+    {
+        fprintf(stderr, "Error initializing APme.\n");
+        return false;
+    }
+
+    if (cfg_init())
+    {
+        apme_cfg_apply();
+    }
+
+    return true;
+}
+
+/**
+ * Replay a single chatlog, or a time range of it
+ *
+ * @param[in]   file        Chatlog
+ * @param[in]   tm_start    Replay lines from this time on, 0 for all
+ * @param[in]   tm_end      Replay lines until this time, UINT64_MAX for all
+ * @param[in]   tm_span     If not 0, replay only the last @p tm_span seconds of the file
+ *
+ * @retval      true        On success
+ * @retval      false       If the file could not be read
+ */
+bool apme_replay_file(char *file, uint64_t tm_start, uint64_t tm_end, uint64_t tm_span)
+{
+    if (tm_span != 0)
+    {
+        return chatlog_readfile_last(file, tm_span);
+    }
+
+    if ((tm_start != 0) || (tm_end != UINT64_MAX))
+    {
+        return chatlog_readfile_range(file, tm_start, tm_end);
+    }
+
+    return chatlog_readfile(file);
+}
+
+/**
+ * Replay archived chatlogs, without the interactive UI
+ *
+ * The files are parsed in order, as if they were a single chatlog, and the
+ * AP values of the group are printed at the end.
+ *
+ * If a time range is given, the time index of each chatlog is used to seek
+ * to the start of the range, see chatlog_readfile_range().
+ *
+ * @param[in]   nfiles      Number of files
+ * @param[in]   files       Chatlog files to replay
+ * @param[in]   tm_start    Replay lines from this time on, 0 for all
+ * @param[in]   tm_end      Replay lines until this time, UINT64_MAX for all
+ * @param[in]   tm_span     If not 0, replay only the last @p tm_span seconds of each file
+ *
+ * @retval      true        On success
+ * @retval      false       If initialization failed or a file could not be read
+ */
+bool apme_replay(int nfiles, char *files[], uint64_t tm_start, uint64_t tm_end, uint64_t tm_span)
+{
+    struct aion_group_iter iter;
+    uint64_t tstart;
+    bool retval;
+    int ii;
+
+    if (!apme_replay_init())
+    {
+        return false;
+    }
+
+    retval = true;
+
+    for (ii = 0; ii < nfiles; ii++)
+    {
+        tstart = sys_monotime();
+
+        if (!apme_replay_file(files[ii], tm_start, tm_end, tm_span))
+        {
+            fprintf(stderr, "Error replaying %s\n", files[ii]);
+            retval = false;
+            continue;
+        }
+
+        printf("Replayed %s in %llu ms\n", files[ii], (unsigned long long)(sys_monotime() - tstart));
+    }
+
+    printf("\n");
+    for (aion_group_first(&iter); !aion_group_end(&iter); aion_group_next(&iter))
+    {
+        printf(" * %-16s (AP: %d)%s\n", iter.agi_name, iter.agi_apvalue, iter.agi_invfull ? " -- FULL INVENTORY" : "");
+    }
+
+    return retval;
+}
+
+/**
+ * Store the players of the current session that have AP or loot in @p abf
+ *
+ * @param[in,out]   abf     Replayed chatlog
+ *
+ * @retval          true    On success
+ * @retval          false   On memory allocation error
+ */
+bool apme_batch_collect(struct apme_batch_file *abf)
+{
+    struct aion_group_iter iter;
+    struct apme_batch_player *abp;
+    size_t nplayers;
+
+    nplayers = 0;
+    for (aion_players_first(&iter); !aion_group_end(&iter); aion_group_next(&iter))
+    {
+        nplayers++;
+    }
+
+    abf->abf_player = calloc(nplayers, sizeof(struct apme_batch_player));
+    if (abf->abf_player == NULL)
+    {
+        return false;
+    }
+
+    for (aion_players_first(&iter); !aion_group_end(&iter); aion_group_next(&iter))
+    {
+        if ((iter.agi_apvalue == 0) && (iter.agi_loot == 0)) continue;
+
+        abp = &abf->abf_player[abf->abf_nplayers++];
+
+        util_strlcpy(abp->abp_name, iter.agi_name, sizeof(abp->abp_name));
+        abp->abp_apvalue = iter.agi_apvalue;
+        abp->abp_loot = iter.agi_loot;
+        abp->abp_loot_ap = iter.agi_loot_ap;
+    }
+
+    qsort(abf->abf_player, abf->abf_nplayers, sizeof(struct apme_batch_player), apme_batch_cmp);
+
+    return true;
+}
+
+/**
+ * Batch replay thread, replays chatlogs until there are none left
+ *
+ * Each chatlog is replayed in a new session, so the files don't affect each other.
+ *
+ * @param[in]   arg         The @ref apme_batch state
+ *
+ * @return
+ * Always NULL
+ */
+void *apme_batch_thread(void *arg)
+{
+    struct apme_batch *ab = arg;
+    struct apme_batch_file *abf;
+    uint64_t tstart;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&ab->ab_lock);
+        abf = (ab->ab_next < ab->ab_nfiles) ? &ab->ab_file[ab->ab_next++] : NULL;
+        pthread_mutex_unlock(&ab->ab_lock);
+
+        if (abf == NULL) break;
+
+        tstart = sys_monotime();
+
+        aion_session_init(false);
+
+        if (chatlog_session_init())
+        {
+            abf->abf_ok = apme_replay_file(abf->abf_path, ab->ab_tm_start, ab->ab_tm_end, ab->ab_tm_span) &&
+                          apme_batch_collect(abf);
+
+            chatlog_session_free();
+        }
+
+        aion_session_free();
+
+        abf->abf_time = sys_monotime() - tstart;
+    }
+
+    return NULL;
+}
+
+/**
+ * Compare the names of two players for qsort()
+ */
+int apme_batch_cmp(const void *a, const void *b)
+{
+    const struct apme_batch_player *pa = a;
+    const struct apme_batch_player *pb = b;
+
+    return strcasecmp(pa->abp_name, pb->abp_name);
+}
+
+/**
+ * Print the AP and loot of the players @p abp
+ *
+ * @param[in]   abp         Players
+ * @param[in]   nplayers    Number of elements in @p abp
+ */
+void apme_batch_print(struct apme_batch_player *abp, size_t nplayers)
+{
+    size_t ii;
+
+    for (ii = 0; ii < nplayers; ii++)
+    {
+        printf(" * %-16s (AP: %u, loot: %u, AP items: %u)\n",
+               abp[ii].abp_name, abp[ii].abp_apvalue, abp[ii].abp_loot, abp[ii].abp_loot_ap);
+    }
+}
+
+/**
+ * Print the AP and loot of the players of all chatlogs together
+ *
+ * Players are matched by name, ignoring case.
+ *
+ * @param[in]   ab          Batch replay state
+ *
+ * @retval      true        On success
+ * @retval      false       On memory allocation error
+ */
+bool apme_batch_merge(struct apme_batch *ab)
+{
+    struct apme_batch_player *merged;
+    size_t nmerged;
+    size_t nplayers;
+    size_t ii;
+    size_t jj;
+
+    nplayers = 0;
+    for (ii = 0; ii < ab->ab_nfiles; ii++)
+    {
+        nplayers += ab->ab_file[ii].abf_nplayers;
+    }
+
+    merged = malloc((nplayers + 1) * sizeof(struct apme_batch_player));
+    if (merged == NULL)
+    {
+        return false;
+    }
+
+    nplayers = 0;
+    for (ii = 0; ii < ab->ab_nfiles; ii++)
+    {
+        memcpy(&merged[nplayers], ab->ab_file[ii].abf_player, ab->ab_file[ii].abf_nplayers * sizeof(struct apme_batch_player));
+        nplayers += ab->ab_file[ii].abf_nplayers;
+    }
+
+    qsort(merged, nplayers, sizeof(struct apme_batch_player), apme_batch_cmp);
+
+    /* Sum up the adjacent entries of the same player */
+    nmerged = 0;
+    for (ii = 0; ii < nplayers; ii = jj)
+    {
+        merged[nmerged] = merged[ii];
+
+        for (jj = ii + 1; (jj < nplayers) && (apme_batch_cmp(&merged[ii], &merged[jj]) == 0); jj++)
+        {
+            merged[nmerged].abp_apvalue += merged[jj].abp_apvalue;
+            merged[nmerged].abp_loot += merged[jj].abp_loot;
+            merged[nmerged].abp_loot_ap += merged[jj].abp_loot_ap;
+        }
+
+        nmerged++;
+    }
+
+    apme_batch_print(merged, nmerged);
+
+    free(merged);
+
+    return true;
+}
+
+/**
+ * Replay many archived chatlogs, each in its own session
+ *
+ * Unlike apme_replay(), every chatlog starts with an empty group and the
+ * chatlogs are replayed by @p jobs threads at the same time. When all of them
+ * are done, the AP and loot of each chatlog are printed in order, followed by
+ * the totals of all chatlogs.
+ *
+ * @param[in]   npatterns   Number of patterns
+ * @param[in]   patterns    Chatlogs, directories or wildcard patterns, see sys_glob()
+ * @param[in]   jobs        Number of threads
+ * @param[in]   tm_start    Replay lines from this time on, 0 for all
+ * @param[in]   tm_end      Replay lines until this time, UINT64_MAX for all
+ * @param[in]   tm_span     If not 0, replay only the last @p tm_span seconds of each file
+ *
+ * @retval      true        On success
+ * @retval      false       If initialization failed or a file could not be read
+ */
+bool apme_batch(int npatterns, char *patterns[], unsigned jobs, uint64_t tm_start, uint64_t tm_end, uint64_t tm_span)
+{
+    struct apme_batch_file *abf;
+    struct apme_batch ab;
+    pthread_t *threads;
+    char **files[npatterns];
+    size_t nfiles[npatterns];
+    unsigned nthreads;
+    uint64_t tstart;
+    bool retval;
+    size_t jj;
+    int ii;
+
+    if (!apme_replay_init())
+    {
+        return false;
+    }
+
+    memset(&ab, 0, sizeof(ab));
+
+    retval = true;
+
+    for (ii = 0; ii < npatterns; ii++)
+    {
+        if (sys_glob(patterns[ii], &files[ii], &nfiles[ii]))
+        {
+            apme_batch_filter(files[ii], &nfiles[ii]);
+        }
+        else
+        {
+            files[ii] = NULL;
+            nfiles[ii] = 0;
+        }
+
+        if (nfiles[ii] == 0)
+        {
+            fprintf(stderr, "No chatlogs found: %s\n", patterns[ii]);
+            retval = false;
+        }
+
+        ab.ab_nfiles += nfiles[ii];
+    }
+
+    ab.ab_file = calloc(ab.ab_nfiles + 1, sizeof(struct apme_batch_file));
+    threads = calloc(jobs, sizeof(pthread_t));
+    if ((ab.ab_file == NULL) || (threads == NULL))
+    {
+        fprintf(stderr, "Out of memory.\n");
+        ab.ab_nfiles = 0;
+        retval = false;
+    }
+
+    ab.ab_nfiles = 0;
+    for (ii = 0; (ii < npatterns) && (ab.ab_file != NULL); ii++)
+    {
+        for (jj = 0; jj < nfiles[ii]; jj++)
+        {
+            ab.ab_file[ab.ab_nfiles++].abf_path = files[ii][jj];
+        }
+    }
+
+    /* The summary needs every player that had AP or loot, don't evict them */
+    aion_players_limit_set(0, 0);
+
+    ab.ab_tm_start = tm_start;
+    ab.ab_tm_end = tm_end;
+    ab.ab_tm_span = tm_span;
+
+    pthread_mutex_init(&ab.ab_lock, NULL);
+
+    tstart = sys_monotime();
+
+    for (nthreads = 0; (nthreads < jobs) && (nthreads < ab.ab_nfiles); nthreads++)
+    {
+        if (pthread_create(&threads[nthreads], NULL, apme_batch_thread, &ab) != 0)
+        {
+            break;
+        }
+    }
+
+    /* No threads at all, replay the chatlogs in this thread */
+    if (nthreads == 0)
+    {
+        apme_batch_thread(&ab);
+    }
+
+    while (nthreads > 0)
+    {
+        pthread_join(threads[--nthreads], NULL);
+    }
+
+    pthread_mutex_destroy(&ab.ab_lock);
+
+    for (jj = 0; jj < ab.ab_nfiles; jj++)
+    {
+        abf = &ab.ab_file[jj];
+
+        if (!abf->abf_ok)
+        {
+            fprintf(stderr, "Error replaying %s\n", abf->abf_path);
+            retval = false;
+            continue;
+        }
+
+        printf("%s (%llu ms)\n", abf->abf_path, (unsigned long long)abf->abf_time);
+        apme_batch_print(abf->abf_player, abf->abf_nplayers);
+    }
+
+    printf("\nAll %llu chatlogs (%llu ms)\n",
+           (unsigned long long)ab.ab_nfiles, (unsigned long long)(sys_monotime() - tstart));
+
+    if ((ab.ab_file != NULL) && !apme_batch_merge(&ab))
+    {
+        fprintf(stderr, "Out of memory.\n");
+        retval = false;
+    }
+
+    for (jj = 0; jj < ab.ab_nfiles; jj++)
+    {
+        free(ab.ab_file[jj].abf_player);
+    }
+
+    for (ii = 0; ii < npatterns; ii++)
+    {
+        sys_glob_free(files[ii], nfiles[ii]);
+    }
+
+    free(ab.ab_file);
+    free(threads);
+
+    return retval;
+}
+
+/**
+ * Remove the files that are not chatlogs from the list returned by sys_glob()
+ *
+ * A directory or a wildcard like "*" also lists the time indexes that are
+ * kept next to the chatlogs, and the temporary files they are written to;
+ * replaying them would only index the index.
+ *
+ * @param[in,out]   files       File list, the removed paths are freed
+ * @param[in,out]   nfiles      Number of elements in @p files
+ */
+void apme_batch_filter(char **files, size_t *nfiles)
+{
+    static const char *ext[] = { CHATLOG_IDX_EXT, CHATLOG_IDX_EXT ".tmp" };
+    size_t ext_len;
+    size_t len;
+    size_t ii;
+    size_t jj;
+    size_t nn;
+
+    for (ii = 0, nn = 0; ii < *nfiles; ii++)
+    {
+        len = strlen(files[ii]);
+
+        for (jj = 0; jj < sizeof(ext) / sizeof(ext[0]); jj++)
+        {
+            ext_len = strlen(ext[jj]);
+            if ((len >= ext_len) && (strcmp(files[ii] + len - ext_len, ext[jj]) == 0)) break;
+        }
+
+        if (jj < sizeof(ext) / sizeof(ext[0]))
+        {
+            free(files[ii]);
+            continue;
+        }
+
+        files[nn++] = files[ii];
+    }
+
+    *nfiles = nn;
+}
+
+/**
+ * Parse a time given on the command line
+ *
+ * The time has the chatlog format; the seconds, minutes or the whole time
+ * of the day can be left out. The missing fields are filled with the start
+ * of the unit for a start time and with its end for an end time, so
+ * "2012.05.01" is either 00:00:00 or 23:59:59 of that day.
+ *
+ * @param[in]   arg         Time string
+ * @param[in]   end         Fill the missing fields up to the end of the unit
+ * @param[out]  tm          Parsed time
+ *
+ * @retval      true        On success
+ * @retval      false       If @p arg is not a valid time
+ */
+bool apme_replay_time(char *arg, bool end, uint64_t *tm)
+{
+    char buf[CHATLOG_TIME_LEN + 1];
+    size_t len;
+
+    strcpy(buf, end ? "1970.01.01 23:59:59" : "1970.01.01 00:00:00");
+
+    /* Only whole fields: "YYYY.MM.DD", "YYYY.MM.DD HH", "YYYY.MM.DD HH:MM" or the full time */
+    len = strlen(arg);
+    if ((len < strlen("YYYY.MM.DD")) || (len > CHATLOG_TIME_LEN) || (((len - strlen("YYYY.MM.DD")) % 3) != 0))
+    {
+        return false;
+    }
+
+    memcpy(buf, arg, len);
+
+    return chatlog_time_parse(buf, CHATLOG_TIME_LEN, tm);
+}
+
+/**
+ * Parse the replay options and run apme_replay() or apme_batch()
+ *
+ * @param[in]   argc        Argument number (passed from main)
+ * @param[in]   argv        Argument array (passed from main), argv[1] is "-r" or "-b"
+ *
+ * @return
+ * 0 on success, any other number on error.
+ */
+int apme_replay_args(int argc, char *argv[])
+{
+    uint64_t tm_start = 0;
+    uint64_t tm_end = UINT64_MAX;
+    uint64_t tm_span = 0;
+    unsigned long jobs;
+    bool batch;
+    char *pend;
+    bool ok;
+    int argi;
+
+    batch = (strcmp(argv[1], "-b") == 0);
+    jobs = batch ? sys_ncpu() : 1;
+
+    for (argi = 2; ((argi + 1) < argc) && (argv[argi][0] == '-'); argi += 2)
+    {
+        if (strcmp(argv[argi], "-s") == 0)
+        {
+            ok = apme_replay_time(argv[argi + 1], false, &tm_start);
+        }
+        else if (strcmp(argv[argi], "-e") == 0)
+        {
+            ok = apme_replay_time(argv[argi + 1], true, &tm_end);
+        }
+        else if (strcmp(argv[argi], "-l") == 0)
+        {
+            tm_span = strtoull(argv[argi + 1], &pend, 10) * 3600;
+            ok = (*pend == '\0') && (tm_span > 0);
+        }
+        else if (strcmp(argv[argi], "-j") == 0)
+        {
+            jobs = strtoul(argv[argi + 1], &pend, 10);
+            ok = (*pend == '\0') && (jobs > 0);
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            fprintf(stderr, "Invalid option: %s %s\n", argv[argi], argv[argi + 1]);
+            argi = argc;
+            break;
+        }
+    }
+
+    if (argi >= argc)
+    {
+        fprintf(stderr, APME_USAGE, argv[0]);
+        return 1;
+    }
+
+    if (batch)
+    {
+        return apme_batch(argc - argi, argv + argi, jobs, tm_start, tm_end, tm_span) ? 0 : 1;
+    }
+
+    chatlog_replay_jobs(jobs);
+
+    return apme_replay(argc - argi, argv + argi, tm_start, tm_end, tm_span) ? 0 : 1;
+}
+
 /**
  * The terminal application main entry function
  *
- * @param[in]   argc        Argument number (passed from main) -- not used
- * @param[in]   argv        Argument array (passed from main) -- not used
+ * See APME_USAGE for the command line options. This is called by main() only
+ * in the terminal build (TERM_BUILD in config.mk); the wxWidgets application
+ * in wxmain.cc does not call it yet.
+ *
+ * @param[in]   argc        Argument number (passed from main)
+ * @param[in]   argv        Argument array (passed from main)
  *
  * @return
  * 0 on success, any other number on error.
@@ -347,6 +1337,12 @@ void apme_periodic(void)
 
 int old(int argc, char *argv[])
 {
+    /* Replay mode */
+    if ((argc >= 2) && ((strcmp(argv[1], "-r") == 0) || (strcmp(argv[1], "-b") == 0)))
+    {
+        return apme_replay_args(argc, argv);
+    }
+
     /* Initialize APme */
     if (!apme_init(argc, argv))
     {
@@ -357,12 +1353,10 @@ int old(int argc, char *argv[])
     apme_screen_update();
 
     /* Main processing loop */
-    for (;;)
-    {
-        apme_periodic();
-        /* Polling rate is 100hz */
-        usleep(1000000 / 100);
-    }
+#ifdef OS_LINUX
+    apme_reactor();
+#endif
+    apme_poll_loop();
 
 #ifdef SYS_WINDOWS
     /* On windows, pause before exiting */
@@ -377,6 +1371,16 @@ int old(int argc, char *argv[])
     return 0;
 }
 
+#ifdef APME_TERM
+/**
+ * Entry point of the terminal application, see old()
+ */
+int main(int argc, char *argv[])
+{
+    return old(argc, argv);
+}
+#endif
+
 /**
  * @}
  */ 
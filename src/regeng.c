@@ -28,13 +28,22 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include <assert.h>
 
-#include <pcreposix.h>
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+/** The prefilter has an SSSE3 version selected at run-time, see util_cpu_ssse3() */
+#define RE_PF_SIMD
+#include <immintrin.h>
+#endif
+
+#include <pcre.h>
 
 #include "regeng.h"
 #include "console.h"
+#include "util.h"
 
 /**
  * @defgroup regeng The Regular Expression Engine
@@ -45,11 +54,89 @@
  * there's no POSIX regex support in MinGW, it was necessary to use
  * an external regex library -- PCRE.
  *
+ * Chatlog lines go through the native PCRE API, so patterns can be
+ * studied and JIT compiled. Matched groups are passed to the callback as
+ * @ref re_capture views into the line, so nothing is copied until the
+ * callback decides to store it.
+ *
+ * Most chatlog lines (combat, skills, ...) do not match any expression. To keep
+ * these lines away from PCRE altogether, a literal prefilter is run first, see
+ * @ref regeng_set.
+ *
+ * Each expression keeps statistics about the number of executions, matches
+ * and the time spent in PCRE; see re_stats_summary() and re_stats_dump(). The
+ * time is measured only after re_stats_timing_set() enabled it, so the clock
+ * isn't read around every match otherwise.
+ *
  * @note This is the only module that heavily relies on 3rd party libraries.
  *
  * @{
  */
 
+/** Maximum number of atoms parsed from an expression by re_ovl_parse() */
+#define RE_OVL_ATOMS_MAX    128
+
+/** Check if @p c is an ASCII alphanumeric character */
+#define RE_OVL_ISALNUM(c)   ((((c) >= '0') && ((c) <= '9')) || (((c) >= 'a') && ((c) <= 'z')) || (((c) >= 'A') && ((c) <= 'Z')))
+
+/** Add the byte @p c to the 256-bit set @p set */
+#define RE_OVL_SET(set, c)  ((set)[(uint8_t)(c) >> 6] |= 1ULL << ((uint8_t)(c) & 63))
+
+/**
+ * A byte position of an expression, see re_ovl_parse()
+ */
+struct re_ovl_atom
+{
+    uint64_t    roa_set[4];     /**< Bytes accepted at this position            */
+    bool        roa_rep;        /**< The position may repeat, '*' or '+'        */
+    bool        roa_opt;        /**< The position may be skipped, '*' or '?'    */
+};
+
+/** List of initialized sets, used for statistics */
+static struct regeng_set *re_set_list = NULL;
+
+/** Serializes re_clone() and re_clone_free(), which update the original set */
+static pthread_mutex_t re_clone_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Measure the time spent matching, read by the parsing threads; see re_stats_timing_set() */
+static bool re_stats_timing = false;
+
+static bool re_has_backref(const char *exp);
+static bool re_compile(const char *exp, pcre **re, pcre_extra **extra, size_t *nsub);
+static int *re_ovec_alloc(size_t nsub, int *ovecsz);
+static void re_ovec_capture(struct re_capture *cap, const char *str, int *ovec, int ovec_ngrp);
+static bool re_comb_init(struct regeng_set *rs);
+static void re_parse_comb(re_callback_t re_callback, struct regeng_set *rs, char *str, int str_len);
+static const char *re_lit_skip_class(const char *pexp);
+static void re_lit_flush(char *cur, size_t *cur_len, char *best, size_t *best_len);
+static size_t re_lit_extract(const char *exp, char *lit, size_t lit_sz);
+static bool re_pf_init(struct regeng_set *rs);
+static void re_pf_verify(struct regeng_set *rs, const char *str, int str_len, int pos, uint8_t mask, size_t *ncand);
+static void re_pf_scan_scalar(struct regeng_set *rs, const char *str, int str_len, int pos, size_t *ncand);
+#ifdef RE_PF_SIMD
+static int re_pf_scan_ssse3(struct regeng_set *rs, const char *str, int str_len, size_t *ncand) __attribute__((target("ssse3")));
+#endif
+static size_t re_pf_scan(struct regeng_set *rs, const char *str, int str_len);
+static bool re_order_init(struct regeng_set *rs);
+static void re_order_update(struct regeng_set *rs);
+static bool re_ovl_class(const char **ppexp, uint64_t *set);
+static size_t re_ovl_parse(const char *exp, struct re_ovl_atom *atoms, size_t atoms_max);
+static bool re_ovl_check(const struct re_ovl_atom *a, size_t na, const struct re_ovl_atom *b, size_t nb);
+static void re_ovl_init(struct regeng_set *rs);
+static int re_exec(struct regeng *reptr, char *str, int str_len);
+static void re_match_callback(re_callback_t re_callback, struct regeng_set *rs, struct regeng *reptr, char *str, int str_len, int *ovec, int ngrp);
+static bool re_src_init(struct regeng_set *rs, struct regeng *reptr);
+static bool re_init_pcre(struct regeng_set *rs);
+static bool re_parse_scan(re_callback_t re_callback, struct regeng_set *rs, char *str, int str_len);
+static bool re_parse_line(re_callback_t re_callback, struct regeng_set *rs, char *str, int str_len);
+#ifdef RE_SCAN_CHECK
+static void re_scan_check(struct regeng_set *rs, char *str, int str_len, int *ovec, int ngrp, size_t idx);
+#endif
+static void re_parse_cand(re_callback_t re_callback, struct regeng_set *rs, char *str, int str_len, size_t ncand);
+static uint64_t re_nc_hash(const char *str, int str_len);
+static bool re_nc_lookup(struct regeng_set *rs, const char *str, int str_len);
+static void re_nc_insert(struct regeng_set *rs);
+
 /**
  * Extract a sub-string that was matched by the regular expression
  * in @p rem
@@ -114,68 +201,2332 @@ size_t re_strlen(regmatch_t rem)
 }
 
 /**
- * Initialize the regular expression engine 
+ * Check if the regular expression @p exp contains back-references
+ *
+ * Back-references use absolute group numbers, which are shifted when
+ * the expression is embedded in the combined regex.
+ *
+ * @param[in]       exp     Regular expression string
+ *
+ * @retval          true    If @p exp contains a back-reference
+ * @retval          false   Otherwise
+ */
+bool re_has_backref(const char *exp)
+{
+    const char *pexp;
+
+    for (pexp = exp; *pexp != '\0'; pexp++)
+    {
+        if (*pexp != '\\') continue;
+
+        /* Skip the escaped character */
+        pexp++;
+        if (*pexp == '\0') break;
+
+        if ((*pexp >= '1') && (*pexp <= '9')) return true;
+    }
+
+    return false;
+}
+
+/**
+ * Compile the regular expression @p exp with the native PCRE API and study it
+ *
+ * The pattern is JIT compiled if the PCRE library supports it, otherwise the
+ * study data is used with the interpreter.
+ *
+ * @param[in]       exp         Regular expression string
+ * @param[out]      re          Compiled regular expression
+ * @param[out]      extra       Study data, may be NULL if studying didn't produce anything useful
+ * @param[out]      nsub        Number of capture groups in @p exp
  *
- * Scan the regex array and compile the regular expressions in the @p re_exp field
+ * @retval          true        On success
+ * @retval          false       If @p exp failed to compile
+ */
+bool re_compile(const char *exp, pcre **re, pcre_extra **extra, size_t *nsub)
+{
+    const char *errstr;
+    int erroff;
+    int capcount;
+
+    *re = pcre_compile(exp, 0, &errstr, &erroff, NULL);
+    if (*re == NULL)
+    {
+        con_printf("Error parsing regex: %s (%s at offset %d)\n", exp, errstr, erroff);
+        return false;
+    }
+
+    *extra = pcre_study(*re, PCRE_STUDY_JIT_COMPILE, &errstr);
+    if (errstr != NULL)
+    {
+        /* Not fatal, the pattern can be still used without the study data */
+        con_printf("RE: Error studying regex: %s (%s)\n", exp, errstr);
+        *extra = NULL;
+    }
+
+    if (pcre_fullinfo(*re, *extra, PCRE_INFO_CAPTURECOUNT, &capcount) != 0)
+    {
+        con_printf("RE: Unable to retrieve the number of groups: %s\n", exp);
+        pcre_free_study(*extra);
+        pcre_free(*re);
+        return false;
+    }
+
+    *nsub = capcount;
+
+    return true;
+}
+
+/**
+ * Allocate a PCRE output vector for a pattern with @p nsub capture groups
  *
- * @param[in]       re_array        Array of regular expression structures
+ * @param[in]       nsub        Number of capture groups
+ * @param[out]      ovecsz      Number of elements in the output vector
  *
  * @return
- * true on success, or false if any of the regular expressions failed to
- * initialize.
+ * The output vector or NULL on error
+ */
+int *re_ovec_alloc(size_t nsub, int *ovecsz)
+{
+    /* PCRE needs 3 elements per group: start, end, and some scratch space */
+    *ovecsz = (nsub + 1) * 3;
+
+    return malloc(*ovecsz * sizeof(int));
+}
+
+/**
+ * Convert the PCRE output vector @p ovec to an array of capture views into @p str
+ *
+ * @param[out]      cap         Output array, all @ref RE_REMATCH_MAX elements are initialized
+ * @param[in]       str         String that was matched
+ * @param[in]       ovec        PCRE output vector
+ * @param[in]       ovec_ngrp   Number of valid start/end pairs in @p ovec
+ */
+void re_ovec_capture(struct re_capture *cap, const char *str, int *ovec, int ovec_ngrp)
+{
+    int ii;
+
+    for (ii = 0; ii < RE_REMATCH_MAX; ii++)
+    {
+        if ((ii < ovec_ngrp) && (ovec[ii * 2] >= 0) && (ovec[ii * 2 + 1] >= ovec[ii * 2]))
+        {
+            cap[ii].rc_str = str + ovec[ii * 2];
+            cap[ii].rc_len = ovec[ii * 2 + 1] - ovec[ii * 2];
+        }
+        else
+        {
+            cap[ii].rc_str = NULL;
+            cap[ii].rc_len = 0;
+        }
+    }
+}
+
+/**
+ * Build the combined regular expression for the set @p rs
+ *
+ * All expressions are joined into a single alternation, each wrapped in its own
+ * capture group. The index of the wrapping group is stored in @p re_comb_group,
+ * the expression's own groups follow it.
+ *
+ * Expressions that are not anchored with '^' are prefixed with a lazy ".*?" so
+ * they can still match anywhere in the string.
+ *
+ * @param[in,out]   rs      Regular expression set, the expressions must be compiled already
+ *
+ * @retval          true    On success
+ * @retval          false   If the expressions cannot be combined; this is not fatal,
+ *                          re_parse() falls back to matching one expression at a time
  */
-bool re_init(struct regeng *re_array)
+bool re_comb_init(struct regeng_set *rs)
 {
-    char errstr[64];
     struct regeng *reptr;
+    char *comb_exp;
+    size_t comb_sz;
+    size_t comb_nsub;
+    size_t group;
+    bool retval;
+
+    /* "^(?:" + ")" + '\0' */
+    comb_sz = 6;
+    group = 1;
+
+    for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+    {
+        if (re_has_backref(reptr->re_src))
+        {
+            con_printf("RE: Not combining '%s', it uses back-references\n", reptr->re_exp);
+            return false;
+        }
+
+        /* The callback receives at most RE_REMATCH_MAX matches */
+        if ((reptr->re_nsub + 1) > RE_REMATCH_MAX)
+        {
+            con_printf("RE: Not combining '%s', too many groups\n", reptr->re_exp);
+            return false;
+        }
+
+        /* "|" + "(" + ".*?" + ")" */
+        comb_sz += strlen(reptr->re_src) + 6;
+
+        reptr->re_comb_group = group;
+        group += reptr->re_nsub + 1;
+    }
+
+    comb_exp = malloc(comb_sz);
+    if (comb_exp == NULL)
+    {
+        return false;
+    }
+
+    util_strlcpy(comb_exp, "^(?:", comb_sz);
 
-    for (reptr = re_array; RE_REGENG_VALID(reptr); reptr++)
+    for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
     {
-        int retval;
+        if (reptr != rs->rs_array)
+        {
+            util_strlcat(comb_exp, "|", comb_sz);
+        }
+
+        if (reptr->re_src[0] == '^')
+        {
+            util_strlcat(comb_exp, "(", comb_sz);
+            util_strlcat(comb_exp, reptr->re_src + 1, comb_sz);
+        }
+        else
+        {
+            util_strlcat(comb_exp, ".*?(", comb_sz);
+            util_strlcat(comb_exp, reptr->re_src, comb_sz);
+        }
+
+        util_strlcat(comb_exp, ")", comb_sz);
+    }
+
+    util_strlcat(comb_exp, ")", comb_sz);
 
-        retval = regcomp(&reptr->re_comp, reptr->re_exp, REG_EXTENDED);
-        if (retval == 0) continue;
+    retval = re_compile(comb_exp, &rs->rs_comb, &rs->rs_comb_extra, &comb_nsub);
+    free(comb_exp);
+
+    if (!retval)
+    {
+        con_printf("RE: Error compiling the combined regex\n");
+        return false;
+    }
 
-        regerror(retval, &reptr->re_comp, errstr, sizeof(errstr));
-        con_printf("Error parsing regex: %s (%s)\n", reptr->re_exp, errstr);
+    /* Sanity check, this would mean we miscounted the groups */
+    if ((comb_nsub + 1) != group)
+    {
+        con_printf("RE: Combined regex group mismatch: %u != %u\n", (unsigned)(comb_nsub + 1), (unsigned)group);
+        return false;
+    }
 
+    rs->rs_comb_ovec = re_ovec_alloc(comb_nsub, &rs->rs_comb_ovecsz);
+    if (rs->rs_comb_ovec == NULL)
+    {
         return false;
     }
 
+    rs->rs_comb_valid = true;
+
+    con_printf("RE: Combined regex compiled, %u groups\n", (unsigned)group);
+
     return true;
 }
 
 /**
- * This is the main loop of the regular expression engine
+ * Skip a bracketed character class, including POSIX classes like [[:alnum:]]
  *
- * @note @p re_array must have been initialized with re_init() before
- * calling this function
+ * @param[in]       pexp    Pointer to the opening '['
  *
- * @param[in]       re_array        Initialized regular expression array
- * @param[in]       re_callback     Callback that will be called for processing any matches
- * @param[in]       str             String to match
+ * @return
+ * Pointer to the first character after the class
+ */
+const char *re_lit_skip_class(const char *pexp)
+{
+    /* Skip '[' */
+    pexp++;
+
+    if (*pexp == '^') pexp++;
+    /* A ']' at the beginning is a literal */
+    if (*pexp == ']') pexp++;
+
+    while ((*pexp != '\0') && (*pexp != ']'))
+    {
+        if ((pexp[0] == '[') && (pexp[1] == ':'))
+        {
+            /* POSIX class, skip to ":]" */
+            pexp += 2;
+            while ((*pexp != '\0') && !((pexp[0] == ':') && (pexp[1] == ']'))) pexp++;
+            if (*pexp != '\0') pexp += 2;
+            continue;
+        }
+
+        if ((pexp[0] == '\\') && (pexp[1] != '\0'))
+        {
+            pexp += 2;
+            continue;
+        }
+
+        pexp++;
+    }
+
+    if (*pexp == ']') pexp++;
+
+    return pexp;
+}
+
+/**
+ * End the current literal run and keep it if it's the longest so far
+ *
+ * Later runs win ties, they tend to be more specific than the common
+ * beginning of the line.
+ *
+ * @param[in,out]   cur         Current run
+ * @param[in,out]   cur_len     Length of @p cur, reset to 0
+ * @param[in,out]   best        Longest run so far
+ * @param[in,out]   best_len    Length of @p best
+ */
+void re_lit_flush(char *cur, size_t *cur_len, char *best, size_t *best_len)
+{
+    if ((*cur_len > 0) && (*cur_len >= *best_len))
+    {
+        memcpy(best, cur, *cur_len);
+        *best_len = *cur_len;
+    }
+
+    *cur_len = 0;
+}
+
+/**
+ * Extract the longest literal that every string matched by @p exp must contain
+ *
+ * Only the top level of the expression is considered, groups and character classes
+ * end the current literal run. Characters followed by a quantifier that allows zero
+ * repetitions are not required and are dropped from the run.
+ *
+ * @param[in]       exp         Regular expression string
+ * @param[out]      lit         Literal output buffer, this is not NUL terminated
+ * @param[in]       lit_sz      Size of @p lit
  *
  * @return
- * Currently returns always true
+ * Length of the literal or 0 if there is none (for example, if @p exp contains
+ * alternatives at the top level)
+ */
+size_t re_lit_extract(const char *exp, char *lit, size_t lit_sz)
+{
+    char cur[RE_LIT_SZ];
+    size_t cur_len = 0;
+    size_t lit_len = 0;
+    bool last_lit = false;
+    const char *pexp;
+    int depth;
+    char c;
+
+    if (lit_sz > sizeof(cur)) lit_sz = sizeof(cur);
+
+    pexp = exp;
+    if (*pexp == '^') pexp++;
+
+    while (*pexp != '\0')
+    {
+        switch (*pexp)
+        {
+            case '\\':
+                pexp++;
+                if (*pexp == '\0') break;
+
+                /* Escaped alphanumerics are classes (\d, \w), assertions or back-references */
+                if (((*pexp >= '0') && (*pexp <= '9')) ||
+                    ((*pexp >= 'a') && (*pexp <= 'z')) ||
+                    ((*pexp >= 'A') && (*pexp <= 'Z')))
+                {
+                    re_lit_flush(cur, &cur_len, lit, &lit_len);
+                    last_lit = false;
+                    pexp++;
+                    continue;
+                }
+
+                c = *pexp++;
+                goto literal;
+
+            case '(':
+                re_lit_flush(cur, &cur_len, lit, &lit_len);
+                last_lit = false;
+
+                /* Skip the group, including nested groups */
+                depth = 1;
+                pexp++;
+                while ((*pexp != '\0') && (depth > 0))
+                {
+                    if ((pexp[0] == '\\') && (pexp[1] != '\0'))
+                    {
+                        pexp += 2;
+                        continue;
+                    }
+
+                    if (*pexp == '[')
+                    {
+                        pexp = re_lit_skip_class(pexp);
+                        continue;
+                    }
+
+                    if (*pexp == '(') depth++;
+                    if (*pexp == ')') depth--;
+                    pexp++;
+                }
+                continue;
+
+            case '[':
+                re_lit_flush(cur, &cur_len, lit, &lit_len);
+                last_lit = false;
+                pexp = re_lit_skip_class(pexp);
+                continue;
+
+            case '|':
+                /* Alternatives at the top level, nothing is required */
+                return 0;
+
+            case '*':
+            case '?':
+            case '{':
+                /* The previous character may not be present at all */
+                if (last_lit) cur_len--;
+                re_lit_flush(cur, &cur_len, lit, &lit_len);
+                last_lit = false;
+
+                if (*pexp == '{')
+                {
+                    while ((*pexp != '\0') && (*pexp != '}')) pexp++;
+                    if (*pexp == '\0') continue;
+                }
+                pexp++;
+                continue;
+
+            case '+':
+                /* The previous character is required, but what follows is not adjacent to it */
+                re_lit_flush(cur, &cur_len, lit, &lit_len);
+                last_lit = false;
+                pexp++;
+                continue;
+
+            case '.':
+            case '^':
+            case '$':
+                re_lit_flush(cur, &cur_len, lit, &lit_len);
+                last_lit = false;
+                pexp++;
+                continue;
+
+            default:
+                c = *pexp++;
+                goto literal;
+        }
+
+        /* Trailing '\\' */
+        break;
+
+literal:
+        if (cur_len >= lit_sz)
+        {
+            re_lit_flush(cur, &cur_len, lit, &lit_len);
+        }
+
+        cur[cur_len++] = c;
+        last_lit = true;
+    }
+
+    re_lit_flush(cur, &cur_len, lit, &lit_len);
+
+    return lit_len;
+}
+
+/**
+ * Initialize the literal prefilter for the set @p rs
+ *
+ * Every expression must have a literal of at least @ref RE_PF_FP_LEN bytes, otherwise
+ * the prefilter could reject lines that the expression would match.
+ *
+ * @param[in,out]   rs      Regular expression set
+ *
+ * @retval          true    On success
+ * @retval          false   If the prefilter cannot be used for this set; this is not fatal
  */
-bool re_parse(re_callback_t re_callback, struct regeng *re_array, char *str)
+bool re_pf_init(struct regeng_set *rs)
 {
     struct regeng *reptr;
-    regmatch_t rematch[RE_REMATCH_MAX];
+    size_t idx;
+    size_t bucket;
+    size_t ii;
+    uint8_t c;
+
+    memset(rs->rs_pf_mask, 0, sizeof(rs->rs_pf_mask));
+    memset(rs->rs_pf_nib_lo, 0, sizeof(rs->rs_pf_nib_lo));
+    memset(rs->rs_pf_nib_hi, 0, sizeof(rs->rs_pf_nib_hi));
 
-    for (reptr = re_array; RE_REGENG_VALID(reptr); reptr++)
+    for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
     {
-        if (regexec(&reptr->re_comp, str, RE_REMATCH_MAX, rematch, 0) == 0)
+        reptr->re_lit_len = re_lit_extract(reptr->re_src, reptr->re_lit, sizeof(reptr->re_lit));
+        if (reptr->re_lit_len < RE_PF_FP_LEN)
         {
-            con_printf("RE: '%s' matched by '%s', id:%d\n", str, reptr->re_exp, reptr->re_id);
-            re_callback(reptr->re_id, str, rematch, RE_REMATCH_MAX);
-            return true;
+            con_printf("RE: Prefilter disabled, no literal in '%s'\n", reptr->re_exp);
+            return false;
+        }
+    }
+
+    for (bucket = 0; bucket < RE_PF_BUCKETS; bucket++)
+    {
+        rs->rs_pf_bucket_num[bucket] = 0;
+        rs->rs_pf_bucket[bucket] = malloc(rs->rs_num * sizeof(size_t));
+        if (rs->rs_pf_bucket[bucket] == NULL)
+        {
+            return false;
+        }
+    }
+
+    rs->rs_pf_cand = calloc(rs->rs_num, sizeof(bool));
+    if (rs->rs_pf_cand == NULL)
+    {
+        return false;
+    }
+
+    for (idx = 0; idx < rs->rs_num; idx++)
+    {
+        reptr = &rs->rs_array[idx];
+
+        /* Expressions are assigned to buckets round-robin */
+        bucket = idx % RE_PF_BUCKETS;
+        rs->rs_pf_bucket[bucket][rs->rs_pf_bucket_num[bucket]++] = idx;
+
+        for (ii = 0; ii < RE_PF_FP_LEN; ii++)
+        {
+            c = reptr->re_lit[ii];
+
+            rs->rs_pf_mask[ii][c] |= 1 << bucket;
+            rs->rs_pf_nib_lo[ii][c & 0xF] |= 1 << bucket;
+            rs->rs_pf_nib_hi[ii][c >> 4] |= 1 << bucket;
         }
     }
 
+    rs->rs_pf_valid = true;
+    rs->rs_pf_ssse3 = util_cpu_ssse3();
+
+    con_printf("RE: Prefilter initialized, %u literals%s\n", (unsigned)rs->rs_num, rs->rs_pf_ssse3 ? " (SSSE3)" : "");
+
     return true;
 }
 
+/**
+ * Verify a fingerprint hit at position @p pos and flag the candidate expressions
+ *
+ * @param[in,out]   rs          Regular expression set
+ * @param[in]       str         String being scanned
+ * @param[in]       str_len     Length of @p str
+ * @param[in]       pos         Position of the fingerprint hit
+ * @param[in]       mask        Buckets that had a fingerprint hit
+ * @param[in,out]   ncand       Number of candidates, incremented for each new candidate
+ */
+void re_pf_verify(struct regeng_set *rs, const char *str, int str_len, int pos, uint8_t mask, size_t *ncand)
+{
+    struct regeng *reptr;
+    size_t bucket;
+    size_t ii;
+    size_t idx;
+
+    for (bucket = 0; bucket < RE_PF_BUCKETS; bucket++)
+    {
+        if (!(mask & (1 << bucket))) continue;
+
+        for (ii = 0; ii < rs->rs_pf_bucket_num[bucket]; ii++)
+        {
+            idx = rs->rs_pf_bucket[bucket][ii];
+            if (rs->rs_pf_cand[idx]) continue;
+
+            reptr = &rs->rs_array[idx];
+            if ((size_t)(str_len - pos) < reptr->re_lit_len) continue;
+            if (memcmp(str + pos, reptr->re_lit, reptr->re_lit_len) != 0) continue;
+
+            rs->rs_lit_lang |= reptr->re_lang;
+
+            /* Expressions of inactive languages are never candidates, but note the hit */
+            if (!RE_LANG_ACTIVE(rs, reptr))
+            {
+                rs->rs_lang_hit = true;
+                continue;
+            }
+
+            rs->rs_pf_cand[idx] = true;
+            (*ncand)++;
+        }
+    }
+}
+
+/**
+ * Portable version of the prefilter scan, starting at position @p pos of @p str
+ *
+ * @param[in,out]   rs          Regular expression set with an initialized prefilter
+ * @param[in]       str         String to scan
+ * @param[in]       str_len     Length of @p str
+ * @param[in]       pos         First position to check
+ * @param[in,out]   ncand       Number of candidate expressions
+ */
+void re_pf_scan_scalar(struct regeng_set *rs, const char *str, int str_len, int pos, size_t *ncand)
+{
+    const uint8_t *ustr = (const uint8_t *)str;
+    uint8_t mask;
+
+    for (; (pos + RE_PF_FP_LEN) <= str_len; pos++)
+    {
+        mask = rs->rs_pf_mask[0][ustr[pos]] &
+               rs->rs_pf_mask[1][ustr[pos + 1]] &
+               rs->rs_pf_mask[2][ustr[pos + 2]];
+
+        if (mask == 0) continue;
+
+        re_pf_verify(rs, str, str_len, pos, mask, ncand);
+    }
+}
+
+#ifdef RE_PF_SIMD
+/**
+ * SSSE3 version of the prefilter scan
+ *
+ * Teddy: each input byte is mapped to a bucket mask by looking up its low and high
+ * nibble with PSHUFB; the masks of 3 consecutive bytes are ANDed together, so 16
+ * positions are checked for all fingerprints at once.
+ *
+ * @param[in,out]   rs          Regular expression set with an initialized prefilter
+ * @param[in]       str         String to scan
+ * @param[in]       str_len     Length of @p str
+ * @param[in,out]   ncand       Number of candidate expressions
+ *
+ * @return
+ * The first position that was not checked, the tail is left to re_pf_scan_scalar()
+ */
+int re_pf_scan_ssse3(struct regeng_set *rs, const char *str, int str_len, size_t *ncand)
+{
+    const uint8_t *ustr = (const uint8_t *)str;
+    __m128i nib_lo[RE_PF_FP_LEN];
+    __m128i nib_hi[RE_PF_FP_LEN];
+    __m128i lo_mask = _mm_set1_epi8(0x0F);
+    __m128i zero = _mm_setzero_si128();
+    uint8_t res_buf[16];
+    unsigned hits;
+    int pos = 0;
+    int ii;
+
+    for (ii = 0; ii < RE_PF_FP_LEN; ii++)
+    {
+        nib_lo[ii] = _mm_loadu_si128((const __m128i *)rs->rs_pf_nib_lo[ii]);
+        nib_hi[ii] = _mm_loadu_si128((const __m128i *)rs->rs_pf_nib_hi[ii]);
+    }
+
+    for (; (pos + 16 + RE_PF_FP_LEN - 1) <= str_len; pos += 16)
+    {
+        __m128i res = _mm_set1_epi8((char)0xFF);
+
+        for (ii = 0; ii < RE_PF_FP_LEN; ii++)
+        {
+            __m128i in = _mm_loadu_si128((const __m128i *)(ustr + pos + ii));
+            __m128i lo = _mm_shuffle_epi8(nib_lo[ii], _mm_and_si128(in, lo_mask));
+            __m128i hi = _mm_shuffle_epi8(nib_hi[ii], _mm_and_si128(_mm_srli_epi16(in, 4), lo_mask));
+
+            res = _mm_and_si128(res, _mm_and_si128(lo, hi));
+        }
+
+        hits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(res, zero)) & 0xFFFF;
+        if (hits == 0) continue;
+
+        _mm_storeu_si128((__m128i *)res_buf, res);
+        for (ii = 0; ii < 16; ii++)
+        {
+            if (hits & (1 << ii))
+            {
+                re_pf_verify(rs, str, str_len, pos + ii, res_buf[ii], ncand);
+            }
+        }
+    }
+
+    return pos;
+}
+#endif
+
+/**
+ * Scan @p str for the literals of the set @p rs
+ *
+ * On return, rs_pf_cand flags the expressions whose literal appears in @p str.
+ * The SSSE3 version is used if the CPU supports it, see @p rs_pf_ssse3.
+ *
+ * @param[in,out]   rs          Regular expression set with an initialized prefilter
+ * @param[in]       str         String to scan
+ * @param[in]       str_len     Length of @p str
+ *
+ * @return
+ * Number of candidate expressions
+ */
+size_t re_pf_scan(struct regeng_set *rs, const char *str, int str_len)
+{
+    size_t ncand = 0;
+    int pos = 0;
+
+#ifdef RE_PF_SIMD
+    if (rs->rs_pf_ssse3)
+    {
+        pos = re_pf_scan_ssse3(rs, str, str_len, &ncand);
+    }
+#endif
+
+    /* This also handles the tail of the string when SIMD is used */
+    re_pf_scan_scalar(rs, str, str_len, pos, &ncand);
+
+    return ncand;
+}
+
+/**
+ * Initialize the evaluation order of the set @p rs to the array order
+ *
+ * @param[in,out]   rs      Regular expression set
+ *
+ * @retval          true    On success
+ * @retval          false   On memory allocation error
+ */
+bool re_order_init(struct regeng_set *rs)
+{
+    size_t idx;
+
+    rs->rs_order = malloc(rs->rs_num * sizeof(size_t));
+    if (rs->rs_order == NULL)
+    {
+        return false;
+    }
+
+    for (idx = 0; idx < rs->rs_num; idx++)
+    {
+        rs->rs_order[idx] = idx;
+        rs->rs_array[idx].re_hits = 0;
+    }
+
+    rs->rs_order_lines = 0;
+
+    return true;
+}
+
+/**
+ * Sort the evaluation order of @p rs by the hit counters
+ *
+ * Expressions with the same number of hits keep the array order. The counters
+ * are halved afterwards, so the order follows changes in the log.
+ *
+ * @param[in,out]   rs      Regular expression set
+ */
+void re_order_update(struct regeng_set *rs)
+{
+    size_t ii;
+    size_t jj;
+    size_t idx;
+    uint32_t hits;
+
+    /* Insertion sort, the order is mostly sorted already */
+    for (ii = 1; ii < rs->rs_num; ii++)
+    {
+        idx = rs->rs_order[ii];
+        hits = rs->rs_array[idx].re_hits;
+
+        for (jj = ii; jj > 0; jj--)
+        {
+            struct regeng *prev = &rs->rs_array[rs->rs_order[jj - 1]];
+
+            if ((prev->re_hits > hits) ||
+                ((prev->re_hits == hits) && (rs->rs_order[jj - 1] < idx)))
+            {
+                break;
+            }
+
+            rs->rs_order[jj] = rs->rs_order[jj - 1];
+        }
+
+        rs->rs_order[jj] = idx;
+    }
+
+    for (ii = 0; ii < rs->rs_num; ii++)
+    {
+        rs->rs_array[ii].re_hits >>= 1;
+    }
+
+    rs->rs_order_lines = 0;
+}
+
+/**
+ * Parse the bracketed class at @p ppexp into the byte set @p set
+ *
+ * Only what the generated scanner supports is parsed: single bytes, ranges,
+ * escaped punctuation and the POSIX classes of the default (ASCII) PCRE tables.
+ *
+ * @param[in,out]   ppexp       Pointer to the opening '[', on return it points after the closing ']'
+ * @param[out]      set         Set of bytes accepted by the class
+ *
+ * @retval          true        On success
+ * @retval          false       If the class is not supported
+ */
+bool re_ovl_class(const char **ppexp, uint64_t *set)
+{
+    const char *pexp = *ppexp + 1;
+    bool neg = false;
+    bool first = true;
+    const char *pend;
+    size_t len;
+    int c;
+    int ii;
+
+    if (*pexp == '^')
+    {
+        neg = true;
+        pexp++;
+    }
+
+    while ((*pexp != '\0') && ((*pexp != ']') || first))
+    {
+        first = false;
+
+        if ((pexp[0] == '[') && (pexp[1] == ':'))
+        {
+            pend = strstr(pexp + 2, ":]");
+            if (pend == NULL) return false;
+
+            len = pend - (pexp + 2);
+            if ((len != 5) ||
+                ((memcmp(pexp + 2, "alnum", 5) != 0) && (memcmp(pexp + 2, "alpha", 5) != 0) &&
+                 (memcmp(pexp + 2, "digit", 5) != 0) && (memcmp(pexp + 2, "upper", 5) != 0) &&
+                 (memcmp(pexp + 2, "lower", 5) != 0)))
+            {
+                return false;
+            }
+
+            for (c = 0; c < 256; c++)
+            {
+                bool digit = (c >= '0') && (c <= '9');
+                bool upper = (c >= 'A') && (c <= 'Z');
+                bool lower = (c >= 'a') && (c <= 'z');
+
+                if (((memcmp(pexp + 2, "alnum", 5) == 0) && (digit || upper || lower)) ||
+                    ((memcmp(pexp + 2, "alpha", 5) == 0) && (upper || lower)) ||
+                    ((memcmp(pexp + 2, "digit", 5) == 0) && digit) ||
+                    ((memcmp(pexp + 2, "upper", 5) == 0) && upper) ||
+                    ((memcmp(pexp + 2, "lower", 5) == 0) && lower))
+                {
+                    RE_OVL_SET(set, c);
+                }
+            }
+
+            pexp = pend + 2;
+            continue;
+        }
+
+        if (pexp[0] == '\\')
+        {
+            if ((pexp[1] == '\0') || RE_OVL_ISALNUM(pexp[1])) return false;
+
+            RE_OVL_SET(set, pexp[1]);
+            pexp += 2;
+            continue;
+        }
+
+        if ((pexp[1] == '-') && (pexp[2] != ']') && (pexp[2] != '\0'))
+        {
+            for (c = (uint8_t)pexp[0]; c <= (uint8_t)pexp[2]; c++)
+            {
+                RE_OVL_SET(set, c);
+            }
+
+            pexp += 3;
+            continue;
+        }
+
+        RE_OVL_SET(set, *pexp);
+        pexp++;
+    }
+
+    if (*pexp != ']') return false;
+    *ppexp = pexp + 1;
+
+    if (neg)
+    {
+        for (ii = 0; ii < 4; ii++) set[ii] = ~set[ii];
+    }
+
+    return true;
+}
+
+/**
+ * Parse the anchored prefix of the expression @p exp into a list of byte positions
+ *
+ * Parsing stops at the first construct that is not understood (escapes like \\d,
+ * counted repeats, '$', ...). Groups are followed as long as they are matched
+ * exactly once; a quantified group or an alternation drops the atoms from the
+ * start of the enclosing group. The part of the expression after the returned
+ * atoms is treated as if it matched anything, so the result can only be too
+ * permissive, never too strict. Expressions that are not anchored with '^'
+ * return no atoms at all.
+ *
+ * The expressions are compiled without PCRE_UTF8, so each atom is a single byte.
+ *
+ * @param[in]       exp         Expression to parse
+ * @param[out]      atoms       Parsed positions
+ * @param[in]       atoms_max   Number of elements in @p atoms
+ *
+ * @return
+ * Number of atoms in @p atoms
+ */
+size_t re_ovl_parse(const char *exp, struct re_ovl_atom *atoms, size_t atoms_max)
+{
+    const char *pexp = exp;
+    struct re_ovl_atom *roa;
+    size_t group[RE_REMATCH_MAX];
+    size_t depth = 0;
+    size_t natoms = 0;
+    uint64_t set[4];
+    int c;
+
+    if (*pexp != '^') return 0;
+    pexp++;
+
+    for (;;)
+    {
+        memset(set, 0, sizeof(set));
+
+        switch (*pexp)
+        {
+            case '(':
+                if ((pexp[1] == '?') || (depth >= RE_REMATCH_MAX)) return natoms;
+
+                group[depth++] = natoms;
+                pexp++;
+                continue;
+
+            case ')':
+                if (depth == 0) return natoms;
+
+                depth--;
+                pexp++;
+
+                /* A group that may repeat or be skipped is not followed */
+                if ((*pexp == '*') || (*pexp == '+') || (*pexp == '?') || (*pexp == '{'))
+                {
+                    return group[depth];
+                }
+                continue;
+
+            case '|':
+                /* An alternative at the top level is not anchored */
+                return (depth > 0) ? group[depth - 1] : 0;
+
+            case '\\':
+                if ((pexp[1] == '\0') || RE_OVL_ISALNUM(pexp[1])) return natoms;
+
+                RE_OVL_SET(set, pexp[1]);
+                pexp += 2;
+                break;
+
+            case '.':
+                for (c = 0; c < 256; c++)
+                {
+                    if (c != '\n') RE_OVL_SET(set, c);
+                }
+                pexp++;
+                break;
+
+            case '[':
+                if (!re_ovl_class(&pexp, set)) return natoms;
+                break;
+
+            case '\0':
+            case '$':
+            case '^':
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+                return natoms;
+
+            default:
+                RE_OVL_SET(set, *pexp);
+                pexp++;
+                break;
+        }
+
+        if ((natoms >= atoms_max) || (*pexp == '{')) return natoms;
+
+        roa = &atoms[natoms++];
+        memcpy(roa->roa_set, set, sizeof(roa->roa_set));
+        roa->roa_rep = (*pexp == '*') || (*pexp == '+');
+        roa->roa_opt = (*pexp == '*') || (*pexp == '?');
+
+        if (roa->roa_rep || roa->roa_opt)
+        {
+            pexp++;
+            /* Lazy and possessive quantifiers don't add any matches */
+            if ((*pexp == '?') || (*pexp == '+')) pexp++;
+        }
+    }
+}
+
+/**
+ * Check if two expressions parsed by re_ovl_parse() may match the same line
+ *
+ * This walks both atom lists in parallel, consuming only bytes accepted by both.
+ * Once either list is exhausted, the rest of its expression is unknown and the
+ * expressions are assumed to overlap.
+ *
+ * @param[in]       a           Atoms of the first expression
+ * @param[in]       na          Number of atoms in @p a
+ * @param[in]       b           Atoms of the second expression
+ * @param[in]       nb          Number of atoms in @p b
+ *
+ * @retval          true        If a line may match both expressions or on memory allocation error
+ * @retval          false       If no line can match both expressions
+ */
+bool re_ovl_check(const struct re_ovl_atom *a, size_t na, const struct re_ovl_atom *b, size_t nb)
+{
+    size_t nstates = (na + 1) * (nb + 1);
+    size_t *stack;
+    bool *seen;
+    size_t sp = 0;
+    size_t state;
+    size_t ii;
+    size_t jj;
+    bool common;
+    bool retval = false;
+
+    stack = malloc(nstates * sizeof(size_t));
+    seen = calloc(nstates, sizeof(bool));
+    if ((stack == NULL) || (seen == NULL))
+    {
+        free(stack);
+        free(seen);
+        return true;
+    }
+
+#define RE_OVL_PUSH(i, j)                                   \
+    do                                                      \
+    {                                                       \
+        size_t s_ = (i) * (nb + 1) + (j);                  \
+        if (!seen[s_]) { seen[s_] = true; stack[sp++] = s_; } \
+    }                                                       \
+    while (0)
+
+    RE_OVL_PUSH(0, 0);
+
+    while (sp > 0)
+    {
+        state = stack[--sp];
+        ii = state / (nb + 1);
+        jj = state % (nb + 1);
+
+        if ((ii == na) || (jj == nb))
+        {
+            retval = true;
+            break;
+        }
+
+        if (a[ii].roa_opt) RE_OVL_PUSH(ii + 1, jj);
+        if (b[jj].roa_opt) RE_OVL_PUSH(ii, jj + 1);
+
+        common = ((a[ii].roa_set[0] & b[jj].roa_set[0]) != 0) ||
+                 ((a[ii].roa_set[1] & b[jj].roa_set[1]) != 0) ||
+                 ((a[ii].roa_set[2] & b[jj].roa_set[2]) != 0) ||
+                 ((a[ii].roa_set[3] & b[jj].roa_set[3]) != 0);
+        if (!common) continue;
+
+        RE_OVL_PUSH(ii + 1, jj + 1);
+        if (a[ii].roa_rep) RE_OVL_PUSH(ii, jj + 1);
+        if (b[jj].roa_rep) RE_OVL_PUSH(ii + 1, jj);
+    }
+
+#undef RE_OVL_PUSH
+
+    free(stack);
+    free(seen);
+
+    return retval;
+}
+
+/**
+ * Find the pairs of expressions in @p rs that may match the same line
+ *
+ * The result is used by re_parse_cand() to limit the candidates that must be
+ * re-checked when an expression matches out of the array order. If this fails,
+ * @p rs_ovl stays NULL and all preceding candidates are re-checked.
+ *
+ * @param[in,out]   rs      Regular expression set
+ */
+void re_ovl_init(struct regeng_set *rs)
+{
+    struct re_ovl_atom *atoms;
+    size_t *natoms;
+    size_t novl = 0;
+    size_t ii;
+    size_t jj;
+
+    atoms = malloc(rs->rs_num * RE_OVL_ATOMS_MAX * sizeof(struct re_ovl_atom));
+    natoms = malloc(rs->rs_num * sizeof(size_t));
+    rs->rs_ovl = calloc(rs->rs_num * rs->rs_num, sizeof(bool));
+    if ((atoms == NULL) || (natoms == NULL) || (rs->rs_ovl == NULL))
+    {
+        free(rs->rs_ovl);
+        rs->rs_ovl = NULL;
+        goto exit;
+    }
+
+    for (ii = 0; ii < rs->rs_num; ii++)
+    {
+        natoms[ii] = re_ovl_parse(rs->rs_array[ii].re_src, &atoms[ii * RE_OVL_ATOMS_MAX], RE_OVL_ATOMS_MAX);
+    }
+
+    for (jj = 0; jj < rs->rs_num; jj++)
+    {
+        for (ii = 0; ii < jj; ii++)
+        {
+            if (re_ovl_check(&atoms[ii * RE_OVL_ATOMS_MAX], natoms[ii], &atoms[jj * RE_OVL_ATOMS_MAX], natoms[jj]))
+            {
+                rs->rs_ovl[jj * rs->rs_num + ii] = true;
+                novl++;
+            }
+        }
+    }
+
+    con_printf("RE: %s: %u expression pairs may match the same line\n", rs->rs_name, (unsigned)novl);
+
+exit:
+    free(atoms);
+    free(natoms);
+}
+
+/**
+ * Set up @p re_src, the expression string that is actually compiled
+ *
+ * In native mode (see @ref regeng_set) the UTF-8 expression is converted to
+ * CP-1252, so lines can be matched as they are read from the chatlog.
+ *
+ * @param[in]       rs              Set of regular expressions
+ * @param[in,out]   reptr           Expression from @p rs
+ *
+ * @retval          true            On success
+ * @retval          false           If the expression can't be converted
+ */
+bool re_src_init(struct regeng_set *rs, struct regeng *reptr)
+{
+    size_t src_sz;
+
+    if (!rs->rs_native)
+    {
+        reptr->re_src = reptr->re_exp;
+        return true;
+    }
+
+    /* The CP-1252 string is never longer than the UTF-8 one */
+    src_sz = strlen(reptr->re_exp) + 1;
+
+    reptr->re_src = malloc(src_sz);
+    if (reptr->re_src == NULL)
+    {
+        return false;
+    }
+
+    if (!util_utf8_to_cp1252(reptr->re_src, src_sz, reptr->re_exp))
+    {
+        con_printf("RE: Unable to convert '%s' to CP-1252\n", reptr->re_exp);
+        free(reptr->re_src);
+        reptr->re_src = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Compile the expressions of the set @p rs and initialize the PCRE matching
+ *
+ * Scan the regex array and compile the regular expressions in the @p re_src field,
+ * then combine them into a single regular expression.
+ *
+ * @param[in]       rs              Set of regular expressions
+ *
+ * @return
+ * true on success, or false if any of the regular expressions failed to
+ * initialize.
+ */
+bool re_init_pcre(struct regeng_set *rs)
+{
+    struct regeng *reptr;
+    int jit;
+
+    if ((pcre_config(PCRE_CONFIG_JIT, &jit) != 0) || !jit)
+    {
+        con_printf("RE: PCRE was built without JIT support.\n");
+    }
+
+    for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+    {
+        if (!re_compile(reptr->re_src, &reptr->re_pcre, &reptr->re_extra, &reptr->re_nsub))
+        {
+            return false;
+        }
+
+        reptr->re_ovec = re_ovec_alloc(reptr->re_nsub, &reptr->re_ovecsz);
+        if (reptr->re_ovec == NULL)
+        {
+            con_printf("RE: Unable to allocate the output vector\n");
+            return false;
+        }
+    }
+
+    if (!re_comb_init(rs))
+    {
+        con_printf("RE: Using sequential matching.\n");
+    }
+
+    if (!re_order_init(rs))
+    {
+        return false;
+    }
+
+    re_ovl_init(rs);
+
+    rs->rs_pcre_valid = true;
+
+    return true;
+}
+
+/**
+ * Initialize the regular expression engine 
+ *
+ * The literal prefilter is built here, it doesn't need the compiled expressions.
+ * If the set has a generated scanner, compiling the expressions is deferred
+ * until the scanner leaves a line to PCRE for the first time.
+ *
+ * @param[in]       rs              Set of regular expressions
+ *
+ * @return
+ * true on success, or false if any of the regular expressions failed to
+ * initialize.
+ */
+bool re_init(struct regeng_set *rs)
+{
+    struct regeng *reptr;
+
+    rs->rs_pcre_valid = false;
+    rs->rs_comb_valid = false;
+    rs->rs_pf_valid = false;
+    rs->rs_order = NULL;
+    rs->rs_ovl = NULL;
+    rs->rs_num = 0;
+    rs->rs_lang = 0;
+    rs->rs_lang_misses = 0;
+    rs->rs_match = NULL;
+
+    for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+    {
+        rs->rs_num++;
+
+        if (!re_src_init(rs, reptr))
+        {
+            return false;
+        }
+    }
+
+    if (!re_pf_init(rs))
+    {
+        con_printf("RE: Not using the prefilter.\n");
+    }
+
+#ifndef RE_SCAN_CHECK
+    if (rs->rs_scan == NULL)
+#endif
+    {
+        if (!re_init_pcre(rs))
+        {
+            return false;
+        }
+    }
+
+    /* Register the set for statistics */
+    if (rs->rs_name == NULL) rs->rs_name = "regeng";
+    rs->rs_next = re_set_list;
+    re_set_list = rs;
+
+    return true;
+}
+
+/**
+ * Match @p str against the combined regular expression
+ *
+ * The combined regex tells us which expression matched; its groups are then
+ * moved to the beginning of the match array, so the callback sees exactly
+ * the same matches as if the expression was executed on its own.
+ *
+ * @param[in]       re_callback     Callback that will be called for processing any matches
+ * @param[in]       rs              Initialized regular expression set
+ * @param[in]       str             String to match
+ * @param[in]       str_len         Length of @p str
+ */
+void re_parse_comb(re_callback_t re_callback, struct regeng_set *rs, char *str, int str_len)
+{
+    struct regeng *reptr;
+    int *comb_ovec = NULL;
+    uint64_t tstart = 0;
+    bool timing;
+    int retval;
+
+    timing = __atomic_load_n(&re_stats_timing, __ATOMIC_RELAXED);
+
+    if (timing) tstart = sys_monotime_ns();
+    retval = pcre_exec(rs->rs_comb, rs->rs_comb_extra, str, str_len, 0, 0, rs->rs_comb_ovec, rs->rs_comb_ovecsz);
+
+    rs->rs_comb_attempts++;
+    if (timing) rs->rs_comb_ns += sys_monotime_ns() - tstart;
+
+    if (retval <= 0)
+    {
+        return;
+    }
+
+    /* Find the first wrapping group that matched; groups past the return value are unset */
+    for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+    {
+        if ((int)reptr->re_comb_group >= retval) continue;
+
+        comb_ovec = &rs->rs_comb_ovec[reptr->re_comb_group * 2];
+        if (comb_ovec[0] != -1) break;
+    }
+
+    /* Shouldn't happen, the combined regex matched */
+    if (!RE_REGENG_VALID(reptr)) return;
+
+    /* The expression's own groups that matched, the wrapping group becomes group 0 */
+    retval -= reptr->re_comb_group;
+    if (retval > (int)(reptr->re_nsub + 1))
+    {
+        retval = reptr->re_nsub + 1;
+    }
+
+    reptr->re_hits++;
+    reptr->re_matches++;
+
+    re_match_callback(re_callback, rs, reptr, str, str_len, comb_ovec, retval);
+}
+
+/**
+ * Execute a single expression on @p str
+ *
+ * On a match, the output vector of @p reptr holds the matched groups.
+ *
+ * @param[in]       reptr           Expression to execute
+ * @param[in]       str             String to match
+ * @param[in]       str_len         Length of @p str
+ *
+ * @return
+ * Number of groups set in the output vector (including the whole match), or a
+ * value less than 1 if @p reptr did not match
+ */
+int re_exec(struct regeng *reptr, char *str, int str_len)
+{
+    uint64_t tstart;
+    uint64_t tdelta;
+    int retval;
+
+    reptr->re_attempts++;
+
+    if (!__atomic_load_n(&re_stats_timing, __ATOMIC_RELAXED))
+    {
+        retval = pcre_exec(reptr->re_pcre, reptr->re_extra, str, str_len, 0, 0, reptr->re_ovec, reptr->re_ovecsz);
+        if (retval > 0) reptr->re_matches++;
+
+        return retval;
+    }
+
+    tstart = sys_monotime_ns();
+    retval = pcre_exec(reptr->re_pcre, reptr->re_extra, str, str_len, 0, 0, reptr->re_ovec, reptr->re_ovecsz);
+    tdelta = sys_monotime_ns() - tstart;
+
+    reptr->re_time_ns += tdelta;
+
+    if (tdelta > reptr->re_time_max_ns)
+    {
+        reptr->re_time_max_ns = tdelta;
+    }
+
+    if (retval > 0)
+    {
+        reptr->re_matches++;
+    }
+    else
+    {
+        reptr->re_miss_ns += tdelta;
+    }
+
+    return retval;
+}
+
+/**
+ * Call the callback for a match of @p reptr
+ *
+ * @param[in]       re_callback     Callback that will be called for processing the match,
+ *                                  if NULL the groups are only stored in @p rs_cap
+ * @param[in]       rs              Set of @p reptr, the match is recorded in @p rs_match
+ * @param[in]       reptr           Expression that matched
+ * @param[in]       str             String that was matched
+ * @param[in]       str_len         Length of @p str
+ * @param[in]       ovec            Output vector of the match
+ * @param[in]       ngrp            Number of groups set in @p ovec
+ */
+void re_match_callback(re_callback_t re_callback, struct regeng_set *rs, struct regeng *reptr, char *str, int str_len, int *ovec, int ngrp)
+{
+    struct re_capture cap[RE_REMATCH_MAX];
+
+    size_t cap_num;
+
+    rs->rs_match = reptr;
+
+    cap_num = ((reptr->re_nsub + 1) < RE_REMATCH_MAX) ? (reptr->re_nsub + 1) : RE_REMATCH_MAX;
+
+    con_printf("RE: '%.*s' matched by '%s', id:%d\n", str_len, str, reptr->re_exp, reptr->re_id);
+
+    /* Without a callback, just record the match */
+    if (re_callback == NULL)
+    {
+        re_ovec_capture(rs->rs_cap, str, ovec, ngrp);
+        rs->rs_cap_num = cap_num;
+        return;
+    }
+
+    re_ovec_capture(cap, str, ovec, ngrp);
+
+    re_callback(reptr->re_id, str, cap, cap_num);
+}
+
+/**
+ * Match @p str against the candidates flagged by the prefilter
+ *
+ * The candidates are tried in the evaluation order. When one matches, the untried
+ * candidates that come before it in the array and may match the same line (see
+ * re_ovl_init()) are tried too, and the first one that matches in the array order wins.
+ *
+ * @param[in]       re_callback     Callback that will be called for processing any matches
+ * @param[in]       rs              Initialized regular expression set
+ * @param[in]       str             String to match
+ * @param[in]       str_len         Length of @p str
+ * @param[in]       ncand           Number of candidates flagged by re_pf_scan()
+ */
+void re_parse_cand(re_callback_t re_callback, struct regeng_set *rs, char *str, int str_len, size_t ncand)
+{
+    struct regeng *match = NULL;
+    size_t match_idx = 0;
+    int match_ngrp = 0;
+    size_t ii;
+    size_t idx;
+    int retval;
+
+    for (ii = 0; (ii < rs->rs_num) && (ncand > 0); ii++)
+    {
+        idx = rs->rs_order[ii];
+        if (!rs->rs_pf_cand[idx]) continue;
+
+        rs->rs_pf_cand[idx] = false;
+        ncand--;
+
+        retval = re_exec(&rs->rs_array[idx], str, str_len);
+        if (retval > 0)
+        {
+            match = &rs->rs_array[idx];
+            match_idx = idx;
+            match_ngrp = retval;
+            break;
+        }
+    }
+
+    /* Check the untried candidates that precede the match and may overlap with it, and clear the flags */
+    for (idx = 0; (idx < rs->rs_num) && (ncand > 0); idx++)
+    {
+        if (!rs->rs_pf_cand[idx]) continue;
+
+        rs->rs_pf_cand[idx] = false;
+        ncand--;
+
+        if ((match == NULL) || (&rs->rs_array[idx] > match)) continue;
+        if ((rs->rs_ovl != NULL) && !rs->rs_ovl[match_idx * rs->rs_num + idx]) continue;
+
+        retval = re_exec(&rs->rs_array[idx], str, str_len);
+        if (retval > 0)
+        {
+            match = &rs->rs_array[idx];
+            match_ngrp = retval;
+        }
+    }
+
+    if (match != NULL)
+    {
+        match->re_hits++;
+        re_match_callback(re_callback, rs, match, str, str_len, match->re_ovec, match_ngrp);
+    }
+}
+
+#ifdef RE_SCAN_CHECK
+/**
+ * Verify the result of the scanner against PCRE
+ *
+ * The expressions are executed one by one in the array order, which is the
+ * reference behavior. Any difference is logged to the console.
+ *
+ * @param[in]       rs              Regular expression set
+ * @param[in]       str             String that was matched
+ * @param[in]       str_len         Length of @p str
+ * @param[in]       ovec            Output vector returned by the scanner
+ * @param[in]       ngrp            Return value of the scanner
+ * @param[in]       idx             Expression index returned by the scanner
+ */
+void re_scan_check(struct regeng_set *rs, char *str, int str_len, int *ovec, int ngrp, size_t idx)
+{
+    struct regeng *reptr;
+    int retval = 0;
+
+    for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+    {
+        if (!RE_LANG_ACTIVE(rs, reptr)) continue;
+
+        retval = re_exec(reptr, str, str_len);
+        if (retval > 0) break;
+    }
+
+    if (!RE_REGENG_VALID(reptr))
+    {
+        if (ngrp > 0)
+        {
+            con_printf("RE: Scanner mismatch, '%.*s' matched by id:%d, PCRE: no match\n", str_len, str, rs->rs_array[idx].re_id);
+        }
+        return;
+    }
+
+    if ((ngrp != retval) ||
+        (reptr != &rs->rs_array[idx]) ||
+        (memcmp(ovec, reptr->re_ovec, retval * 2 * sizeof(int)) != 0))
+    {
+        con_printf("RE: Scanner mismatch, '%.*s' matched by '%s', scanner: %d/%d\n",
+                   str_len, str, reptr->re_exp, ngrp, (ngrp > 0) ? rs->rs_array[idx].re_id : 0);
+    }
+}
+#endif
+
+/**
+ * Match @p str with the generated scanner of @p rs
+ *
+ * @param[in]       re_callback     Callback that will be called for processing any matches
+ * @param[in]       rs              Regular expression set with a scanner
+ * @param[in]       str             String to match
+ * @param[in]       str_len         Length of @p str
+ *
+ * @retval          true            If the scanner handled @p str
+ * @retval          false           If @p str must be matched with PCRE
+ */
+bool re_parse_scan(re_callback_t re_callback, struct regeng_set *rs, char *str, int str_len)
+{
+    struct regeng *reptr;
+    int ovec[RE_REMATCH_MAX * 2];
+    uint64_t tstart = 0;
+    size_t idx = 0;
+    bool timing;
+    int retval;
+
+    timing = __atomic_load_n(&re_stats_timing, __ATOMIC_RELAXED);
+
+    if (timing) tstart = sys_monotime_ns();
+    retval = rs->rs_scan(str, str_len, rs->rs_lang, ovec, &idx);
+    if (timing) rs->rs_scan_ns += sys_monotime_ns() - tstart;
+
+    if (retval < 0)
+    {
+        rs->rs_scan_fallbacks++;
+        return false;
+    }
+
+#ifdef RE_SCAN_CHECK
+    re_scan_check(rs, str, str_len, ovec, retval, idx);
+#endif
+
+    if (retval == 0)
+    {
+        return true;
+    }
+
+    reptr = &rs->rs_array[idx];
+    reptr->re_hits++;
+    reptr->re_matches++;
+
+    re_match_callback(re_callback, rs, reptr, str, str_len, ovec, retval);
+
+    return true;
+}
+
+/**
+ * Match a single line, this is called by re_parse()
+ *
+ * @param[in]       re_callback     Callback that will be called for processing any matches
+ * @param[in]       rs              Initialized regular expression set
+ * @param[in]       str             String to match
+ * @param[in]       str_len         Length of @p str
+ *
+ * @return
+ * Returns false if the expressions could not be compiled, true otherwise
+ */
+bool re_parse_line(re_callback_t re_callback, struct regeng_set *rs, char *str, int str_len)
+{
+    struct regeng *reptr;
+    size_t ncand;
+    int retval;
+
+    ncand = 0;
+
+    if (rs->rs_pf_valid)
+    {
+        ncand = re_pf_scan(rs, str, str_len);
+        if (ncand == 0)
+        {
+            rs->rs_pf_rejects++;
+            return true;
+        }
+    }
+
+    if (re_nc_lookup(rs, str, str_len))
+    {
+        if (ncand > 0) memset(rs->rs_pf_cand, 0, rs->rs_num * sizeof(bool));
+        return true;
+    }
+
+    if ((rs->rs_scan != NULL) && re_parse_scan(re_callback, rs, str, str_len))
+    {
+        if (ncand > 0) memset(rs->rs_pf_cand, 0, rs->rs_num * sizeof(bool));
+        return true;
+    }
+
+    if (!rs->rs_pcre_valid && !re_init_pcre(rs))
+    {
+        if (ncand > 0) memset(rs->rs_pf_cand, 0, rs->rs_num * sizeof(bool));
+        return false;
+    }
+
+    if (++rs->rs_order_lines >= RE_ORDER_INTERVAL)
+    {
+        re_order_update(rs);
+    }
+
+    if (rs->rs_pf_valid)
+    {
+        if ((ncand >= RE_PF_COMB_MIN) && rs->rs_comb_valid && (rs->rs_lang == 0))
+        {
+            memset(rs->rs_pf_cand, 0, rs->rs_num * sizeof(bool));
+            re_parse_comb(re_callback, rs, str, str_len);
+            return true;
+        }
+
+        re_parse_cand(re_callback, rs, str, str_len, ncand);
+        return true;
+    }
+
+    /* The combined regex doesn't know about languages */
+    if (rs->rs_comb_valid && (rs->rs_lang == 0))
+    {
+        re_parse_comb(re_callback, rs, str, str_len);
+        return true;
+    }
+
+    for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+    {
+        if (!RE_LANG_ACTIVE(rs, reptr)) continue;
+
+        retval = re_exec(reptr, str, str_len);
+        if (retval > 0)
+        {
+            reptr->re_hits++;
+            re_match_callback(re_callback, rs, reptr, str, str_len, reptr->re_ovec, retval);
+            break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @name Negative Cache
+ *
+ * @{
+ */
+
+/**
+ * FNV-1a hash of @p str, every run of digits is hashed as a single 0 byte
+ *
+ * @return
+ * The hash, never 0
+ */
+uint64_t re_nc_hash(const char *str, int str_len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    bool digit = false;
+    int ii;
+
+    for (ii = 0; ii < str_len; ii++)
+    {
+        if ((str[ii] >= '0') && (str[ii] <= '9'))
+        {
+            if (digit) continue;
+
+            digit = true;
+            hash = (hash ^ 0) * 0x100000001b3ULL;
+            continue;
+        }
+
+        digit = false;
+        hash = (hash ^ (uint8_t)str[ii]) * 0x100000001b3ULL;
+    }
+
+    return (hash != 0) ? hash : 1;
+}
+
+/**
+ * Check if a line with the shape of @p str is known not to match any active expression
+ *
+ * On a miss, the key is stored in @p rs_nc_key; re_parsen() adds it to the cache if
+ * the line doesn't match.
+ *
+ * @param[in,out]   rs              Regular expression set
+ * @param[in]       str             String to match
+ * @param[in]       str_len         Length of @p str
+ *
+ * @retval          true            If the line doesn't match
+ * @retval          false           If the line must be matched
+ */
+bool re_nc_lookup(struct regeng_set *rs, const char *str, int str_len)
+{
+    struct re_nc_entry *nc;
+    uint64_t hash;
+
+    if (rs->rs_nc == NULL)
+    {
+        rs->rs_nc = calloc(RE_NC_SIZE, sizeof(struct re_nc_entry));
+        if (rs->rs_nc == NULL) return false;
+    }
+
+    hash = re_nc_hash(str, str_len);
+
+    rs->rs_nc_lookups++;
+
+    nc = &rs->rs_nc[hash & (RE_NC_SIZE - 1)];
+    if ((nc->nc_hash == hash) && (nc->nc_lang == rs->rs_lang))
+    {
+        rs->rs_nc_hits++;
+        return true;
+    }
+
+    rs->rs_nc_key = hash;
+
+    return false;
+}
+
+/**
+ * Remember that the line of @p rs_nc_key doesn't match, the previous entry in its slot is replaced
+ */
+void re_nc_insert(struct regeng_set *rs)
+{
+    struct re_nc_entry *nc;
+
+    nc = &rs->rs_nc[rs->rs_nc_key & (RE_NC_SIZE - 1)];
+    nc->nc_hash = rs->rs_nc_key;
+    nc->nc_lang = rs->rs_lang;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * This is the main loop of the regular expression engine
+ *
+ * The prefilter is run first; lines that do not contain any of the literals
+ * are dropped right away, then the negative cache drops the lines that are known
+ * not to match. If the set has a generated scanner, it's used next
+ * and PCRE is used only for lines that the scanner cannot handle. If only a
+ * few expressions are candidates, they are tried in the order of their hit
+ * counters, otherwise the combined regex is used.
+ * Without the prefilter or the combined regex, the expressions are tried one by
+ * one in the array order. In all cases the first expression in the array that
+ * matches wins; expressions of inactive languages are skipped, see re_lang_set().
+ *
+ * @note @p rs must have been initialized with re_init() before
+ * calling this function
+ *
+ * @param[in]       re_callback     Callback that will be called for processing any matches
+ * @param[in]       rs              Initialized regular expression set
+ * @param[in]       str             String to match
+ *
+ * @return
+ * Returns false if the expressions could not be compiled, true otherwise
+ */
+bool re_parse(re_callback_t re_callback, struct regeng_set *rs, char *str)
+{
+    return re_parsen(re_callback, rs, str, strlen(str));
+}
+
+/**
+ * Same as re_parse(), but the length of @p str is already known
+ *
+ * @p str doesn't have to be terminated, so lines can be matched directly in a
+ * read buffer or a memory mapped file.
+ *
+ * If @p re_callback is NULL, the match is only recorded: the expression is stored
+ * in @p rs_match and the groups in @p rs_cap, they're valid until the next call.
+ *
+ * @param[in]       re_callback     Callback that will be called for processing any matches, or NULL
+ * @param[in]       rs              Initialized regular expression set
+ * @param[in]       str             String to match
+ * @param[in]       str_len         Length of @p str
+ *
+ * @return
+ * Returns false if the expressions could not be compiled, true otherwise
+ */
+bool re_parsen(re_callback_t re_callback, struct regeng_set *rs, char *str, size_t str_len)
+{
+    bool retval;
+
+    rs->rs_lines++;
+    rs->rs_match = NULL;
+    rs->rs_lang_hit = false;
+    rs->rs_lit_lang = 0;
+    rs->rs_nc_key = 0;
+
+    retval = re_parse_line(re_callback, rs, str, str_len);
+
+    if (retval && (rs->rs_match == NULL) && (rs->rs_nc_key != 0))
+    {
+        re_nc_insert(rs);
+    }
+
+    if (rs->rs_lang_hit && (rs->rs_match == NULL))
+    {
+        rs->rs_lang_misses++;
+    }
+
+    return retval;
+}
+
+/**
+ * Select the active languages of the set @p rs
+ *
+ * Only the expressions with a language in @p lang and the expressions that
+ * are not tied to a language are evaluated by re_parse() after this call.
+ *
+ * @param[in,out]   rs              Initialized regular expression set
+ * @param[in]       lang            Mask of active languages, 0 to use all expressions
+ */
+void re_lang_set(struct regeng_set *rs, uint32_t lang)
+{
+    rs->rs_lang = lang;
+
+    con_printf("RE: %s: active languages set to 0x%02X\n", rs->rs_name, lang);
+}
+
+/**
+ * Create a copy of the set @p src that can be used by another thread
+ *
+ * The copy shares the compiled expressions, the scanner, the prefilter tables and
+ * the overlap table with @p src; these are only read while parsing. The output
+ * vectors, the candidate flags, the evaluation order and the statistics are private.
+ * The expressions of @p src are compiled here if they weren't already, so no thread
+ * ever compiles them.
+ *
+ * The copy is not registered for statistics; re_clone_free() adds its statistics
+ * to @p src.
+ *
+ * @param[out]      rs              The new set
+ * @param[in]       src             Initialized regular expression set
+ *
+ * @retval          true            On success
+ * @retval          false           If the expressions could not be compiled or on
+ *                                  memory allocation error
+ */
+bool re_clone(struct regeng_set *rs, struct regeng_set *src)
+{
+    struct regeng *reptr;
+    bool retval;
+    size_t idx;
+
+    pthread_mutex_lock(&re_clone_lock);
+
+    retval = src->rs_pcre_valid || re_init_pcre(src);
+    if (retval)
+    {
+        *rs = *src;
+
+        /* Include the terminating element */
+        rs->rs_array = malloc((src->rs_num + 1) * sizeof(struct regeng));
+        rs->rs_order = malloc(src->rs_num * sizeof(size_t));
+
+        if (rs->rs_array != NULL) memcpy(rs->rs_array, src->rs_array, (src->rs_num + 1) * sizeof(struct regeng));
+        if (rs->rs_order != NULL) memcpy(rs->rs_order, src->rs_order, src->rs_num * sizeof(size_t));
+    }
+
+    pthread_mutex_unlock(&re_clone_lock);
+
+    if (!retval)
+    {
+        return false;
+    }
+
+    rs->rs_parent = src;
+    rs->rs_next = NULL;
+    rs->rs_comb_ovec = NULL;
+    rs->rs_pf_cand = NULL;
+    rs->rs_nc = NULL;
+    rs->rs_nc_lookups = 0;
+    rs->rs_nc_hits = 0;
+    rs->rs_match = NULL;
+    rs->rs_cap_num = 0;
+    rs->rs_lang_misses = 0;
+    rs->rs_lines = 0;
+    rs->rs_pf_rejects = 0;
+    rs->rs_comb_attempts = 0;
+    rs->rs_comb_ns = 0;
+    rs->rs_scan_ns = 0;
+    rs->rs_scan_fallbacks = 0;
+
+    if ((rs->rs_array == NULL) || (rs->rs_order == NULL))
+    {
+        goto error;
+    }
+
+    for (idx = 0; idx < rs->rs_num; idx++)
+    {
+        reptr = &rs->rs_array[idx];
+
+        reptr->re_ovec = NULL;
+        reptr->re_attempts = 0;
+        reptr->re_matches = 0;
+        reptr->re_time_ns = 0;
+        reptr->re_time_max_ns = 0;
+        reptr->re_miss_ns = 0;
+    }
+
+    for (idx = 0; idx < rs->rs_num; idx++)
+    {
+        reptr = &rs->rs_array[idx];
+
+        reptr->re_ovec = malloc(reptr->re_ovecsz * sizeof(int));
+        if (reptr->re_ovec == NULL)
+        {
+            goto error;
+        }
+    }
+
+    if (rs->rs_comb_valid)
+    {
+        rs->rs_comb_ovec = malloc(rs->rs_comb_ovecsz * sizeof(int));
+        if (rs->rs_comb_ovec == NULL)
+        {
+            goto error;
+        }
+    }
+
+    if (rs->rs_pf_valid)
+    {
+        rs->rs_pf_cand = calloc(rs->rs_num, sizeof(bool));
+        if (rs->rs_pf_cand == NULL)
+        {
+            goto error;
+        }
+    }
+
+    return true;
+
+error:
+    con_printf("RE: Unable to allocate a copy of %s\n", src->rs_name);
+    re_clone_free(rs);
+    return false;
+}
+
+/**
+ * Free a set that was created by re_clone()
+ *
+ * The statistics of @p rs are added to the set it was cloned from.
+ *
+ * @param[in,out]   rs              Set created by re_clone()
+ */
+void re_clone_free(struct regeng_set *rs)
+{
+    struct regeng_set *src = rs->rs_parent;
+    struct regeng *reptr;
+    size_t idx;
+
+    pthread_mutex_lock(&re_clone_lock);
+
+    if (rs->rs_array != NULL)
+    {
+        for (idx = 0; idx < rs->rs_num; idx++)
+        {
+            reptr = &src->rs_array[idx];
+
+            reptr->re_attempts += rs->rs_array[idx].re_attempts;
+            reptr->re_matches += rs->rs_array[idx].re_matches;
+            reptr->re_time_ns += rs->rs_array[idx].re_time_ns;
+            reptr->re_miss_ns += rs->rs_array[idx].re_miss_ns;
+
+            if (rs->rs_array[idx].re_time_max_ns > reptr->re_time_max_ns)
+            {
+                reptr->re_time_max_ns = rs->rs_array[idx].re_time_max_ns;
+            }
+
+            free(rs->rs_array[idx].re_ovec);
+        }
+
+        free(rs->rs_array);
+        rs->rs_array = NULL;
+    }
+
+    src->rs_lines += rs->rs_lines;
+    src->rs_pf_rejects += rs->rs_pf_rejects;
+    src->rs_comb_attempts += rs->rs_comb_attempts;
+    src->rs_comb_ns += rs->rs_comb_ns;
+    src->rs_scan_ns += rs->rs_scan_ns;
+    src->rs_scan_fallbacks += rs->rs_scan_fallbacks;
+    src->rs_nc_lookups += rs->rs_nc_lookups;
+    src->rs_nc_hits += rs->rs_nc_hits;
+
+    pthread_mutex_unlock(&re_clone_lock);
+
+    free(rs->rs_comb_ovec);
+    free(rs->rs_pf_cand);
+    free(rs->rs_order);
+    free(rs->rs_nc);
+
+    rs->rs_comb_ovec = NULL;
+    rs->rs_pf_cand = NULL;
+    rs->rs_order = NULL;
+    rs->rs_nc = NULL;
+}
+
+/**
+ * Pass a match that was recorded by a clone of @p rs to @p re_callback
+ *
+ * This is used to match lines in parallel with clones of @p rs, see re_clone(), and
+ * process the matches in order. The match is handled as if re_parse() found it,
+ * but only if the expression is active in @p rs; matches of other languages must be
+ * parsed again with re_parse().
+ *
+ * @param[in]       re_callback     Callback that will be called for processing the match
+ * @param[in]       rs              Regular expression set
+ * @param[in]       idx             Index of the matched expression in the array of @p rs
+ * @param[in]       str             String that was matched
+ * @param[in]       cap             Groups of the match, @ref RE_REMATCH_MAX elements
+ *
+ * @retval          true            If the match was passed to @p re_callback
+ * @retval          false           If the expression is not active in @p rs
+ */
+bool re_apply(re_callback_t re_callback, struct regeng_set *rs, size_t idx, const char *str, struct re_capture *cap)
+{
+    struct regeng *reptr;
+
+    if (idx >= rs->rs_num) return false;
+
+    reptr = &rs->rs_array[idx];
+    if (!RE_LANG_ACTIVE(rs, reptr)) return false;
+
+    rs->rs_match = reptr;
+    rs->rs_lang_hit = false;
+    reptr->re_hits++;
+
+    re_callback(reptr->re_id, str, cap, ((reptr->re_nsub + 1) < RE_REMATCH_MAX) ? (reptr->re_nsub + 1) : RE_REMATCH_MAX);
+
+    return true;
+}
+
+/**
+ * Enable or disable measuring the time spent matching
+ *
+ * The counters are always kept, but reading the clock around every regex is
+ * not free, so the time is measured only while the statistics are examined.
+ *
+ * @param[in]       enable      True to measure the time
+ */
+void re_stats_timing_set(bool enable)
+{
+    __atomic_store_n(&re_stats_timing, enable, __ATOMIC_RELAXED);
+}
+
+/**
+ * Return true if the time spent matching is measured, see re_stats_timing_set()
+ *
+ * @retval          true        If the time is measured
+ * @retval          false       If only the counters are kept
+ */
+bool re_stats_timing_get(void)
+{
+    return __atomic_load_n(&re_stats_timing, __ATOMIC_RELAXED);
+}
+
+/**
+ * Reset the statistics of all initialized regular expression sets
+ */
+void re_stats_reset(void)
+{
+    struct regeng_set *rs;
+    struct regeng *reptr;
+
+    for (rs = re_set_list; rs != NULL; rs = rs->rs_next)
+    {
+        rs->rs_lines = 0;
+        rs->rs_pf_rejects = 0;
+        rs->rs_comb_attempts = 0;
+        rs->rs_comb_ns = 0;
+        rs->rs_scan_ns = 0;
+        rs->rs_scan_fallbacks = 0;
+        rs->rs_nc_lookups = 0;
+        rs->rs_nc_hits = 0;
+
+        for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+        {
+            reptr->re_attempts = 0;
+            reptr->re_matches = 0;
+            reptr->re_time_ns = 0;
+            reptr->re_time_max_ns = 0;
+            reptr->re_miss_ns = 0;
+        }
+    }
+}
+
+/**
+ * Return a short summary of the regex statistics, suitable for the chat
+ *
+ * For each set, this reports the number of lines, the percentage of lines rejected by
+ * the prefilter, the hit rate of the negative cache, the average number of expressions
+ * tried per line, the total time
+ * spent in PCRE and the expression that took the most time. The times are only
+ * reported while they are measured, see re_stats_timing_set().
+ *
+ * @param[out]      buf         Output buffer
+ * @param[in]       buf_sz      Size of @p buf
+ *
+ * @retval          true        On success
+ * @retval          false       If no set was initialized
+ */
+bool re_stats_summary(char *buf, size_t buf_sz)
+{
+    struct regeng_set *rs;
+    struct regeng *reptr;
+    struct regeng *top;
+    uint64_t attempts;
+    uint64_t time_ns;
+    char line[256];
+
+    *buf = '\0';
+
+    if (re_set_list == NULL)
+    {
+        return false;
+    }
+
+    for (rs = re_set_list; rs != NULL; rs = rs->rs_next)
+    {
+        top = NULL;
+        attempts = 0;
+        time_ns = rs->rs_comb_ns + rs->rs_scan_ns;
+
+        for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+        {
+            attempts += reptr->re_attempts;
+            time_ns += reptr->re_time_ns;
+
+            if ((top == NULL) || (reptr->re_time_ns > top->re_time_ns))
+            {
+                top = reptr;
+            }
+        }
+
+        if (!re_stats_timing_get())
+        {
+            snprintf(line, sizeof(line), "%s%s: %llu lines, %llu%% filtered, %llu%% cached, %.2f tries/line, not timed",
+                     (rs == re_set_list) ? "" : " | ",
+                     rs->rs_name,
+                     (unsigned long long)rs->rs_lines,
+                     (unsigned long long)(rs->rs_lines ? rs->rs_pf_rejects * 100 / rs->rs_lines : 0),
+                     (unsigned long long)(rs->rs_nc_lookups ? rs->rs_nc_hits * 100 / rs->rs_nc_lookups : 0),
+                     rs->rs_lines ? (double)(attempts + rs->rs_comb_attempts) / rs->rs_lines : 0.0);
+
+            util_strlcat(buf, line, buf_sz);
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "%s%s: %llu lines, %llu%% filtered, %llu%% cached, %.2f tries/line, %llu us, top id:%u (%llu us)",
+                 (rs == re_set_list) ? "" : " | ",
+                 rs->rs_name,
+                 (unsigned long long)rs->rs_lines,
+                 (unsigned long long)(rs->rs_lines ? rs->rs_pf_rejects * 100 / rs->rs_lines : 0),
+                 (unsigned long long)(rs->rs_nc_lookups ? rs->rs_nc_hits * 100 / rs->rs_nc_lookups : 0),
+                 rs->rs_lines ? (double)(attempts + rs->rs_comb_attempts) / rs->rs_lines : 0.0,
+                 (unsigned long long)(time_ns / 1000),
+                 (top != NULL) ? top->re_id : 0,
+                 (unsigned long long)((top != NULL) ? top->re_time_ns / 1000 : 0));
+
+        util_strlcat(buf, line, buf_sz);
+    }
+
+    return true;
+}
+
+/**
+ * Dump the per-expression statistics of all initialized sets to stdout
+ */
+void re_stats_dump(void)
+{
+    struct regeng_set *rs;
+    struct regeng *reptr;
+
+    for (rs = re_set_list; rs != NULL; rs = rs->rs_next)
+    {
+        printf("===== [ REGENG %s: lines=%llu, prefilter rejects=%llu, combined=%llu (%llu ns) ] =====\n",
+               rs->rs_name,
+               (unsigned long long)rs->rs_lines,
+               (unsigned long long)rs->rs_pf_rejects,
+               (unsigned long long)rs->rs_comb_attempts,
+               (unsigned long long)rs->rs_comb_ns);
+
+        printf("===== [ REGENG %s: negative cache lookups=%llu, hits=%llu (%llu%%), %u entries ] =====\n",
+               rs->rs_name,
+               (unsigned long long)rs->rs_nc_lookups,
+               (unsigned long long)rs->rs_nc_hits,
+               (unsigned long long)(rs->rs_nc_lookups ? rs->rs_nc_hits * 100 / rs->rs_nc_lookups : 0),
+               RE_NC_SIZE);
+
+        if (rs->rs_scan != NULL)
+        {
+            printf("===== [ REGENG %s: scanner %llu ns, PCRE fallbacks=%llu ] =====\n",
+                   rs->rs_name,
+                   (unsigned long long)rs->rs_scan_ns,
+                   (unsigned long long)rs->rs_scan_fallbacks);
+        }
+
+        if (rs->rs_lang != 0)
+        {
+            printf("===== [ REGENG %s: languages=0x%02X, misses=%llu ] =====\n",
+                   rs->rs_name,
+                   rs->rs_lang,
+                   (unsigned long long)rs->rs_lang_misses);
+        }
+
+        printf("%5s %10s %10s %12s %10s %12s %10s  %s\n",
+               "ID", "ATTEMPTS", "MATCHES", "TOTAL ns", "MAX ns", "MISS ns", "AVG ns", "EXPRESSION");
+
+        for (reptr = rs->rs_array; RE_REGENG_VALID(reptr); reptr++)
+        {
+            printf("%5u %10llu %10llu %12llu %10llu %12llu %10llu  %s\n",
+                   reptr->re_id,
+                   (unsigned long long)reptr->re_attempts,
+                   (unsigned long long)reptr->re_matches,
+                   (unsigned long long)reptr->re_time_ns,
+                   (unsigned long long)reptr->re_time_max_ns,
+                   (unsigned long long)reptr->re_miss_ns,
+                   (unsigned long long)(reptr->re_attempts ? reptr->re_time_ns / reptr->re_attempts : 0),
+                   reptr->re_exp);
+        }
+    }
+
+    fflush(stdout);
+}
+
+#if TEST
+/**
+ * @cond REGENG_UNITTEST
+ */
+static struct regeng re_test[] =
+{
+    { .re_id = 1, .re_exp = "^: ([[:alnum:]]+) has acquired (.*)\\." },
+    { .re_id = 2, .re_exp = "^: You have acquired (.*)\\." },
+    { .re_id = 3, .re_exp = "^: ([[:alnum:]]+) rolled the dice and got ([0-9]+)" },
+    { .re_id = 4, .re_exp = "^: ([[:alnum:]]+) has joined your group\\." },
+    { .re_id = 5, .re_exp = "^: ([[:alnum:]]+) has left your group\\." },
+    { .re_id = 6, .re_exp = "^: \\[charname:([[:alnum:]]+).*\\]: (.*)$" },
+    { .re_id = 7, .re_exp = "^: ([[:alnum:]]+) Whispers: (.*)$" },
+    { .re_id = 8, .re_exp = "^: Vous avez obtenu (.*)\\." },
+    { .re_id = 9, .re_exp = "^: Ihr habt (.*) erhalten\\." },
+    RE_REGENG_END
+};
+
+static struct regeng_set re_test_set = RE_REGENG_SET(re_test);
+
+int main(void)
+{
+    static const char *words[] =
+    {
+        " has acquired ", "You have acquired ", " rolled the dice", " has joined your group",
+        " has left your group", "[charname:", " Whispers: ", "Vous avez obtenu ", " erhalten",
+        "has", "acq", "Whi", "Pinkfluid", ".", " ", "\xe9",
+    };
+    bool cand[16];
+    char str[256];
+    size_t ncand_scalar;
+    size_t ncand_ssse3;
+    int str_len;
+    int pos;
+    int ii;
+
+    util_init();
+
+    if (!re_init(&re_test_set) || !re_test_set.rs_pf_valid)
+    {
+        printf("FAIL: Unable to initialize the prefilter\n");
+        return 1;
+    }
+
+#ifdef RE_PF_SIMD
+    if (!util_cpu_ssse3())
+    {
+        printf("SKIP: The CPU doesn't support SSSE3\n");
+        return 0;
+    }
+
+    srand(1);
+
+    for (ii = 0; ii < 100000; ii++)
+    {
+        /* Random lines of up to 200 bytes built from literals and their fragments */
+        str_len = 0;
+        while ((str_len < 200) && ((rand() % 16) != 0))
+        {
+            str_len += snprintf(str + str_len, sizeof(str) - str_len, "%s", words[rand() % (sizeof(words) / sizeof(words[0]))]);
+        }
+        if (str_len > (int)sizeof(str) - 1) str_len = sizeof(str) - 1;
+
+        ncand_scalar = 0;
+        re_pf_scan_scalar(&re_test_set, str, str_len, 0, &ncand_scalar);
+        memcpy(cand, re_test_set.rs_pf_cand, re_test_set.rs_num * sizeof(bool));
+        memset(re_test_set.rs_pf_cand, 0, re_test_set.rs_num * sizeof(bool));
+
+        ncand_ssse3 = 0;
+        pos = re_pf_scan_ssse3(&re_test_set, str, str_len, &ncand_ssse3);
+        re_pf_scan_scalar(&re_test_set, str, str_len, pos, &ncand_ssse3);
+
+        if ((ncand_scalar != ncand_ssse3) ||
+            (memcmp(cand, re_test_set.rs_pf_cand, re_test_set.rs_num * sizeof(bool)) != 0))
+        {
+            printf("FAIL: '%.*s': %u scalar and %u SSSE3 candidates\n", str_len, str, (unsigned)ncand_scalar, (unsigned)ncand_ssse3);
+            return 1;
+        }
+
+        memset(re_test_set.rs_pf_cand, 0, re_test_set.rs_num * sizeof(bool));
+    }
+
+    printf("OK: %d lines\n", ii);
+#endif
+
+    return 0;
+}
+/**
+ * @endcond
+ */
+#endif
 
 /**
  * @}
@@ -28,6 +28,7 @@
 #ifndef REGENG_H_INCLUDED
 #define REGENG_H_INCLUDED
 
+#include <pcre.h>
 #include <pcreposix.h>
 
 /**
@@ -49,6 +50,42 @@
 /** Maximum number of regmatch_t structures */
 #define RE_REMATCH_MAX      32
 
+/** Maximum length of the literal extracted from an expression, see @ref regeng_set */
+#define RE_LIT_SZ           64
+/** Number of bytes in the prefilter fingerprint, literals shorter than this are not used */
+#define RE_PF_FP_LEN        3
+/** Number of prefilter buckets, this is the number of bits in a bucket mask */
+#define RE_PF_BUCKETS       8
+/**
+ * If a line has at least this many candidate expressions, use the combined regex
+ * instead of trying the candidates one by one
+ */
+#define RE_PF_COMB_MIN      8
+
+/** Number of parsed lines after which the evaluation order is updated */
+#define RE_ORDER_INTERVAL   4096
+
+/** Number of entries in the negative cache of a set, must be a power of 2 */
+#define RE_NC_SIZE          4096
+
+/**
+ * Negative cache entry, a line shape that doesn't match any expression
+ */
+struct re_nc_entry
+{
+    uint64_t        nc_hash;        /**< Hash of the line with the numbers masked, 0 if unused  */
+    uint32_t        nc_lang;        /**< Active languages when the line didn't match            */
+};
+
+/**
+ * Check if an expression with the language mask @p lang is used when the active
+ * languages are @p active; 0 means any language in both cases
+ */
+#define RE_LANG_MATCH(active, lang) (((active) == 0) || ((lang) == 0) || (((active) & (lang)) != 0))
+
+/** Check if the expression @p reptr is used by the set @p rs, see re_lang_set() */
+#define RE_LANG_ACTIVE(rs, reptr)   RE_LANG_MATCH((rs)->rs_lang, (reptr)->re_lang)
+
 /** Check if the regeng is valid */
 #define RE_REGENG_VALID(x)  (((x)->re_id  != RE_INVALID_ID) && \
                              ((x)->re_exp != NULL))
@@ -65,30 +102,205 @@ struct regeng
 {
     uint32_t    re_id;          /**< Regular expression ID, this is mainly useful for the
                                   * callback function                                                   */
-    regex_t     re_comp;        /**< Compiled regular expression, this is initialized by
+    pcre        *re_pcre;       /**< Compiled regular expression, this is initialized by
                                   * re_init() from @p re_exp                                            */
+    pcre_extra  *re_extra;      /**< Study data and JIT code for @p re_pcre                             */
     char        *re_exp;        /**< Regular expression string                                          */
+    char        *re_src;        /**< The string that is compiled, this is @p re_exp or its CP-1252
+                                  * version in native mode, set by re_init()                            */
+    size_t      re_nsub;        /**< Number of capture groups in @p re_exp, set by re_init()            */
+    int         *re_ovec;       /**< PCRE output vector, sized to the number of capture groups          */
+    int         re_ovecsz;      /**< Number of elements in @p re_ovec                                   */
+    size_t      re_comb_group;  /**< Index of the group that wraps this expression in the combined
+                                  * regex, see @ref regeng_set                                          */
+    char        re_lit[RE_LIT_SZ];  /**< Literal that must appear in every string matched by
+                                      * @p re_exp, extracted by re_init()                               */
+    size_t      re_lit_len;     /**< Length of @p re_lit, 0 if no usable literal was found              */
+    uint32_t    re_hits;        /**< Number of recent matches, used to order the evaluation             */
+    uint32_t    re_lang;        /**< Language mask of the expression, 0 if it is used with any language  */
+    uint64_t    re_attempts;    /**< Statistics: Number of times this expression was executed           */
+    uint64_t    re_matches;     /**< Statistics: Number of times this expression matched                */
+    uint64_t    re_time_ns;     /**< Statistics: Total time spent executing this expression             */
+    uint64_t    re_time_max_ns; /**< Statistics: Longest single execution                               */
+    uint64_t    re_miss_ns;     /**< Statistics: Time spent on executions that did not match            */
+};
+
+/**
+ * Generated scanner for a regeng array
+ *
+ * A scanner is a function generated at build time from a regeng array by regeng_gen.
+ * It must return the same results as matching the expressions with PCRE in the array
+ * order.
+ *
+ * @param[in]       str         String to match, it must be NUL terminated
+ * @param[in]       str_len     Length of @p str
+ * @param[in]       lang        Active languages, expressions of other languages are skipped
+ * @param[out]      ovec        Output vector in the PCRE format, at least 2 * @ref RE_REMATCH_MAX elements
+ * @param[out]      idx         Index of the matching expression in the regeng array
+ *
+ * @return
+ * The number of groups set in @p ovec (including the whole match) on a match, 0 if
+ * no expression matched or -1 if the scanner can't decide; in this case PCRE is used.
+ */
+typedef int re_scan_t(const char *str, int str_len, uint32_t lang, int *ovec, size_t *idx);
+
+/**
+ * A matched group as passed to @ref re_callback_t
+ *
+ * This is a view into the matched string, it is not NUL terminated and it is valid
+ * only until the callback returns.
+ */
+struct re_capture
+{
+    const char  *rc_str;        /**< Start of the group in the matched string, NULL if not matched  */
+    size_t      rc_len;         /**< Length of the group                                            */
 };
 
+/** This macro checks if the @ref re_capture @p x was matched */
+#define RE_CAPTURE_VALID(x)     ((x).rc_str != NULL)
+
+/**
+ * A set of regular expressions
+ *
+ * This wraps an array of @ref regeng structures. Besides compiling each expression
+ * on its own, re_init() joins all of them into a single alternation:
+ *
+ *      ^(?:(EXP1)|(EXP2)|...)
+ *
+ * This way a line is classified with a single pcre_exec() call instead of one call
+ * per expression. PCRE tries alternatives from left to right, so the first expression
+ * in the array that matches still wins.
+ *
+ * Before any regex is executed, the line goes through the literal prefilter. re_init()
+ * extracts the longest literal that each expression requires (for example " has acquired ")
+ * and distributes the literals into @ref RE_PF_BUCKETS buckets. The first @ref RE_PF_FP_LEN
+ * bytes of each literal form a fingerprint; a line is scanned for fingerprints in the
+ * style of the Teddy algorithm (SSSE3 if the CPU has it) and the hits are verified
+ * with memcmp(). Lines without any literal never reach PCRE, the rest is matched only
+ * against the candidate expressions.
+ *
+ * Candidates are tried in the order of their hit counters, which is updated every
+ * @ref RE_ORDER_INTERVAL lines. When an expression matches, the untried candidates
+ * that precede it in the array are checked as well, so the result is the same as
+ * if the array was scanned from the beginning. Only the preceding expressions that
+ * may match the same line are re-checked: when the expressions are compiled, the
+ * anchored prefixes of each pair are compared and pairs whose prefixes can't accept
+ * a common string are recorded as disjoint in @p rs_ovl.
+ *
+ * Lines that pass the prefilter but don't match are remembered in a small direct-mapped
+ * cache (@ref RE_NC_SIZE entries), keyed by a hash of the line where every run of digits
+ * is replaced by a single marker. The next line with the same shape is rejected without
+ * running the scanner or PCRE. This requires that no expression depends on the value
+ * or the length of a number, as with "([0-9]+)"; literal digits or counted repeats of
+ * digits must not be used.
+ *
+ * If the set has a generated scanner (see @ref re_scan_t), it's used instead of all of
+ * the above and the expressions are compiled only when the scanner cannot handle a
+ * line. When built with RE_SCAN_CHECK, every scanner result is verified with PCRE.
+ *
+ * The expressions are written in UTF-8. In native mode, re_init() converts them to
+ * CP-1252, the encoding of the chatlog, and lines are matched without converting them;
+ * the captured groups are CP-1252 too. The scanner of a native set must be generated
+ * with regeng_gen -n.
+ *
+ * Expressions can be tagged with a language mask (@p re_lang). Once the active
+ * languages are selected with re_lang_set(), the expressions of other languages are
+ * not evaluated at all. Lines where only the literal of an inactive expression was
+ * found are counted in @p rs_lang_misses, so the caller can tell when the selected
+ * language is wrong.
+ *
+ * A set can't be used by more than one thread at a time. re_clone() creates a copy
+ * that shares the compiled expressions and the prefilter tables with the original,
+ * but has its own output vectors, counters and statistics.
+ */
+struct regeng_set
+{
+    struct regeng   *rs_array;      /**< Array of expressions, terminated by @ref RE_REGENG_END         */
+    re_scan_t       *rs_scan;       /**< Generated scanner for @p rs_array, may be NULL                 */
+    bool            rs_native;      /**< Match CP-1252 lines instead of UTF-8 ones                      */
+    bool            rs_pcre_valid;  /**< True if the expressions were compiled                          */
+    bool            rs_comb_valid;  /**< True if @p rs_comb was successfully compiled                   */
+    pcre            *rs_comb;       /**< The combined regular expression                                */
+    pcre_extra      *rs_comb_extra; /**< Study data and JIT code for @p rs_comb                         */
+    int             *rs_comb_ovec;  /**< PCRE output vector for @p rs_comb, 3 elements per group        */
+    int             rs_comb_ovecsz; /**< Number of elements in @p rs_comb_ovec                          */
+    bool            rs_pf_valid;    /**< True if the prefilter can be used                              */
+    bool            rs_pf_ssse3;    /**< Use the SSSE3 prefilter scan, set from util_cpu_ssse3()        */
+    size_t          rs_num;         /**< Number of expressions in @p rs_array                           */
+    uint8_t         rs_pf_mask[RE_PF_FP_LEN][256];      /**< Bucket mask for each fingerprint byte      */
+    uint8_t         rs_pf_nib_lo[RE_PF_FP_LEN][16];     /**< Bucket mask by low nibble, used by SIMD    */
+    uint8_t         rs_pf_nib_hi[RE_PF_FP_LEN][16];     /**< Bucket mask by high nibble, used by SIMD   */
+    size_t          *rs_pf_bucket[RE_PF_BUCKETS];       /**< Expression indexes in each bucket          */
+    size_t          rs_pf_bucket_num[RE_PF_BUCKETS];    /**< Number of expressions in each bucket       */
+    bool            *rs_pf_cand;    /**< Candidate flags for the line being parsed, one per expression  */
+    size_t          *rs_order;      /**< Expression indexes in evaluation order                         */
+    uint32_t        rs_order_lines; /**< Lines parsed since the last update of @p rs_order              */
+    bool            *rs_ovl;        /**< rs_ovl[j * rs_num + i] is set if expressions i < j may match
+                                      * the same line, NULL if unknown                              */
+    uint32_t        rs_lang;        /**< Active languages, 0 for all; see re_lang_set()                 */
+    uint64_t        rs_lang_misses; /**< Unmatched lines with a literal of an inactive expression       */
+    bool            rs_lang_hit;    /**< Set if the current line has a literal of an inactive expression*/
+    uint32_t        rs_lit_lang;    /**< Languages of all expressions with a literal in the current line */
+    struct regeng   *rs_match;      /**< Expression matched by the last re_parse() call, or NULL        */
+    struct re_capture rs_cap[RE_REMATCH_MAX];   /**< Groups of the last match when re_parse() is
+                                                  * called without a callback                       */
+    size_t          rs_cap_num;     /**< Number of groups in @p rs_cap                                  */
+    struct regeng_set *rs_parent;   /**< Set that this one was cloned from, see re_clone()              */
+    struct re_nc_entry *rs_nc;      /**< Negative cache, allocated by the first re_parse()              */
+    uint64_t        rs_nc_key;      /**< Negative cache key of the current line, 0 if not cacheable     */
+    const char      *rs_name;       /**< Name of the set, used in statistics                            */
+    uint64_t        rs_lines;       /**< Statistics: Number of parsed lines                             */
+    uint64_t        rs_pf_rejects;  /**< Statistics: Lines rejected by the prefilter                    */
+    uint64_t        rs_comb_attempts;   /**< Statistics: Number of times the combined regex was executed*/
+    uint64_t        rs_comb_ns;     /**< Statistics: Total time spent executing the combined regex      */
+    uint64_t        rs_scan_ns;     /**< Statistics: Total time spent in the scanner                    */
+    uint64_t        rs_scan_fallbacks;  /**< Statistics: Lines the scanner left to PCRE                 */
+    uint64_t        rs_nc_lookups;  /**< Statistics: Negative cache lookups                             */
+    uint64_t        rs_nc_hits;     /**< Statistics: Lines rejected by the negative cache               */
+    struct regeng_set *rs_next;     /**< Next initialized set, for statistics                           */
+};
+
+/** Static initializer for a @ref regeng_set that wraps the regeng array @p array */
+#define RE_REGENG_SET(array)    { .rs_array = (array), .rs_comb_valid = false, .rs_name = #array }
+
+/** Same as @ref RE_REGENG_SET, but with the generated scanner @p scan */
+#define RE_REGENG_SET_SCAN(array, scan) \
+                                { .rs_array = (array), .rs_scan = (scan), .rs_comb_valid = false, .rs_name = #array }
+
+/** Same as @ref RE_REGENG_SET_SCAN, but the set is matched in native mode */
+#define RE_REGENG_SET_NATIVE(array, scan) \
+                                { .rs_array = (array), .rs_scan = (scan), .rs_native = true, .rs_comb_valid = false, .rs_name = #array }
+
 /**
  * The regeng callback
  *
- * @note That rematch may contain fewer matches than rematch_max. @ref RE_MATCH should be used
- * to check if a regmatch_t element is valid or not.
+ * @note That cap may contain fewer matches than cap_max. @ref RE_CAPTURE_VALID should be used
+ * to check if a re_capture element is valid or not.
  *
  * @param[in]       re_id       This is the @p re_id from @ref regeng
  * @param[in]       str         This is the full string that had a match
- * @param[in]       rematch     Array of matched parameters
- * @param[in]       rematch_max Number of matches in @p rematch, maximum @ref RE_REMATCH_MAX
+ * @param[in]       cap         Array of matched groups, element 0 is the whole match
+ * @param[in]       cap_max     Number of groups in @p cap, maximum @ref RE_REMATCH_MAX
  */
-typedef void  re_callback_t(uint32_t re_id, const char *str, regmatch_t *rematch, size_t rematch_max);
+typedef void  re_callback_t(uint32_t re_id, const char *str, struct re_capture *cap, size_t cap_max);
 
-extern bool   re_init(struct regeng *re_array);
-extern bool   re_parse(re_callback_t re_callback, struct regeng *re_array, char *str);
+extern bool   re_init(struct regeng_set *rs);
+extern bool   re_parse(re_callback_t re_callback, struct regeng_set *rs, char *str);
+extern bool   re_parsen(re_callback_t re_callback, struct regeng_set *rs, char *str, size_t str_len);
+extern void   re_lang_set(struct regeng_set *rs, uint32_t lang);
+extern bool   re_clone(struct regeng_set *rs, struct regeng_set *src);
+extern void   re_clone_free(struct regeng_set *rs);
+extern bool   re_apply(re_callback_t re_callback, struct regeng_set *rs, size_t idx, const char *str, struct re_capture *cap);
 
 extern void   re_strlcpy(char *outstr, const char *instr, size_t outsz, regmatch_t rem);
 extern size_t re_strlen(regmatch_t rem);
 
+extern void   re_stats_timing_set(bool enable);
+extern bool   re_stats_timing_get(void);
+extern void   re_stats_reset(void);
+extern bool   re_stats_summary(char *buf, size_t buf_sz);
+extern void   re_stats_dump(void);
+
 /**
  * @}
  */
@@ -0,0 +1,1094 @@
+/*
+ * regeng_gen.c - APme: Aion Automatic Abyss Point Tracker
+ *
+ * Copyright (C) 2012 Mitja Horvat <pinkfluid@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/**
+ * @file
+ *
+ * Scanner generator for the chatlog regex patterns
+ *
+ * This is a build-time tool, it is not linked into APme.
+ *
+ * @author Mitja Horvat <pinkfluid@gmail.com>
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "regeng.h"
+#include "chatlog_re.h"
+
+/**
+ * @defgroup regeng_gen Scanner Generator
+ *
+ * @brief Turns the @ref re_aion table into a specialized C matcher
+ *
+ * The chatlog patterns are anchored literals with a few holes (names, item
+ * links, numbers). This tool parses each pattern into a list of items and
+ * writes out a C function per pattern that matches it with memcmp() and
+ * simple loops. Lines are dispatched with a switch on the first byte after
+ * the common prefix (": "), the patterns are tried in the table order.
+ *
+ * The generated re_aion_scan() returns the same expression index and capture
+ * offsets as PCRE would. Patterns that use syntax not understood by the
+ * generator make the scanner return -1 when they would be tried, and the
+ * regeng falls back to PCRE.
+ *
+ * Usage: regeng_gen [-n] > chatlog_scan.c
+ *
+ * With -n the scanner matches CP-1252 lines, for a set in native mode (see
+ * @ref regeng_set); the UTF-8 patterns are converted before they are parsed.
+ *
+ * @{
+ */
+
+#define GEN_ITEMS_MAX       64              /**< Maximum number of items per pattern    */
+#define GEN_LIT_SZ          256             /**< Maximum literal length                 */
+#define GEN_CLASS_MAX       64              /**< Maximum number of distinct classes     */
+#define GEN_PATTERNS_MAX    256             /**< Maximum number of patterns             */
+#define GEN_SCAN_NAME       "re_aion_scan"  /**< Name of the generated function         */
+
+/** Pattern item types */
+enum gen_item_type
+{
+    GEN_LIT,            /**< Literal string                 */
+    GEN_ANY,            /**< '.'                            */
+    GEN_CLASS,          /**< Character class                */
+    GEN_CLASS_PLUS,     /**< Character class followed by +  */
+    GEN_GAP,            /**< '.*'                           */
+    GEN_CAP_OPEN,       /**< Capture group start            */
+    GEN_CAP_CLOSE,      /**< Capture group end              */
+    GEN_DOLLAR,         /**< '$'                            */
+};
+
+/** A single pattern item */
+struct gen_item
+{
+    enum gen_item_type  gi_type;                /**< Item type                              */
+    char                gi_lit[GEN_LIT_SZ];     /**< Literal string for GEN_LIT             */
+    size_t              gi_lit_len;             /**< Length of @p gi_lit                    */
+    int                 gi_class;               /**< Class index for GEN_CLASS*             */
+    int                 gi_group;               /**< Group number for GEN_CAP_*             */
+};
+
+/** Parsed pattern */
+struct gen_pattern
+{
+    bool                gp_supported;                   /**< False if the pattern is left to PCRE   */
+    struct gen_item     gp_items[GEN_ITEMS_MAX];        /**< Pattern items                          */
+    size_t              gp_nitems;                      /**< Number of items in @p gp_items         */
+    int                 gp_ngroups;                     /**< Number of capture groups               */
+    int                 gp_ngaps;                       /**< Number of GEN_GAP items                */
+    uint8_t             gp_first[32];                   /**< Bitmap of possible first bytes         */
+};
+
+static uint8_t gen_class[GEN_CLASS_MAX][32];            /**< Class bitmaps                          */
+static int gen_nclass = 0;                              /**< Number of classes in @p gen_class      */
+
+static struct gen_pattern gen_patterns[GEN_PATTERNS_MAX];   /**< Parsed patterns                    */
+static size_t gen_npatterns = 0;                        /**< Number of patterns                     */
+
+/** Set bit @p c in the bitmap @p map */
+#define GEN_SET(map, c)     ((map)[(uint8_t)(c) >> 3] |= (1 << ((uint8_t)(c) & 7)))
+/** Test bit @p c in the bitmap @p map */
+#define GEN_ISSET(map, c)   (((map)[(uint8_t)(c) >> 3] & (1 << ((uint8_t)(c) & 7))) != 0)
+
+static char *gen_native(const char *exp);
+static bool gen_isalnum(char c);
+static struct gen_item *gen_item_add(struct gen_pattern *gp, enum gen_item_type type);
+static bool gen_lit_add(struct gen_pattern *gp, char c);
+static bool gen_class_posix(const char *pexp, size_t len, uint8_t *map);
+static int gen_class_parse(const char **ppexp);
+static bool gen_is_quant(const char *pexp);
+static bool gen_parse(const char *exp, struct gen_pattern *gp);
+static struct gen_item *gen_next(struct gen_pattern *gp, size_t idx);
+static bool gen_check_greedy(struct gen_pattern *gp);
+static size_t gen_raw_prefix(const char *exp, const char **prefix);
+static void gen_strip_prefix(struct gen_pattern *gp, size_t len);
+static void gen_first_set(struct gen_pattern *gp);
+static void gen_cstr(const char *str, size_t len);
+static void gen_comment(const char *str);
+static void gen_indent(int level);
+static void gen_emit_items(struct gen_pattern *gp, size_t idx, int level);
+static void gen_emit_pattern(size_t idx, size_t prefix_len);
+static size_t gen_byte_list(int c, size_t *list);
+static void gen_emit_dispatch(const char *prefix, size_t prefix_len);
+
+/**
+ * Check if @p c is an ASCII alphanumeric character
+ */
+bool gen_isalnum(char c)
+{
+    return ((c >= '0') && (c <= '9')) ||
+           ((c >= 'a') && (c <= 'z')) ||
+           ((c >= 'A') && (c <= 'Z'));
+}
+
+/**
+ * Add a new item of type @p type to @p gp
+ *
+ * @return
+ * Pointer to the new item or NULL if there's no more space
+ */
+struct gen_item *gen_item_add(struct gen_pattern *gp, enum gen_item_type type)
+{
+    struct gen_item *gi;
+
+    if (gp->gp_nitems >= GEN_ITEMS_MAX) return NULL;
+
+    gi = &gp->gp_items[gp->gp_nitems++];
+    memset(gi, 0, sizeof(*gi));
+    gi->gi_type = type;
+
+    return gi;
+}
+
+/**
+ * Append the character @p c to the last literal of @p gp or start a new one
+ */
+bool gen_lit_add(struct gen_pattern *gp, char c)
+{
+    struct gen_item *gi = NULL;
+
+    if (gp->gp_nitems > 0) gi = &gp->gp_items[gp->gp_nitems - 1];
+
+    if ((gi == NULL) || (gi->gi_type != GEN_LIT) || (gi->gi_lit_len >= GEN_LIT_SZ))
+    {
+        gi = gen_item_add(gp, GEN_LIT);
+        if (gi == NULL) return false;
+    }
+
+    gi->gi_lit[gi->gi_lit_len++] = c;
+
+    return true;
+}
+
+/**
+ * Parse the POSIX class name at @p pexp (pointing after "[:") into @p map
+ *
+ * The default PCRE character tables are used, which are ASCII only.
+ */
+bool gen_class_posix(const char *pexp, size_t len, uint8_t *map)
+{
+    int c;
+
+    for (c = 0; c < 256; c++)
+    {
+        bool set = false;
+
+        if ((len == 5) && (memcmp(pexp, "alnum", 5) == 0))
+        {
+            set = gen_isalnum(c);
+        }
+        else if ((len == 5) && (memcmp(pexp, "digit", 5) == 0))
+        {
+            set = (c >= '0') && (c <= '9');
+        }
+        else if ((len == 5) && (memcmp(pexp, "alpha", 5) == 0))
+        {
+            set = gen_isalnum(c) && !((c >= '0') && (c <= '9'));
+        }
+        else if ((len == 5) && (memcmp(pexp, "upper", 5) == 0))
+        {
+            set = (c >= 'A') && (c <= 'Z');
+        }
+        else if ((len == 5) && (memcmp(pexp, "lower", 5) == 0))
+        {
+            set = (c >= 'a') && (c <= 'z');
+        }
+        else
+        {
+            return false;
+        }
+
+        if (set) GEN_SET(map, c);
+    }
+
+    return true;
+}
+
+/**
+ * Parse the bracketed class at @p pexp and return its index in @ref gen_class
+ *
+ * @param[in,out]   ppexp       Pointer to the opening '[', on return it points after the closing ']'
+ *
+ * @return
+ * Class index or -1 if the class is not supported
+ */
+int gen_class_parse(const char **ppexp)
+{
+    const char *pexp = *ppexp + 1;
+    uint8_t map[32];
+    bool neg = false;
+    bool first = true;
+    const char *pend;
+    int c;
+    int ii;
+
+    memset(map, 0, sizeof(map));
+
+    if (*pexp == '^')
+    {
+        neg = true;
+        pexp++;
+    }
+
+    while ((*pexp != '\0') && ((*pexp != ']') || first))
+    {
+        first = false;
+
+        if ((pexp[0] == '[') && (pexp[1] == ':'))
+        {
+            pend = strstr(pexp + 2, ":]");
+            if (pend == NULL) return -1;
+
+            if (!gen_class_posix(pexp + 2, pend - (pexp + 2), map)) return -1;
+
+            pexp = pend + 2;
+            continue;
+        }
+
+        if (pexp[0] == '\\')
+        {
+            if ((pexp[1] == '\0') || gen_isalnum(pexp[1])) return -1;
+
+            GEN_SET(map, pexp[1]);
+            pexp += 2;
+            continue;
+        }
+
+        if ((pexp[1] == '-') && (pexp[2] != ']') && (pexp[2] != '\0'))
+        {
+            for (c = (uint8_t)pexp[0]; c <= (uint8_t)pexp[2]; c++)
+            {
+                GEN_SET(map, c);
+            }
+
+            pexp += 3;
+            continue;
+        }
+
+        GEN_SET(map, *pexp);
+        pexp++;
+    }
+
+    if (*pexp != ']') return -1;
+    *ppexp = pexp + 1;
+
+    if (neg)
+    {
+        for (ii = 0; ii < 32; ii++) map[ii] = ~map[ii];
+    }
+
+    /* Reuse identical classes */
+    for (ii = 0; ii < gen_nclass; ii++)
+    {
+        if (memcmp(gen_class[ii], map, sizeof(map)) == 0) return ii;
+    }
+
+    if (gen_nclass >= GEN_CLASS_MAX) return -1;
+
+    memcpy(gen_class[gen_nclass], map, sizeof(map));
+
+    return gen_nclass++;
+}
+
+/**
+ * Check if a quantifier follows at @p pexp
+ */
+bool gen_is_quant(const char *pexp)
+{
+    return (*pexp == '*') || (*pexp == '+') || (*pexp == '?') || (*pexp == '{');
+}
+
+/**
+ * Parse the regular expression @p exp into @p gp
+ *
+ * @retval      true        If the expression is supported
+ * @retval      false       If the expression must be left to PCRE
+ */
+bool gen_parse(const char *exp, struct gen_pattern *gp)
+{
+    const char *pexp = exp;
+    struct gen_item *gi;
+    int stack[RE_REMATCH_MAX];
+    int depth = 0;
+    int cls;
+
+    gp->gp_nitems = 0;
+    gp->gp_ngroups = 0;
+    gp->gp_ngaps = 0;
+
+    /* Only anchored expressions are supported */
+    if (*pexp != '^') return false;
+    pexp++;
+
+    while (*pexp != '\0')
+    {
+        switch (*pexp)
+        {
+            case '\\':
+                if ((pexp[1] == '\0') || gen_isalnum(pexp[1])) return false;
+                if (!gen_lit_add(gp, pexp[1])) return false;
+                pexp += 2;
+                if (gen_is_quant(pexp)) return false;
+                break;
+
+            case '.':
+                if (pexp[1] == '*')
+                {
+                    pexp += 2;
+                    /* Lazy and possessive quantifiers are not supported */
+                    if ((*pexp == '?') || (*pexp == '+')) return false;
+                    if (gen_item_add(gp, GEN_GAP) == NULL) return false;
+                    gp->gp_ngaps++;
+                    break;
+                }
+
+                pexp++;
+                if (gen_is_quant(pexp)) return false;
+                if (gen_item_add(gp, GEN_ANY) == NULL) return false;
+                break;
+
+            case '[':
+                cls = gen_class_parse(&pexp);
+                if (cls < 0) return false;
+
+                if (*pexp == '+')
+                {
+                    pexp++;
+                    gi = gen_item_add(gp, GEN_CLASS_PLUS);
+                }
+                else
+                {
+                    gi = gen_item_add(gp, GEN_CLASS);
+                }
+
+                if (gi == NULL) return false;
+                gi->gi_class = cls;
+
+                if (gen_is_quant(pexp)) return false;
+                break;
+
+            case '(':
+                if (pexp[1] == '?') return false;
+                if (depth >= RE_REMATCH_MAX) return false;
+
+                gi = gen_item_add(gp, GEN_CAP_OPEN);
+                if (gi == NULL) return false;
+
+                gi->gi_group = ++gp->gp_ngroups;
+                stack[depth++] = gi->gi_group;
+                pexp++;
+                break;
+
+            case ')':
+                if (depth <= 0) return false;
+
+                gi = gen_item_add(gp, GEN_CAP_CLOSE);
+                if (gi == NULL) return false;
+
+                gi->gi_group = stack[--depth];
+                pexp++;
+                if (gen_is_quant(pexp)) return false;
+                break;
+
+            case '$':
+                if (pexp[1] != '\0') return false;
+                if (gen_item_add(gp, GEN_DOLLAR) == NULL) return false;
+                pexp++;
+                break;
+
+            case '^':
+            case '|':
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+            case ']':
+                return false;
+
+            default:
+                if (!gen_lit_add(gp, *pexp)) return false;
+                pexp++;
+                if (gen_is_quant(pexp)) return false;
+                break;
+        }
+    }
+
+    if (depth != 0) return false;
+
+    /* The callback receives at most RE_REMATCH_MAX matches */
+    if ((gp->gp_ngroups + 1) > RE_REMATCH_MAX) return false;
+
+    return true;
+}
+
+/**
+ * Find the next item after @p idx that is not a capture marker
+ *
+ * @return
+ * Pointer to the item or NULL at the end of the pattern
+ */
+struct gen_item *gen_next(struct gen_pattern *gp, size_t idx)
+{
+    for (idx++; idx < gp->gp_nitems; idx++)
+    {
+        if ((gp->gp_items[idx].gi_type != GEN_CAP_OPEN) &&
+            (gp->gp_items[idx].gi_type != GEN_CAP_CLOSE))
+        {
+            return &gp->gp_items[idx];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Check that greedy class repetitions never need to backtrack
+ *
+ * The generated code consumes a class run as a whole. This gives the same result as
+ * PCRE only if the item that follows cannot start with a character from the class.
+ *
+ * @retval      true        If the pattern can be matched without backtracking class runs
+ * @retval      false       Otherwise
+ */
+bool gen_check_greedy(struct gen_pattern *gp)
+{
+    struct gen_item *gi;
+    struct gen_item *next;
+    size_t ii;
+
+    for (ii = 0; ii < gp->gp_nitems; ii++)
+    {
+        gi = &gp->gp_items[ii];
+        if (gi->gi_type != GEN_CLASS_PLUS) continue;
+
+        next = gen_next(gp, ii);
+
+        /* A gap can absorb the class characters, look at what follows it */
+        if ((next != NULL) && (next->gi_type == GEN_GAP))
+        {
+            next = gen_next(gp, next - gp->gp_items);
+        }
+
+        if ((next == NULL) || (next->gi_type == GEN_DOLLAR)) continue;
+
+        if ((next->gi_type == GEN_LIT) && !GEN_ISSET(gen_class[gi->gi_class], next->gi_lit[0])) continue;
+
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Compute the length of the literal prefix of the raw expression @p exp
+ *
+ * This stops at the first special character, so it's valid for unsupported expressions too.
+ */
+size_t gen_raw_prefix(const char *exp, const char **prefix)
+{
+    size_t len = 0;
+
+    if (*exp != '^')
+    {
+        *prefix = exp;
+        return 0;
+    }
+
+    exp++;
+    *prefix = exp;
+
+    while ((exp[len] != '\0') && (strchr("\\.[]()*+?{}|$^", exp[len]) == NULL))
+    {
+        len++;
+    }
+
+    /* A quantifier may follow the last character */
+    if ((len > 0) && gen_is_quant(exp + len)) len--;
+
+    return len;
+}
+
+/**
+ * Remove the first @p len bytes of the literal prefix from @p gp
+ */
+void gen_strip_prefix(struct gen_pattern *gp, size_t len)
+{
+    struct gen_item *gi = &gp->gp_items[0];
+
+    if (len == 0) return;
+
+    gi->gi_lit_len -= len;
+    memmove(gi->gi_lit, gi->gi_lit + len, gi->gi_lit_len);
+
+    if (gi->gi_lit_len == 0)
+    {
+        gp->gp_nitems--;
+        memmove(&gp->gp_items[0], &gp->gp_items[1], gp->gp_nitems * sizeof(gp->gp_items[0]));
+    }
+}
+
+/**
+ * Compute the set of bytes that may follow the common prefix for pattern @p gp
+ *
+ * Byte 0 represents the end of the string.
+ */
+void gen_first_set(struct gen_pattern *gp)
+{
+    struct gen_item *gi = NULL;
+    size_t ii;
+    int c;
+
+    memset(gp->gp_first, 0, sizeof(gp->gp_first));
+
+    if (gp->gp_supported)
+    {
+        for (ii = 0; ii < gp->gp_nitems; ii++)
+        {
+            gi = &gp->gp_items[ii];
+            if ((gi->gi_type != GEN_CAP_OPEN) && (gi->gi_type != GEN_CAP_CLOSE)) break;
+            gi = NULL;
+        }
+    }
+
+    if ((gi != NULL) && (gi->gi_type == GEN_LIT))
+    {
+        GEN_SET(gp->gp_first, gi->gi_lit[0]);
+        return;
+    }
+
+    if ((gi != NULL) && ((gi->gi_type == GEN_CLASS) || (gi->gi_type == GEN_CLASS_PLUS)))
+    {
+        memcpy(gp->gp_first, gen_class[gi->gi_class], sizeof(gp->gp_first));
+        return;
+    }
+
+    /* Anything else (or unsupported patterns) may start with any byte */
+    for (c = 0; c < 256; c++)
+    {
+        if ((gi != NULL) && (gi->gi_type == GEN_ANY) && (c == '\n')) continue;
+        GEN_SET(gp->gp_first, c);
+    }
+}
+
+/**
+ * Write @p len bytes of @p str as a C string literal
+ */
+void gen_cstr(const char *str, size_t len)
+{
+    size_t ii;
+
+    putchar('"');
+
+    for (ii = 0; ii < len; ii++)
+    {
+        uint8_t c = str[ii];
+
+        if ((c == '"') || (c == '\\'))
+        {
+            printf("\\%c", c);
+        }
+        else if ((c < 0x20) || (c >= 0x7F))
+        {
+            printf("\\%03o", c);
+        }
+        else
+        {
+            putchar(c);
+        }
+    }
+
+    putchar('"');
+}
+
+/**
+ * Write @p str as a single line C comment, "*" followed by "/" is broken up
+ */
+void gen_comment(const char *str)
+{
+    printf("/* ");
+
+    for (; *str != '\0'; str++)
+    {
+        putchar(*str);
+        if ((str[0] == '*') && (str[1] == '/')) putchar(' ');
+    }
+
+    printf(" */\n");
+}
+
+/**
+ * Print the indentation for the nesting level @p level
+ */
+void gen_indent(int level)
+{
+    printf("%*s", 4 + level * 4, "");
+}
+
+/**
+ * Emit the code that matches the items of @p gp starting at @p idx
+ *
+ * Each gap opens a new nesting level: a loop that tries the gap lengths from the
+ * longest to the shortest, like PCRE does. The position at nesting level N is
+ * kept in the variable pN.
+ *
+ * @param[in]       gp          Pattern
+ * @param[in]       idx         Index of the first item to emit
+ * @param[in]       level       Current nesting level
+ */
+void gen_emit_items(struct gen_pattern *gp, size_t idx, int level)
+{
+    const char *fail = (level == 0) ? "return 0;" : "continue;";
+    struct gen_item *gi;
+
+    for (; idx < gp->gp_nitems; idx++)
+    {
+        gi = &gp->gp_items[idx];
+
+        switch (gi->gi_type)
+        {
+            case GEN_LIT:
+                gen_indent(level);
+                if (gi->gi_lit_len == 1)
+                {
+                    printf("if ((p%d >= end) || (*p%d != ", level, level);
+                    if (gi->gi_lit[0] == '\'' || gi->gi_lit[0] == '\\')
+                        printf("'\\%c'", gi->gi_lit[0]);
+                    else if (((uint8_t)gi->gi_lit[0] < 0x20) || ((uint8_t)gi->gi_lit[0] >= 0x7F))
+                        printf("'\\%03o'", (uint8_t)gi->gi_lit[0]);
+                    else
+                        printf("'%c'", gi->gi_lit[0]);
+                    printf(")) %s\n", fail);
+                }
+                else
+                {
+                    printf("if (((end - p%d) < %u) || (memcmp(p%d, ", level, (unsigned)gi->gi_lit_len, level);
+                    gen_cstr(gi->gi_lit, gi->gi_lit_len);
+                    printf(", %u) != 0)) %s\n", (unsigned)gi->gi_lit_len, fail);
+                }
+                gen_indent(level);
+                printf("p%d += %u;\n", level, (unsigned)gi->gi_lit_len);
+                break;
+
+            case GEN_ANY:
+                gen_indent(level);
+                printf("if ((p%d >= end) || (*p%d == '\\n')) %s\n", level, level, fail);
+                gen_indent(level);
+                printf("p%d++;\n", level);
+                break;
+
+            case GEN_CLASS:
+                gen_indent(level);
+                printf("if ((p%d >= end) || !RE_SCAN_IN(%d, *p%d)) %s\n", level, gi->gi_class, level, fail);
+                gen_indent(level);
+                printf("p%d++;\n", level);
+                break;
+
+            case GEN_CLASS_PLUS:
+                gen_indent(level);
+                printf("if ((p%d >= end) || !RE_SCAN_IN(%d, *p%d)) %s\n", level, gi->gi_class, level, fail);
+                gen_indent(level);
+                printf("do p%d++; while ((p%d < end) && RE_SCAN_IN(%d, *p%d));\n", level, level, gi->gi_class, level);
+                break;
+
+            case GEN_CAP_OPEN:
+                gen_indent(level);
+                printf("ovec[%d] = p%d - str;\n", gi->gi_group * 2, level);
+                break;
+
+            case GEN_CAP_CLOSE:
+                gen_indent(level);
+                printf("ovec[%d] = p%d - str;\n", gi->gi_group * 2 + 1, level);
+                break;
+
+            case GEN_DOLLAR:
+                gen_indent(level);
+                printf("if ((p%d != end) && !(((p%d + 1) == end) && (*p%d == '\\n'))) %s\n", level, level, level, fail);
+                break;
+
+            case GEN_GAP:
+                /* '.' doesn't match a new line, so the gap ends at the first one */
+                gen_indent(level);
+                printf("l%d = memchr(p%d, '\\n', end - p%d);\n", level, level, level);
+                gen_indent(level);
+                printf("if (l%d == NULL) l%d = end;\n", level, level);
+                gen_indent(level);
+                printf("for (g%d = l%d; g%d >= p%d; g%d--)\n", level, level, level, level, level);
+                gen_indent(level);
+                printf("{\n");
+                gen_indent(level + 1);
+                printf("p%d = g%d;\n", level + 1, level);
+
+                gen_emit_items(gp, idx + 1, level + 1);
+
+                gen_indent(level);
+                printf("}\n");
+                gen_indent(level);
+                printf("%s\n", fail);
+                return;
+        }
+    }
+
+    gen_indent(level);
+    printf("ovec[0] = 0;\n");
+    gen_indent(level);
+    printf("ovec[1] = p%d - str;\n", level);
+    gen_indent(level);
+    printf("return %d;\n", gp->gp_ngroups + 1);
+}
+
+/**
+ * Emit the match function for the pattern at index @p idx
+ */
+void gen_emit_pattern(size_t idx, size_t prefix_len)
+{
+    struct gen_pattern *gp = &gen_patterns[idx];
+    int ii;
+
+    gen_comment(re_aion[idx].re_exp);
+    printf("static int %s_%u(const char *str, const char *end, int *ovec)\n", GEN_SCAN_NAME, (unsigned)idx);
+    printf("{\n");
+
+    printf("    const char *p0 = str + %u;\n", (unsigned)prefix_len);
+    for (ii = 0; ii < gp->gp_ngaps; ii++)
+    {
+        printf("    const char *p%d;\n", ii + 1);
+        printf("    const char *g%d;\n", ii);
+        printf("    const char *l%d;\n", ii);
+    }
+    printf("\n");
+
+    gen_emit_items(gp, 0, 0);
+
+    printf("}\n\n");
+}
+
+/**
+ * Build the list of patterns that may match if byte @p c follows the prefix
+ *
+ * The list is in the table order and ends with the first unsupported pattern,
+ * the patterns after it are never tried.
+ *
+ * @return
+ * Number of patterns in @p list
+ */
+size_t gen_byte_list(int c, size_t *list)
+{
+    size_t list_num = 0;
+    size_t ii;
+
+    for (ii = 0; ii < gen_npatterns; ii++)
+    {
+        if (!GEN_ISSET(gen_patterns[ii].gp_first, c)) continue;
+
+        list[list_num++] = ii;
+        if (!gen_patterns[ii].gp_supported) break;
+    }
+
+    return list_num;
+}
+
+/**
+ * Emit the dispatch function
+ */
+void gen_emit_dispatch(const char *prefix, size_t prefix_len)
+{
+    static size_t list[GEN_PATTERNS_MAX];
+    static size_t other[GEN_PATTERNS_MAX];
+    bool done[256];
+    size_t list_num;
+    size_t ii;
+    int ncase;
+    int c;
+    int cc;
+
+    printf("/**\n");
+    printf(" * Match @p str against the @ref re_aion patterns\n");
+    printf(" *\n");
+    printf(" * @note @p str must be NUL terminated\n");
+    printf(" *\n");
+    printf(" * @see re_scan_t\n");
+    printf(" */\n");
+    printf("int %s(const char *str, int str_len, uint32_t lang, int *ovec, size_t *idx)\n", GEN_SCAN_NAME);
+    printf("{\n");
+    printf("    const char *end = str + str_len;\n");
+    printf("    int retval;\n");
+    printf("\n");
+
+    if (prefix_len > 0)
+    {
+        printf("    if ((str_len < %u) || (memcmp(str, ", (unsigned)prefix_len);
+        gen_cstr(prefix, prefix_len);
+        printf(", %u) != 0)) return 0;\n\n", (unsigned)prefix_len);
+    }
+
+    printf("    switch ((uint8_t)str[%u])\n", (unsigned)prefix_len);
+    printf("    {\n");
+
+    memset(done, 0, sizeof(done));
+
+    for (c = 0; c < 256; c++)
+    {
+        if (done[c]) continue;
+
+        list_num = gen_byte_list(c, list);
+        if (list_num == 0) continue;
+
+        /* Emit case labels for all bytes that have the same list */
+        ncase = 0;
+        for (cc = c; cc < 256; cc++)
+        {
+            if (done[cc]) continue;
+
+            if (gen_byte_list(cc, other) != list_num) continue;
+            if (memcmp(list, other, list_num * sizeof(list[0])) != 0) continue;
+
+            done[cc] = true;
+
+            if ((ncase % 8) == 0)
+            {
+                printf("%s        case 0x%02X:", (ncase == 0) ? "" : "\n", cc);
+            }
+            else
+            {
+                printf(" case 0x%02X:", cc);
+            }
+            ncase++;
+        }
+        printf("\n");
+
+        for (ii = 0; ii < list_num; ii++)
+        {
+            uint32_t lang = re_aion[list[ii]].re_lang;
+
+            if (!gen_patterns[list[ii]].gp_supported)
+            {
+                printf("            /* Left to PCRE */\n");
+                printf("            ");
+                gen_comment(re_aion[list[ii]].re_exp);
+                if (lang == 0)
+                {
+                    printf("            return -1;\n");
+                    break;
+                }
+
+                printf("            if (RE_LANG_MATCH(lang, 0x%02X)) return -1;\n", (unsigned)lang);
+                continue;
+            }
+
+            /* Patterns of inactive languages are skipped */
+            if (lang != 0)
+            {
+                printf("            if (RE_LANG_MATCH(lang, 0x%02X))\n", (unsigned)lang);
+                printf("            {\n");
+                printf("                retval = %s_%u(str, end, ovec);\n", GEN_SCAN_NAME, (unsigned)list[ii]);
+                printf("                if (retval > 0) { *idx = %u; return retval; }\n", (unsigned)list[ii]);
+                printf("            }\n");
+                continue;
+            }
+
+            printf("            retval = %s_%u(str, end, ovec);\n", GEN_SCAN_NAME, (unsigned)list[ii]);
+            printf("            if (retval > 0) { *idx = %u; return retval; }\n", (unsigned)list[ii]);
+        }
+
+        if (ii >= list_num)
+        {
+            printf("            break;\n");
+        }
+        printf("\n");
+    }
+
+    printf("        default:\n");
+    printf("            break;\n");
+    printf("    }\n");
+    printf("\n");
+    printf("    (void)retval;\n");
+    printf("\n");
+    printf("    return 0;\n");
+    printf("}\n");
+}
+
+/**
+ * Return a copy of the UTF-8 pattern @p exp converted to CP-1252
+ *
+ * Only the characters of the Latin1 range are supported, as in util_utf8_to_cp1252().
+ *
+ * @param[in]       exp         Pattern
+ *
+ * @return
+ * The converted pattern, or NULL if it has characters outside of CP-1252
+ */
+char *gen_native(const char *exp)
+{
+    const uint8_t *pin = (const uint8_t *)exp;
+    char *native;
+    char *pout;
+
+    native = malloc(strlen(exp) + 1);
+    if (native == NULL) return NULL;
+
+    for (pout = native; *pin != '\0'; )
+    {
+        if (*pin < 0x80)
+        {
+            *pout++ = *pin++;
+        }
+        else if (((pin[0] == 0xC2) || (pin[0] == 0xC3)) && ((pin[1] & 0xC0) == 0x80))
+        {
+            *pout++ = (pin[0] == 0xC2) ? pin[1] : pin[1] + 0x40;
+            pin += 2;
+        }
+        else
+        {
+            free(native);
+            return NULL;
+        }
+    }
+
+    *pout = '\0';
+
+    return native;
+}
+
+/**
+ * Generate the scanner for @ref re_aion and write it to stdout
+ */
+int main(int argc, char *argv[])
+{
+    struct regeng *reptr;
+    bool native = false;
+    const char *prefix = NULL;
+    const char *exp;
+    const char *raw;
+    size_t prefix_len = 0;
+    size_t raw_len;
+    size_t ii;
+    int cls;
+    int c;
+
+    if ((argc == 2) && (strcmp(argv[1], "-n") == 0))
+    {
+        native = true;
+    }
+    else if (argc != 1)
+    {
+        fprintf(stderr, "Usage: regeng_gen [-n]\n");
+        return 1;
+    }
+
+    /* Parse the patterns and compute the common literal prefix */
+    for (reptr = re_aion; RE_REGENG_VALID(reptr); reptr++)
+    {
+        struct gen_pattern *gp;
+
+        exp = reptr->re_exp;
+        if (native)
+        {
+            exp = gen_native(reptr->re_exp);
+            if (exp == NULL)
+            {
+                fprintf(stderr, "regeng_gen: Unable to convert '%s' to CP-1252\n", reptr->re_exp);
+                return 1;
+            }
+        }
+
+        if (gen_npatterns >= GEN_PATTERNS_MAX)
+        {
+            fprintf(stderr, "regeng_gen: Too many patterns\n");
+            return 1;
+        }
+
+        gp = &gen_patterns[gen_npatterns++];
+
+        gp->gp_supported = gen_parse(exp, gp) && gen_check_greedy(gp);
+        if (!gp->gp_supported)
+        {
+            fprintf(stderr, "regeng_gen: Leaving '%s' to PCRE\n", reptr->re_exp);
+        }
+
+        raw_len = gen_raw_prefix(exp, &raw);
+        if (prefix == NULL)
+        {
+            prefix = raw;
+            prefix_len = raw_len;
+            continue;
+        }
+
+        for (ii = 0; (ii < prefix_len) && (ii < raw_len) && (prefix[ii] == raw[ii]); ii++);
+        prefix_len = ii;
+    }
+
+    for (ii = 0; ii < gen_npatterns; ii++)
+    {
+        if (gen_patterns[ii].gp_supported)
+        {
+            gen_strip_prefix(&gen_patterns[ii], prefix_len);
+        }
+
+        gen_first_set(&gen_patterns[ii]);
+    }
+
+    printf("/*\n");
+    printf(" * chatlog_scan.c - Generated by regeng_gen from re_aion[]%s, do not edit.\n", native ? " for CP-1252" : "");
+    printf(" */\n");
+    printf("#include <stdint.h>\n");
+    printf("#include <stdbool.h>\n");
+    printf("#include <stdlib.h>\n");
+    printf("#include <string.h>\n");
+    printf("\n");
+    printf("#include \"regeng.h\"\n");
+    printf("#include \"chatlog_re.h\"\n");
+    printf("\n");
+
+    if (gen_nclass > 0)
+    {
+        printf("static const uint8_t re_scan_class[%d][32] =\n{\n", gen_nclass);
+        for (cls = 0; cls < gen_nclass; cls++)
+        {
+            printf("    {");
+            for (c = 0; c < 32; c++)
+            {
+                printf(" 0x%02X,", gen_class[cls][c]);
+            }
+            printf(" },\n");
+        }
+        printf("};\n\n");
+        printf("#define RE_SCAN_IN(cls, c)  (re_scan_class[cls][(uint8_t)(c) >> 3] & (1 << ((uint8_t)(c) & 7)))\n\n");
+    }
+
+    for (ii = 0; ii < gen_npatterns; ii++)
+    {
+        if (gen_patterns[ii].gp_supported)
+        {
+            gen_emit_pattern(ii, prefix_len);
+        }
+    }
+
+    gen_emit_dispatch(prefix, prefix_len);
+
+    return 0;
+}
+
+/**
+ * @}
+ */
@@ -37,12 +37,18 @@
  * Text buffers are simple fixed-size buffers that can hold
  * variable lenght strings.
  *
- * Text buffers are mainly used for the debug console and for
- * the chat history.
+ * Text buffers are mainly used for the debug console.
+ *
+ * The location of each string is kept in a ring next to the text, so
+ * strings are counted, retrieved and trimmed without scanning the text.
+ * Only strings stored with tb_strput() are indexed. If the ring is full,
+ * the oldest string is trimmed.
  *
  * @{
  */
 
+static bool tb_strnput(struct txtbuf *tb, const char *str, size_t str_len);
+
 /**
  * Initialize a text buffer structure
  *
@@ -56,6 +62,9 @@ void tb_init(struct txtbuf *tb, char *txt, size_t txt_sz)
     tb->tb_tail = 0;
     tb->tb_text = txt;
     tb->tb_size = txt_sz;
+
+    tb->tb_str_head = 0;
+    tb->tb_str_num = 0;
 }
 
 /**
@@ -143,17 +152,14 @@ bool tb_put(struct txtbuf *tb, void *buf, size_t buf_sz)
  */
 void tb_strtrim(struct txtbuf *tb)
 {
-    size_t ii;
-
-    for (ii = tb->tb_head; ii < tb->tb_tail; ii++)
+    if (tb->tb_str_num == 0)
     {
-        if (tb->tb_text[ii % tb->tb_size] == '\0') break;
+        return;
     }
 
-    if (ii < tb->tb_tail)
-    {
-        tb->tb_head = ii + 1;
-    }
+    tb->tb_head += tb->tb_str[tb->tb_str_head].ts_len + 1;
+    tb->tb_str_head = (tb->tb_str_head + 1) & (TB_STR_MAX - 1);
+    tb->tb_str_num--;
 
     /* Keep the tail and head low */
     if (tb->tb_head >= tb->tb_size)
@@ -166,7 +172,9 @@ void tb_strtrim(struct txtbuf *tb)
 /**
  * Store a string into a text buffer
  *
- * @note This function removes old strings if there's not enough space
+ * @note This function removes old strings if there's not enough space, or if
+ * there are TB_STR_MAX strings already; so no more than TB_STR_MAX strings,
+ * for example console lines, are kept regardless of the buffer size.
  *
  * @param[in]       tb      A text buffer
  * @param[in]       str     A string
@@ -176,7 +184,25 @@ void tb_strtrim(struct txtbuf *tb)
  */
 bool tb_strput(struct txtbuf *tb, char *str)
 {
-    size_t str_len = strlen(str);
+    return tb_strnput(tb, str, strlen(str));
+}
+
+/**
+ * Store a string of length @p str_len into a text buffer
+ *
+ * Same as tb_strput(), but @p str doesn't have to be NUL terminated.
+ *
+ * @param[in]       tb      A text buffer
+ * @param[in]       str     A string
+ * @param[in]       str_len Number of characters in @p str
+ *
+ * @retval          true    If the string was successfully stored
+ * @retval          false   If string is larget than the textbuffer total size
+ */
+bool tb_strnput(struct txtbuf *tb, const char *str, size_t str_len)
+{
+    struct txtbuf_str *ts;
+    size_t str_off;
 
     /* Crop the string to the maximum lenght of the buffer */
     if ((str_len + sizeof(char)) > tb->tb_size)
@@ -184,14 +210,16 @@ bool tb_strput(struct txtbuf *tb, char *str)
         str_len = tb->tb_size - 1;
     }
 
-    while (tb_free(tb) < (str_len + 1))
+    while ((tb_free(tb) < (str_len + 1)) || (tb->tb_str_num >= TB_STR_MAX))
     {
         /* Remove strings from the buffer until we can fit it all */
         tb_strtrim(tb);
     }
 
+    str_off = tb->tb_tail % tb->tb_size;
+
     /* Put stirng without '\0' */
-    if (!tb_put(tb, str, str_len))
+    if (!tb_put(tb, (void *)str, str_len))
     {
         return false;
     }
@@ -202,6 +230,11 @@ bool tb_strput(struct txtbuf *tb, char *str)
         return false;
     }
 
+    ts = &tb->tb_str[(tb->tb_str_head + tb->tb_str_num) & (TB_STR_MAX - 1)];
+    ts->ts_off = str_off;
+    ts->ts_len = str_len;
+    tb->tb_str_num++;
+
     return true;
 }
 
@@ -215,16 +248,7 @@ bool tb_strput(struct txtbuf *tb, char *str)
  */
 int tb_strnum(struct txtbuf *tb)
 {
-    size_t ii;
-
-    int nstr = 0;
-
-    for (ii = tb->tb_head; ii < tb->tb_tail; ii++)
-    {
-        if (tb->tb_text[ii % tb->tb_size] == '\0') nstr++;
-    }
-
-    return nstr;
+    return (int)tb->tb_str_num;
 }
 
 
@@ -245,33 +269,18 @@ int tb_strnum(struct txtbuf *tb)
  */
 bool tb_strget(struct txtbuf *tb, int index, char *dst, size_t dst_sz)
 {
+    struct txtbuf_str *ts;
     size_t str_start;
-    size_t str_end;
     size_t str_sz;
     size_t tb_off;
 
-    int nstr = 0;
-
-    /* Find the end of the string */
-    str_start = tb->tb_head;
-
-    for (str_end = tb->tb_head; str_end < tb->tb_tail; str_end++)
-    {
-        if (tb->tb_text[str_end % tb->tb_size] == '\0')
-        {
-            if (nstr == index) break;
-            nstr++;
-
-            /* skip this '\0', and start pointing at the beginning of the next string */
-            str_start = str_end + 1;
-        }
-    }
-    
     /* Not found? */
-    if (str_end == tb->tb_tail) return false;
+    if ((index < 0) || ((size_t)index >= tb->tb_str_num)) return false;
+
+    ts = &tb->tb_str[(tb->tb_str_head + index) & (TB_STR_MAX - 1)];
 
-    /* str_start should point to the first char of the string, while str_end points to the '\0' */
-    str_sz = str_end - str_start;
+    str_start = ts->ts_off;
+    str_sz = ts->ts_len;
 
     if (str_sz >= dst_sz)
     {
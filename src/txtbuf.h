@@ -34,6 +34,16 @@
  * @{
  */
 
+/** Maximum number of strings in a text buffer, must be a power of 2 */
+#define TB_STR_MAX  512
+
+/** Location of a string in the text buffer */
+struct txtbuf_str
+{
+    size_t  ts_off;         /**< Offset of the first character  */
+    size_t  ts_len;         /**< Length, without the '\0'       */
+};
+
 /** Text buffer structure */
 struct txtbuf
 {
@@ -41,6 +51,9 @@ struct txtbuf
     size_t  tb_head;        /**< Text buffer head pointer       */
     size_t  tb_tail;        /**< Text buffer tail pointer       */
     char    *tb_text;       /**< Text buffer data               */
+    size_t  tb_str_head;    /**< Index of the oldest string     */
+    size_t  tb_str_num;     /**< Number of strings              */
+    struct txtbuf_str tb_str[TB_STR_MAX];   /**< Strings, a ring */
 };
 
 extern void tb_init(struct txtbuf *tb, char *txt, size_t txt_sz);
@@ -34,20 +34,34 @@
 #include <winnt.h>
 #include <aclapi.h>
 #include <shlobj.h>
+#include <io.h>
 
 #else /* UNIX */
 
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <glob.h>
 
 #endif
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+/** The ASCII scanner has SSE2/AVX2 versions selected at run-time */
+#define UTIL_ASCII_SIMD
+#include <immintrin.h>
+#endif
+
 #include "util.h"
 #include "console.h"
 #include "event.h"
@@ -61,6 +75,12 @@
  * @{
  */
 
+/** Initial size of the sys_glob() file list, it's doubled whenever it's full */
+#define SYS_GLOB_MIN    16
+
+static bool sys_glob_add(char ***files, size_t *nfiles, const char *dir, const char *name);
+static int sys_glob_cmp(const void *a, const void *b);
+
 #ifdef SYS_WINDOWS
 /**
  * Copy @p text to the clipboard
@@ -599,6 +619,269 @@ uint64_t sys_monotime(void)
     return GetTickCount64();
 }
 
+/**
+ * Return some sort of monotonic time in nanoseconds
+ *
+ * This uses the performance counter, so it's suitable for measuring
+ * short intervals.
+ *
+ * @return
+ * This function returns a 64-bit timer, the resolution is in nanoseconds
+ */
+uint64_t sys_monotime_ns(void)
+{
+    static LARGE_INTEGER freq = { .QuadPart = 0 };
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+
+    QueryPerformanceCounter(&count);
+
+    /* Split the conversion to avoid overflowing 64-bits */
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000ULL +
+           (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000ULL / freq.QuadPart;
+}
+
+/**
+ * Map the file @p path to memory, read-only
+ *
+ * The file is opened with FILE_FLAG_SEQUENTIAL_SCAN, so the cache manager reads
+ * ahead aggressively. Use sys_munmap() to release the mapping.
+ *
+ * @param[in]       path        Path of the file to map
+ * @param[out]      len         Length of the mapping
+ *
+ * @return
+ * Pointer to the mapped file or NULL on error; empty files are not mapped
+ */
+void *sys_mmap(char *path, size_t *len)
+{
+    LARGE_INTEGER fsize;
+    HANDLE hfile;
+    HANDLE hmap;
+    void *map;
+
+    hfile = CreateFile(path,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN,
+                       NULL);
+    if (hfile == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    /* The whole file must fit into the address space */
+    if (!GetFileSizeEx(hfile, &fsize) || (fsize.QuadPart == 0) || ((uint64_t)fsize.QuadPart > SIZE_MAX))
+    {
+        CloseHandle(hfile);
+        return NULL;
+    }
+
+    /* The view keeps a reference to the mapping and the file, the handles can be closed */
+    hmap = CreateFileMapping(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hfile);
+    if (hmap == NULL)
+    {
+        return NULL;
+    }
+
+    map = MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hmap);
+    if (map == NULL)
+    {
+        return NULL;
+    }
+
+    *len = fsize.QuadPart;
+
+    return map;
+}
+
+/**
+ * Release a mapping created with sys_mmap()
+ *
+ * @param[in]       map         Pointer returned by sys_mmap()
+ * @param[in]       len         Length of the mapping
+ */
+void sys_munmap(void *map, size_t len)
+{
+    (void)len;
+
+    UnmapViewOfFile(map);
+}
+
+/**
+ * Retrieve the identity and state of the open file @p f
+ *
+ * This is used to find out if a file was replaced or truncated.
+ *
+ * @param[in]       f           Open file
+ * @param[out]      sf          File information
+ *
+ * @retval          true        On success
+ * @retval          false       On error
+ */
+bool sys_fstat(FILE *f, struct sys_fstat *sf)
+{
+    BY_HANDLE_FILE_INFORMATION info;
+    HANDLE hfile;
+
+    hfile = (HANDLE)_get_osfhandle(_fileno(f));
+    if (hfile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    if (!GetFileInformationByHandle(hfile, &info))
+    {
+        return false;
+    }
+
+    sf->sf_id = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+    sf->sf_size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    sf->sf_mtime = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+
+    return true;
+}
+
+/**
+ * Seek to the absolute position @p offset, files larger than 2GB are supported
+ *
+ * @param[in]       f           Open file
+ * @param[in]       offset      Offset from the start of the file
+ *
+ * @retval          true        On success
+ * @retval          false       On error
+ */
+bool sys_fseek(FILE *f, uint64_t offset)
+{
+    return _fseeki64(f, offset, SEEK_SET) == 0;
+}
+
+/**
+ * Rename the file @p src to @p dst, replacing @p dst if it exists
+ *
+ * The replacement is atomic, @p dst is either the old or the new file.
+ *
+ * @param[in]       src         Current path
+ * @param[in]       dst         New path
+ *
+ * @retval          true        On success
+ * @retval          false       On error
+ */
+bool sys_rename(const char *src, const char *dst)
+{
+    return MoveFileEx(src, dst, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+/**
+ * List the files in the directory @p pattern, or the files that match the
+ * wildcard pattern @p pattern
+ *
+ * Sub-directories are skipped. The list is sorted by name and must be released
+ * with sys_glob_free().
+ *
+ * @param[in]       pattern     Directory or wildcard pattern, for example "C:\\Logs\\*.log"
+ * @param[out]      files       Paths of the files
+ * @param[out]      nfiles      Number of elements in @p files
+ *
+ * @retval          true        On success, even if no file was found
+ * @retval          false       On error
+ */
+bool sys_glob(char *pattern, char ***files, size_t *nfiles)
+{
+    char search[UTIL_MAX_PATH];
+    char dir[UTIL_MAX_PATH];
+    WIN32_FIND_DATA fd;
+    HANDLE hfind;
+    DWORD attr;
+    char *pdir;
+    bool retval;
+
+    *files = NULL;
+    *nfiles = 0;
+
+    attr = GetFileAttributes(pattern);
+    if ((attr != INVALID_FILE_ATTRIBUTES) && (attr & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        util_strlcpy(dir, pattern, sizeof(dir));
+        util_strlcat(dir, "\\", sizeof(dir));
+        util_strlcpy(search, dir, sizeof(search));
+        util_strlcat(search, "*", sizeof(search));
+    }
+    else
+    {
+        util_strlcpy(search, pattern, sizeof(search));
+        util_strlcpy(dir, pattern, sizeof(dir));
+
+        /* The directory part of the pattern, FindFirstFile() returns only the names */
+        pdir = strrchr(dir, '\\');
+        if ((pdir == NULL) || (strrchr(dir, '/') > pdir)) pdir = strrchr(dir, '/');
+
+        if (pdir != NULL)
+        {
+            pdir[1] = '\0';
+        }
+        else
+        {
+            dir[0] = '\0';
+        }
+    }
+
+    hfind = FindFirstFile(search, &fd);
+    if (hfind == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+    }
+
+    retval = true;
+
+    do
+    {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+        if (!sys_glob_add(files, nfiles, dir, fd.cFileName))
+        {
+            retval = false;
+            break;
+        }
+    }
+    while (FindNextFile(hfind, &fd));
+
+    FindClose(hfind);
+
+    if (!retval)
+    {
+        sys_glob_free(*files, *nfiles);
+        return false;
+    }
+
+    qsort(*files, *nfiles, sizeof(char *), sys_glob_cmp);
+
+    return true;
+}
+
+/**
+ * Return the number of processors
+ *
+ * @return
+ * Number of logical processors, at least 1
+ */
+unsigned sys_ncpu(void)
+{
+    SYSTEM_INFO si;
+
+    GetSystemInfo(&si);
+
+    return (si.dwNumberOfProcessors > 0) ? si.dwNumberOfProcessors : 1;
+}
+
 #else /* Unix */
 
 /**
@@ -609,7 +892,7 @@ bool clipboard_set_text(char *text)
     FILE *clipboard;
 
     /* On unix, just read from the clipboard.txt file :) */
-    clipboard = fopen("clipboard.txt", "w+");
+    clipboard = fopen(UTIL_CLIPBOARD_FILE, "w+");
     if (clipboard != NULL)
     {
         fputs(text, clipboard);
@@ -627,7 +910,7 @@ bool clipboard_get_text(char *text, size_t text_sz)
     *text = '\0';
 
     /* On unix, just read from the clipboard.txt file :) */
-    clipboard = fopen("clipboard.txt", "r");
+    clipboard = fopen(UTIL_CLIPBOARD_FILE, "r");
     if (clipboard != NULL)
     {
         if (fgets(text, text_sz, clipboard) == NULL)
@@ -703,12 +986,247 @@ uint64_t sys_monotime(void)
     return (uint64_t)tv.tv_sec * 1000  + (uint64_t)tv.tv_nsec / 1000000;
 }
 
+uint64_t sys_monotime_ns(void)
+{
+    struct timespec tv;
+
+    clock_gettime(CLOCK_MONOTONIC, &tv);
+
+    return (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_nsec;
+}
+
+void *sys_mmap(char *path, size_t *len)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0) || ((uint64_t)st.st_size > SIZE_MAX))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    /* Read ahead aggressively and drop the pages soon after they were read */
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    *len = st.st_size;
+
+    return map;
+}
+
+void sys_munmap(void *map, size_t len)
+{
+    munmap(map, len);
+}
+
+bool sys_fstat(FILE *f, struct sys_fstat *sf)
+{
+    struct stat st;
+
+    if (fstat(fileno(f), &st) != 0)
+    {
+        return false;
+    }
+
+    sf->sf_id = st.st_ino;
+    sf->sf_size = st.st_size;
+    sf->sf_mtime = st.st_mtime;
+
+    return true;
+}
+
+bool sys_fseek(FILE *f, uint64_t offset)
+{
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+}
+
+bool sys_rename(const char *src, const char *dst)
+{
+    return rename(src, dst) == 0;
+}
+
+bool sys_glob(char *pattern, char ***files, size_t *nfiles)
+{
+    char path[UTIL_MAX_PATH];
+    struct dirent *de;
+    struct stat st;
+    glob_t gl;
+    DIR *dirp;
+    bool retval;
+    size_t ii;
+    int rc;
+
+    *files = NULL;
+    *nfiles = 0;
+
+    retval = true;
+
+    if ((stat(pattern, &st) == 0) && S_ISDIR(st.st_mode))
+    {
+        dirp = opendir(pattern);
+        if (dirp == NULL)
+        {
+            return false;
+        }
+
+        while ((de = readdir(dirp)) != NULL)
+        {
+            snprintf(path, sizeof(path), "%s/%s", pattern, de->d_name);
+            if ((stat(path, &st) != 0) || !S_ISREG(st.st_mode)) continue;
+
+            if (!sys_glob_add(files, nfiles, "", path))
+            {
+                retval = false;
+                break;
+            }
+        }
+
+        closedir(dirp);
+    }
+    else
+    {
+        rc = glob(pattern, 0, NULL, &gl);
+        if (rc == GLOB_NOMATCH)
+        {
+            return true;
+        }
+
+        if (rc != 0)
+        {
+            return false;
+        }
+
+        for (ii = 0; ii < gl.gl_pathc; ii++)
+        {
+            if ((stat(gl.gl_pathv[ii], &st) != 0) || !S_ISREG(st.st_mode)) continue;
+
+            if (!sys_glob_add(files, nfiles, "", gl.gl_pathv[ii]))
+            {
+                retval = false;
+                break;
+            }
+        }
+
+        globfree(&gl);
+    }
+
+    if (!retval)
+    {
+        sys_glob_free(*files, *nfiles);
+        return false;
+    }
+
+    qsort(*files, *nfiles, sizeof(char *), sys_glob_cmp);
+
+    return true;
+}
+
+unsigned sys_ncpu(void)
+{
+    long ncpu;
+
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (ncpu > 0) ? (unsigned)ncpu : 1;
+}
+
 /**
  * @endcond
  */
 
 #endif
 
+/**
+ * Append the path @p dir + @p name to the file list of sys_glob()
+ *
+ * The list is not resized for every file, its size is always SYS_GLOB_MIN or
+ * a power of two, so it's grown when @p nfiles reaches one of them.
+ *
+ * @param[in,out]   files       File list
+ * @param[in,out]   nfiles      Number of elements in @p files
+ * @param[in]       dir         Directory, including the trailing separator
+ * @param[in]       name        File name
+ *
+ * @retval          true        On success
+ * @retval          false       On memory allocation error
+ */
+bool sys_glob_add(char ***files, size_t *nfiles, const char *dir, const char *name)
+{
+    char **pfiles;
+    size_t path_sz;
+    size_t nalloc;
+    char *path;
+
+    path_sz = strlen(dir) + strlen(name) + 1;
+
+    path = malloc(path_sz);
+    if (path == NULL)
+    {
+        return false;
+    }
+
+    util_strlcpy(path, dir, path_sz);
+    util_strlcat(path, name, path_sz);
+
+    if ((*nfiles < SYS_GLOB_MIN) ? (*nfiles == 0) : ((*nfiles & (*nfiles - 1)) == 0))
+    {
+        nalloc = (*nfiles == 0) ? SYS_GLOB_MIN : (*nfiles * 2);
+
+        pfiles = realloc(*files, nalloc * sizeof(char *));
+        if (pfiles == NULL)
+        {
+            free(path);
+            return false;
+        }
+
+        *files = pfiles;
+    }
+
+    (*files)[(*nfiles)++] = path;
+
+    return true;
+}
+
+/**
+ * Compare two paths for qsort()
+ */
+int sys_glob_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/**
+ * Release the file list returned by sys_glob()
+ *
+ * @param[in]       files       File list
+ * @param[in]       nfiles      Number of elements in @p files
+ */
+void sys_glob_free(char **files, size_t nfiles)
+{
+    size_t ii;
+
+    for (ii = 0; ii < nfiles; ii++)
+    {
+        free(files[ii]);
+    }
+
+    free(files);
+}
+
 /**
  * This is a safe string copy function, it never overflows. In the *BSD world it's know as strlcpy().
  *
@@ -876,6 +1394,260 @@ void util_chomp(char *str)
     }
 }
 
+/**
+ * @name ASCII scanner
+ *
+ * Almost all chatlog lines are pure ASCII, the scanner finds the first byte above
+ * 0x7F in blocks of 16 (SSE2) or 32 (AVX2) bytes. The best version is selected by
+ * util_init(), so the binary still runs on CPUs without AVX2.
+ *
+ * @{
+ */
+static size_t util_ascii_len_scalar(const char *str, size_t str_len);
+#ifdef UTIL_ASCII_SIMD
+static size_t util_ascii_len_sse2(const char *str, size_t str_len) __attribute__((target("sse2")));
+static size_t util_ascii_len_avx2(const char *str, size_t str_len) __attribute__((target("avx2")));
+#endif
+
+/** The selected ASCII scanner, set by util_init() before any thread is started */
+static size_t (*util_ascii_len_func)(const char *str, size_t str_len) = util_ascii_len_scalar;
+
+/**
+ * Portable version of util_ascii_len(), checks 8 bytes at a time
+ */
+size_t util_ascii_len_scalar(const char *str, size_t str_len)
+{
+    uint64_t word;
+    size_t ii;
+
+    for (ii = 0; (ii + sizeof(word)) <= str_len; ii += sizeof(word))
+    {
+        memcpy(&word, str + ii, sizeof(word));
+        if ((word & 0x8080808080808080ULL) != 0) break;
+    }
+
+    for (; ii < str_len; ii++)
+    {
+        if (((unsigned char)str[ii]) >= 0x80) break;
+    }
+
+    return ii;
+}
+
+#ifdef UTIL_ASCII_SIMD
+/**
+ * SSE2 version of util_ascii_len(), the sign bits of 16 bytes are collected with PMOVMSKB
+ */
+size_t util_ascii_len_sse2(const char *str, size_t str_len)
+{
+    size_t ii;
+    int mask;
+
+    for (ii = 0; (ii + 16) <= str_len; ii += 16)
+    {
+        mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(str + ii)));
+        if (mask != 0)
+        {
+            return ii + __builtin_ctz(mask);
+        }
+    }
+
+    return ii + util_ascii_len_scalar(str + ii, str_len - ii);
+}
+
+/**
+ * AVX2 version of util_ascii_len(), 32 bytes at a time
+ */
+size_t util_ascii_len_avx2(const char *str, size_t str_len)
+{
+    size_t ii;
+    uint32_t mask;
+
+    for (ii = 0; (ii + 32) <= str_len; ii += 32)
+    {
+        mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(str + ii)));
+        if (mask != 0)
+        {
+            return ii + __builtin_ctz(mask);
+        }
+    }
+
+    return ii + util_ascii_len_scalar(str + ii, str_len - ii);
+}
+#endif
+
+/**
+ * Return the length of the pure ASCII prefix of @p str
+ *
+ * If the return value is equal to @p str_len, the string is already valid UTF-8
+ * and doesn't need to be converted with util_cp1252_to_utf8().
+ *
+ * @param[in]       str         Input string
+ * @param[in]       str_len     Length of @p str
+ *
+ * @return
+ * Number of bytes before the first byte with the high bit set
+ */
+size_t util_ascii_len(const char *str, size_t str_len)
+{
+    return util_ascii_len_func(str, str_len);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @name Byte search
+ *
+ * memchr() replacement used to split the chatlog into lines, 16 (SSE2) or 32 (AVX2)
+ * bytes are compared at a time. The C library version is used for the tail and on
+ * CPUs without SSE2, the Windows C runtime memchr() is a plain byte loop. The
+ * version is selected by util_init().
+ *
+ * @{
+ */
+#ifdef UTIL_ASCII_SIMD
+static void *util_memchr_sse2(const void *buf, int c, size_t buf_len) __attribute__((target("sse2")));
+static void *util_memchr_avx2(const void *buf, int c, size_t buf_len) __attribute__((target("avx2")));
+#endif
+
+/** The selected byte search function, set by util_init() before any thread is started */
+static void *(*util_memchr_func)(const void *buf, int c, size_t buf_len) = memchr;
+
+/** True if the CPU supports SSSE3, set by util_init(); see util_cpu_ssse3() */
+static bool util_ssse3 = false;
+
+#ifdef UTIL_ASCII_SIMD
+/**
+ * SSE2 version of util_memchr()
+ */
+void *util_memchr_sse2(const void *buf, int c, size_t buf_len)
+{
+    const char *str = buf;
+    __m128i needle;
+    size_t ii;
+    int mask;
+
+    needle = _mm_set1_epi8((char)c);
+
+    for (ii = 0; (ii + 16) <= buf_len; ii += 16)
+    {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(str + ii)), needle));
+        if (mask != 0)
+        {
+            return (void *)(str + ii + __builtin_ctz(mask));
+        }
+    }
+
+    return memchr(str + ii, c, buf_len - ii);
+}
+
+/**
+ * AVX2 version of util_memchr()
+ */
+void *util_memchr_avx2(const void *buf, int c, size_t buf_len)
+{
+    const char *str = buf;
+    __m256i needle;
+    uint32_t mask;
+    size_t ii;
+
+    needle = _mm256_set1_epi8((char)c);
+
+    for (ii = 0; (ii + 32) <= buf_len; ii += 32)
+    {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(str + ii)), needle));
+        if (mask != 0)
+        {
+            return (void *)(str + ii + __builtin_ctz(mask));
+        }
+    }
+
+    return memchr(str + ii, c, buf_len - ii);
+}
+#endif
+
+/**
+ * Find the first occurrence of the byte @p c in @p buf, same as memchr()
+ *
+ * @param[in]       buf         Buffer to search
+ * @param[in]       c           Byte to find
+ * @param[in]       buf_len     Length of @p buf
+ *
+ * @return
+ * Pointer to the first @p c in @p buf or NULL if not found
+ */
+void *util_memchr(const void *buf, int c, size_t buf_len)
+{
+    return util_memchr_func(buf, c, buf_len);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * Check if the CPU supports SSSE3, used to select the regeng prefilter
+ *
+ * @retval      true        If util_init() found SSSE3
+ * @retval      false       If not, or util_init() was not called yet
+ */
+bool util_cpu_ssse3(void)
+{
+    return util_ssse3;
+}
+
+/**
+ * Select the ASCII scanner and the byte search function for this CPU
+ *
+ * The CPU is probed once, this must be called at startup before any thread
+ * is started. Until then the portable versions are used.
+ */
+void util_init(void)
+{
+#ifdef UTIL_ASCII_SIMD
+    __builtin_cpu_init();
+
+    util_ssse3 = __builtin_cpu_supports("ssse3");
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        util_ascii_len_func = util_ascii_len_avx2;
+        util_memchr_func = util_memchr_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        util_ascii_len_func = util_ascii_len_sse2;
+        util_memchr_func = util_memchr_sse2;
+    }
+#endif
+}
+
+/**
+ * UTF-8 sequences of the CP-1252 bytes 0x80 - 0xFF, each one is 2 bytes long.
+ * The 0x80 - 0x9F range is mapped the same as in Latin1.
+ */
+static const char util_cp1252_utf8[128][2] =
+{
+    { '\xC2', '\x80' }, { '\xC2', '\x81' }, { '\xC2', '\x82' }, { '\xC2', '\x83' }, { '\xC2', '\x84' }, { '\xC2', '\x85' }, { '\xC2', '\x86' }, { '\xC2', '\x87' },
+    { '\xC2', '\x88' }, { '\xC2', '\x89' }, { '\xC2', '\x8A' }, { '\xC2', '\x8B' }, { '\xC2', '\x8C' }, { '\xC2', '\x8D' }, { '\xC2', '\x8E' }, { '\xC2', '\x8F' },
+    { '\xC2', '\x90' }, { '\xC2', '\x91' }, { '\xC2', '\x92' }, { '\xC2', '\x93' }, { '\xC2', '\x94' }, { '\xC2', '\x95' }, { '\xC2', '\x96' }, { '\xC2', '\x97' },
+    { '\xC2', '\x98' }, { '\xC2', '\x99' }, { '\xC2', '\x9A' }, { '\xC2', '\x9B' }, { '\xC2', '\x9C' }, { '\xC2', '\x9D' }, { '\xC2', '\x9E' }, { '\xC2', '\x9F' },
+    { '\xC2', '\xA0' }, { '\xC2', '\xA1' }, { '\xC2', '\xA2' }, { '\xC2', '\xA3' }, { '\xC2', '\xA4' }, { '\xC2', '\xA5' }, { '\xC2', '\xA6' }, { '\xC2', '\xA7' },
+    { '\xC2', '\xA8' }, { '\xC2', '\xA9' }, { '\xC2', '\xAA' }, { '\xC2', '\xAB' }, { '\xC2', '\xAC' }, { '\xC2', '\xAD' }, { '\xC2', '\xAE' }, { '\xC2', '\xAF' },
+    { '\xC2', '\xB0' }, { '\xC2', '\xB1' }, { '\xC2', '\xB2' }, { '\xC2', '\xB3' }, { '\xC2', '\xB4' }, { '\xC2', '\xB5' }, { '\xC2', '\xB6' }, { '\xC2', '\xB7' },
+    { '\xC2', '\xB8' }, { '\xC2', '\xB9' }, { '\xC2', '\xBA' }, { '\xC2', '\xBB' }, { '\xC2', '\xBC' }, { '\xC2', '\xBD' }, { '\xC2', '\xBE' }, { '\xC2', '\xBF' },
+    { '\xC3', '\x80' }, { '\xC3', '\x81' }, { '\xC3', '\x82' }, { '\xC3', '\x83' }, { '\xC3', '\x84' }, { '\xC3', '\x85' }, { '\xC3', '\x86' }, { '\xC3', '\x87' },
+    { '\xC3', '\x88' }, { '\xC3', '\x89' }, { '\xC3', '\x8A' }, { '\xC3', '\x8B' }, { '\xC3', '\x8C' }, { '\xC3', '\x8D' }, { '\xC3', '\x8E' }, { '\xC3', '\x8F' },
+    { '\xC3', '\x90' }, { '\xC3', '\x91' }, { '\xC3', '\x92' }, { '\xC3', '\x93' }, { '\xC3', '\x94' }, { '\xC3', '\x95' }, { '\xC3', '\x96' }, { '\xC3', '\x97' },
+    { '\xC3', '\x98' }, { '\xC3', '\x99' }, { '\xC3', '\x9A' }, { '\xC3', '\x9B' }, { '\xC3', '\x9C' }, { '\xC3', '\x9D' }, { '\xC3', '\x9E' }, { '\xC3', '\x9F' },
+    { '\xC3', '\xA0' }, { '\xC3', '\xA1' }, { '\xC3', '\xA2' }, { '\xC3', '\xA3' }, { '\xC3', '\xA4' }, { '\xC3', '\xA5' }, { '\xC3', '\xA6' }, { '\xC3', '\xA7' },
+    { '\xC3', '\xA8' }, { '\xC3', '\xA9' }, { '\xC3', '\xAA' }, { '\xC3', '\xAB' }, { '\xC3', '\xAC' }, { '\xC3', '\xAD' }, { '\xC3', '\xAE' }, { '\xC3', '\xAF' },
+    { '\xC3', '\xB0' }, { '\xC3', '\xB1' }, { '\xC3', '\xB2' }, { '\xC3', '\xB3' }, { '\xC3', '\xB4' }, { '\xC3', '\xB5' }, { '\xC3', '\xB6' }, { '\xC3', '\xB7' },
+    { '\xC3', '\xB8' }, { '\xC3', '\xB9' }, { '\xC3', '\xBA' }, { '\xC3', '\xBB' }, { '\xC3', '\xBC' }, { '\xC3', '\xBD' }, { '\xC3', '\xBE' }, { '\xC3', '\xBF' },
+};
+
 /**
  * Convert a string from the CP-1252(aka Windows-1252, Latin1) codeset
  * to UTF8, yay!
@@ -886,32 +1658,105 @@ void util_chomp(char *str)
  */
 void util_cp1252_to_utf8(char *utf8, ssize_t utf8_sz, char *cp1252)
 {
-    char *putf8 = utf8;
-    char *pcp1252;
+    util_cp1252_to_utf8n(utf8, utf8_sz, cp1252, strlen(cp1252));
+}
+
+/**
+ * Convert @p cp1252_len bytes from the CP-1252 codeset to UTF8
+ *
+ * Runs of ASCII characters are found with util_ascii_len() and copied as
+ * they are, other characters are looked up in a table. The output is
+ * truncated to @p utf8_sz and always NUL terminated.
+ *
+ * @param[out]      utf8        Output UTF8 string
+ * @param[out]      utf8_sz     Maximum size of the UTF8 string
+ * @param[in]       cp1252      Input string in the CP-1252 encoding, doesn't have to be NUL terminated
+ * @param[in]       cp1252_len  Length of @p cp1252
+ *
+ * @return
+ * Length of the UTF8 string
+ */
+size_t util_cp1252_to_utf8n(char *utf8, ssize_t utf8_sz, const char *cp1252, size_t cp1252_len)
+{
+    const char *pseq;
+    size_t in = 0;
+    size_t out = 0;
+    size_t span;
 
-    for (pcp1252 = cp1252; *pcp1252 != 0x00; pcp1252++)
+    while (in < cp1252_len)
     {
-        if (*(unsigned char *)pcp1252 < 0x80)
+        span = util_ascii_len(cp1252 + in, cp1252_len - in);
+        if (span > 0)
         {
-            if ((putf8 - utf8) + 1 >= utf8_sz) break;
+            /* Copy as much as fits, leaving room for the '\0' */
+            if ((ssize_t)(out + span) >= utf8_sz)
+            {
+                span = utf8_sz - out - 1;
+                memcpy(utf8 + out, cp1252 + in, span);
+                out += span;
+                break;
+            }
+
+            memcpy(utf8 + out, cp1252 + in, span);
+            in  += span;
+            out += span;
+            continue;
+        }
+
+        if ((ssize_t)(out + 2) >= utf8_sz) break;
+
+        pseq = util_cp1252_utf8[((unsigned char)cp1252[in]) - 0x80];
+        utf8[out++] = pseq[0];
+        utf8[out++] = pseq[1];
+        in++;
+    }
+
+    utf8[out] = '\0';
+
+    return out;
+}
 
-            *putf8++ = *pcp1252;
+/**
+ * Convert a string from UTF8 to the CP-1252 codeset, this is the reverse
+ * of util_cp1252_to_utf8()
+ *
+ * @param[out]      cp1252      Output CP-1252 string
+ * @param[in]       cp1252_sz   Size of @p cp1252, the output is NUL terminated
+ * @param[in]       utf8        Input UTF8 string
+ *
+ * @retval          true        On success
+ * @retval          false       If @p utf8 has characters that can't be represented
+ *                              in CP-1252 or @p cp1252 is too small
+ */
+bool util_utf8_to_cp1252(char *cp1252, size_t cp1252_sz, const char *utf8)
+{
+    const unsigned char *putf8 = (const unsigned char *)utf8;
+    size_t out = 0;
+
+    while (*putf8 != '\0')
+    {
+        if ((out + 1) >= cp1252_sz) return false;
+
+        if (*putf8 < 0x80)
+        {
+            cp1252[out++] = *putf8++;
         }
-        else if (*(unsigned char *)pcp1252 < 0xC0)
+        else if (((putf8[0] == 0xC2) || (putf8[0] == 0xC3)) &&
+                 ((putf8[1] & 0xC0) == 0x80))
         {
-            if ((putf8 - utf8) + 2 >= utf8_sz) break;
-            *putf8++ = '\xC2';
-            *putf8++ = *pcp1252;
+            cp1252[out++] = (putf8[0] == 0xC2) ? putf8[1] : putf8[1] + 0x40;
+            putf8 += 2;
         }
         else
         {
-            if ((putf8 - utf8) + 2 >= utf8_sz) break;
-            *putf8++ = '\xC3';
-            *putf8++ = *pcp1252 - 64;
+            cp1252[out] = '\0';
+            return false;
         }
     }
 
-    *putf8 = '\0';
+    cp1252[out] = '\0';
+
+    return true;
 }
 
 /**
@@ -44,8 +44,23 @@
 /** Max path on Unix */
 #include <limits.h>
 #define UTIL_MAX_PATH   PATH_MAX
+/** The clipboard is emulated with this file on Unix */
+#define UTIL_CLIPBOARD_FILE "clipboard.txt"
 #endif
 
+/** Storage class of the variables that hold the state of a replay session, one per thread */
+#define SYS_TLS         __thread
+
+/**
+ * File information returned by sys_fstat()
+ */
+struct sys_fstat
+{
+    uint64_t    sf_id;          /**< File ID (inode), 0 if not supported        */
+    uint64_t    sf_size;        /**< File size                                  */
+    uint64_t    sf_mtime;       /**< Last modification time, system units       */
+};
+
 extern bool clipboard_set_text(char *text);
 extern bool clipboard_get_text(char *text, size_t text_sz);
 extern bool sys_is_admin(bool *isadmin);
@@ -56,7 +71,18 @@ extern bool sys_perm_grant(char *path);
 extern FILE* sys_fopen_force(char *path, char *mode);
 extern bool sys_appdata_path(char *path, size_t pathsz);
 extern uint64_t sys_monotime(void);
+extern uint64_t sys_monotime_ns(void);
+extern void *sys_mmap(char *path, size_t *len);
+extern void sys_munmap(void *map, size_t len);
+extern bool sys_fstat(FILE *f, struct sys_fstat *sf);
+extern bool sys_fseek(FILE *f, uint64_t offset);
+extern bool sys_rename(const char *src, const char *dst);
+extern bool sys_glob(char *pattern, char ***files, size_t *nfiles);
+extern void sys_glob_free(char **files, size_t nfiles);
+extern unsigned sys_ncpu(void);
 
+extern void util_init(void);
+extern bool util_cpu_ssse3(void);
 extern char* util_strsep(char **pinputstr, const char *delim);
 extern size_t util_strlncat(char *dst, const char *src, size_t dst_size, size_t nchars);
 extern size_t util_strlcpy(char *dst, const char *src, size_t dst_size);
@@ -69,6 +95,11 @@ extern bool reg_read_key(char *key, char *val, void *buf, size_t buflen);
 
 /* Codepage stuff */
 void util_cp1252_to_utf8(char *utf8, ssize_t utf8_sz, char *cp1252);
+size_t util_cp1252_to_utf8n(char *utf8, ssize_t utf8_sz, const char *cp1252, size_t cp1252_len);
+bool util_utf8_to_cp1252(char *cp1252, size_t cp1252_sz, const char *utf8);
+size_t util_ascii_len(const char *str, size_t str_len);
+
+void *util_memchr(const void *buf, int c, size_t buf_len);
 
 /**
  * @}
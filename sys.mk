@@ -12,6 +12,11 @@ DEPS:=
 # This is not defined
 STRIP:=strip
 
+# Compiler for the tools that run on the build machine
+HOST_CC:=gcc
+HOST_CFLAGS:=-Wall -Wextra -O2 -Werror
+HOST_EXE:=
+
 EXTERN_DIR:=$(TOP_DIR)/extern
 EXTERN_DIR_SHORT:=$(TOP_DIR_SHORT)/extern
 PKG_DIR:=$(EXTERN_DIR)/pkg
@@ -25,6 +30,7 @@ UNAME:=$(shell uname -s)
 ifneq ($(findstring CYGWIN, $(UNAME)),)
     SYS_CFLAGS      :=  -DSYS_WINDOWS -DOS_CYGWIN
     USE_MANIFEST    :=  true
+    HOST_EXE        :=  .exe
     WINDRES         :=  windres
 
     XBUILD_TARGET   ?=  i686-w64-mingw32
@@ -34,6 +40,7 @@ endif
 ifneq ($(findstring MINGW, $(UNAME)),)
 # MinGW doesn't have a default compiler so we have to force it to GCC
     SYS_CFLAGS      :=  -DSYS_WINDOWS -DOS_MINGW 
+    HOST_EXE        :=  .exe
     CC              :=  gcc
     CXX             :=  g++
     LD              :=  gcc